@@ -1,7 +1,20 @@
 #include <iostream>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <fstream>
 #include <vector>
+#include <deque>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
 #include <string>
 #include <sstream>
 #include <map>
@@ -10,627 +23,9204 @@
 #include <filesystem>
 #include <ctime>
 #include <numeric>
+#include <limits>
+#include <random>
+#include <regex>
+#include <string_view>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#else
+#include <io.h>
+#include <fcntl.h>
+#define PSAPI_VERSION 2
+#include <psapi.h>
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define EXPENSE_TRACKER_X86_KERNELS
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
-// Structure to represent a financial transaction
-struct Transaction {
-    string date;
-    string description;
-    double amount;
-    string category;
-    string type; // "income" or "expense"
+// Heap allocation counters. Building with -DEXPENSE_TRACKER_COUNT_ALLOCATIONS
+// routes the global operator new/delete through them so --memory-bench can
+// report allocation counts and peak heap use; otherwise they stay at zero.
+struct AllocationCounters {
+    atomic<uint64_t> allocations{0};
+    atomic<uint64_t> bytesAllocated{0};
+    atomic<int64_t> liveBytes{0};
+    atomic<int64_t> peakLiveBytes{0};
+};
 
-    Transaction(const string& d, const string& desc, double amt, const string& cat, const string& t)
-        : date(d), description(desc), amount(amt), category(cat), type(t) {}
+AllocationCounters allocationCounters;
+
+#ifdef EXPENSE_TRACKER_COUNT_ALLOCATIONS
+const bool kCountingAllocations = true;
+// Room in front of each block for its size, keeping malloc's alignment
+const size_t kAllocationHeader = alignof(max_align_t);
+// Kept out of line: inlined into callers, GCC pairs the malloc/free inside
+// with the caller's new/delete and warns about a mismatch
+#if defined(__GNUC__) || defined(__clang__)
+#define EXPENSE_TRACKER_NOINLINE __attribute__((noinline))
+#else
+#define EXPENSE_TRACKER_NOINLINE
+#endif
+
+EXPENSE_TRACKER_NOINLINE void* operator new(size_t size) {
+    char* block = static_cast<char*>(malloc(size + kAllocationHeader));
+    if (!block) throw bad_alloc();
+    memcpy(block, &size, sizeof(size));
+    allocationCounters.allocations.fetch_add(1, memory_order_relaxed);
+    allocationCounters.bytesAllocated.fetch_add(size, memory_order_relaxed);
+    int64_t live = allocationCounters.liveBytes.fetch_add(size, memory_order_relaxed) + static_cast<int64_t>(size);
+    int64_t peak = allocationCounters.peakLiveBytes.load(memory_order_relaxed);
+    while (live > peak && !allocationCounters.peakLiveBytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {}
+    return block + kAllocationHeader;
+}
+
+EXPENSE_TRACKER_NOINLINE void operator delete(void* pointer) noexcept {
+    if (!pointer) return;
+    char* block = static_cast<char*>(pointer) - kAllocationHeader;
+    size_t size;
+    memcpy(&size, block, sizeof(size));
+    allocationCounters.liveBytes.fetch_sub(size, memory_order_relaxed);
+    free(block);
+}
+
+void operator delete(void* pointer, size_t) noexcept { operator delete(pointer); }
+#else
+const bool kCountingAllocations = false;
+#endif
+
+// Peak resident set size of this process in bytes (0 if unknown)
+inline uint64_t peakResidentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Tracker operations that record metrics
+enum class TrackedOperation : uint8_t {
+    Load,           // start-up from CSV or snapshot
+    JournalReplay,
+    Add,            // one manually added transaction
+    Import,
+    Save,
+    Compact,
+    SnapshotWrite,
+    Export,
+    Report,         // group-by query
+    Render,
+    Search,
+    Query,
+    Alerts,
+    Trends,         // burn rates, projections and series
 };
+const size_t kTrackedOperations = 14;
 
-// Structure for budget limits
-struct BudgetLimit {
-    string category;
-    double monthlyLimit;
+inline const char* operationName(TrackedOperation operation) {
+    static const char* const names[kTrackedOperations] = {"load", "journal_replay", "add", "import", "save",
+                                                          "compact", "snapshot_write", "export", "report",
+                                                          "render", "search", "query", "alerts", "trends"};
+    return names[static_cast<size_t>(operation)];
+}
+
+// Counters and a latency histogram for one operation. Buckets split every
+// power of two of nanoseconds from 1 us up in four, so percentiles are
+// within about 20%; bucket 0 holds everything under 1 us.
+struct OperationMetrics {
+    static const int kFirstPower = 10;          // 1024 ns
+    static const int kSubBuckets = 4;
+    static const size_t kBuckets = 1 + 28 * kSubBuckets;  // up to about 4.5 minutes
+
+    atomic<uint64_t> calls{0};
+    atomic<uint64_t> totalNanoseconds{0};
+    atomic<uint64_t> maxNanoseconds{0};
+    atomic<uint64_t> rows{0};
+    atomic<uint64_t> bytesRead{0};
+    atomic<uint64_t> bytesWritten{0};
+    atomic<uint64_t> allocations{0};
+    atomic<uint64_t> buckets[kBuckets] = {};
+
+    static size_t bucketOf(uint64_t nanoseconds) {
+        if (nanoseconds < (uint64_t(1) << kFirstPower)) return 0;
+        int power = 63;
+        while (!(nanoseconds >> power)) power--;
+        size_t sub = static_cast<size_t>(nanoseconds >> (power - 2)) & (kSubBuckets - 1);
+        return min(kBuckets - 1, 1 + static_cast<size_t>(power - kFirstPower) * kSubBuckets + sub);
+    }
+
+    // Exclusive upper bound of a bucket in nanoseconds
+    static uint64_t bucketLimit(size_t bucket) {
+        if (bucket == 0) return uint64_t(1) << kFirstPower;
+        int power = static_cast<int>((bucket - 1) / kSubBuckets) + kFirstPower;
+        uint64_t sub = (bucket - 1) % kSubBuckets;
+        return (kSubBuckets + sub + 1) << (power - 2);
+    }
+
+    void record(uint64_t nanoseconds, uint64_t rowCount, uint64_t readBytes, uint64_t writtenBytes,
+                uint64_t allocationCount) {
+        calls.fetch_add(1, memory_order_relaxed);
+        totalNanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+        uint64_t previous = maxNanoseconds.load(memory_order_relaxed);
+        while (nanoseconds > previous &&
+               !maxNanoseconds.compare_exchange_weak(previous, nanoseconds, memory_order_relaxed)) {}
+        if (rowCount) rows.fetch_add(rowCount, memory_order_relaxed);
+        if (readBytes) bytesRead.fetch_add(readBytes, memory_order_relaxed);
+        if (writtenBytes) bytesWritten.fetch_add(writtenBytes, memory_order_relaxed);
+        if (allocationCount) allocations.fetch_add(allocationCount, memory_order_relaxed);
+        buckets[bucketOf(nanoseconds)].fetch_add(1, memory_order_relaxed);
+    }
 
-    BudgetLimit(const string& cat, double limit) : category(cat), monthlyLimit(limit) {}
+    // Upper bound of the bucket holding the given fraction of calls, in nanoseconds
+    uint64_t percentile(double fraction) const {
+        uint64_t total = calls.load(memory_order_relaxed);
+        if (total == 0) return 0;
+        uint64_t target = max<uint64_t>(1, static_cast<uint64_t>(fraction * total + 0.5)), seen = 0;
+        for (size_t bucket = 0; bucket < kBuckets; bucket++) {
+            seen += buckets[bucket].load(memory_order_relaxed);
+            if (seen >= target) return min(bucketLimit(bucket), maxNanoseconds.load(memory_order_relaxed));
+        }
+        return maxNanoseconds.load(memory_order_relaxed);
+    }
 };
 
-// Enhanced ExpenseTracker class with budget management
-class ExpenseTracker {
+// Process-wide metrics, off until enabled (--stats / --metrics-file).
+// Building with -DEXPENSE_TRACKER_NO_METRICS removes the timers entirely.
+class MetricsRegistry {
 private:
-    vector<Transaction> transactions;
-    vector<BudgetLimit> budgetLimits;
-    double totalIncome;
-    double totalExpenses;
-    string dataFile;
-    string budgetFile;
+    atomic<bool> on{false};
+    OperationMetrics operations[kTrackedOperations];
 
 public:
-    ExpenseTracker() : totalIncome(0.0), totalExpenses(0.0), 
-                      dataFile("financial_data.csv"), budgetFile("budget_limits.csv") {
-        loadData();
-        loadBudgetLimits();
-    }
+    bool enabled() const { return on.load(memory_order_relaxed); }
+    void enable() { on.store(true, memory_order_relaxed); }
 
-    ~ExpenseTracker() {
-        saveData();
-        saveBudgetLimits();
+    OperationMetrics& of(TrackedOperation operation) { return operations[static_cast<size_t>(operation)]; }
+    const OperationMetrics& of(TrackedOperation operation) const {
+        return operations[static_cast<size_t>(operation)];
     }
 
-    // Get current date as string
-    string getCurrentDate() {
-        time_t now = time(0);
-        char* dt = ctime(&now);
-        string dateStr(dt);
-        dateStr.pop_back(); // Remove newline
-        return dateStr;
+    // Table of every operation that ran, for --stats
+    void writeSummary(ostream& out) const;
+    // Prometheus text exposition format
+    void writePrometheus(ostream& out) const;
+};
+
+MetricsRegistry metricsRegistry;
+
+#ifndef EXPENSE_TRACKER_NO_METRICS
+const bool kMetricsCompiled = true;
+
+// Times one operation from construction to destruction and records it with
+// the rows and bytes it reports; a single relaxed load when metrics are off
+class ScopedTimer {
+private:
+    OperationMetrics* target;
+    chrono::steady_clock::time_point start;
+    uint64_t allocationsAtStart;
+    uint64_t rowCount;
+    uint64_t readBytes;
+    uint64_t writtenBytes;
+
+public:
+    explicit ScopedTimer(TrackedOperation operation)
+        : target(metricsRegistry.enabled() ? &metricsRegistry.of(operation) : nullptr),
+          allocationsAtStart(0), rowCount(0), readBytes(0), writtenBytes(0) {
+        if (!target) return;
+        allocationsAtStart = allocationCounters.allocations.load(memory_order_relaxed);
+        start = chrono::steady_clock::now();
     }
 
-    // Get current month-year string
-    string getCurrentMonthYear() {
-        time_t now = time(0);
-        struct tm* timeinfo = localtime(&now);
-        char buffer[20];
-        strftime(buffer, sizeof(buffer), "%Y-%m", timeinfo);
-        return string(buffer);
+    ~ScopedTimer() {
+        if (!target) return;
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        target->record(static_cast<uint64_t>(elapsed), rowCount, readBytes, writtenBytes,
+                       allocationCounters.allocations.load(memory_order_relaxed) - allocationsAtStart);
     }
 
-    // Validate amount input
-    bool isValidAmount(double amount) {
-        return amount > 0;
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    void addRows(uint64_t rows) { rowCount += rows; }
+    void addBytesRead(uint64_t bytes) { readBytes += bytes; }
+    void addBytesWritten(uint64_t bytes) { writtenBytes += bytes; }
+};
+#else
+const bool kMetricsCompiled = false;
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(TrackedOperation) {}
+    void addRows(uint64_t) {}
+    void addBytesRead(uint64_t) {}
+    void addBytesWritten(uint64_t) {}
+};
+#endif
+
+void MetricsRegistry::writeSummary(ostream& out) const {
+    if (!kMetricsCompiled) {
+        out << "Metrics were compiled out (EXPENSE_TRACKER_NO_METRICS)." << endl;
+        return;
     }
+    auto ms = [](uint64_t nanoseconds) { return nanoseconds / 1e6; };
+    out << "\n=== OPERATION METRICS ===" << endl;
+    out << left << setw(16) << "Operation" << right << setw(8) << "Calls" << setw(12) << "Total ms"
+        << setw(11) << "Mean ms" << setw(11) << "p50 ms" << setw(11) << "p99 ms" << setw(11) << "Max ms"
+        << setw(12) << "Rows" << setw(10) << "Read MB" << setw(10) << "Write MB";
+    if (kCountingAllocations) out << setw(12) << "Allocs";
+    out << endl;
+    out << string(kCountingAllocations ? 134 : 122, '-') << endl;
+    for (size_t i = 0; i < kTrackedOperations; i++) {
+        const OperationMetrics& metrics = operations[i];
+        uint64_t calls = metrics.calls.load(memory_order_relaxed);
+        if (calls == 0) continue;
+        uint64_t total = metrics.totalNanoseconds.load(memory_order_relaxed);
+        out << left << setw(16) << operationName(static_cast<TrackedOperation>(i)) << right << setw(8) << calls
+            << fixed << setprecision(3) << setw(12) << ms(total) << setw(11) << ms(total) / calls << setw(11)
+            << ms(metrics.percentile(0.5)) << setw(11) << ms(metrics.percentile(0.99)) << setw(11)
+            << ms(metrics.maxNanoseconds.load(memory_order_relaxed)) << setw(12)
+            << metrics.rows.load(memory_order_relaxed) << setprecision(1) << setw(10)
+            << metrics.bytesRead.load(memory_order_relaxed) / 1e6 << setw(10)
+            << metrics.bytesWritten.load(memory_order_relaxed) / 1e6;
+        if (kCountingAllocations) out << setw(12) << metrics.allocations.load(memory_order_relaxed);
+        out << endl;
+    }
+    out << "Peak resident memory: " << fixed << setprecision(1) << peakResidentBytes() / 1e6 << " MB" << endl;
+}
 
-    // Calculate expense percentage of income
-    double getExpensePercentage() {
-        if (totalIncome == 0) return 0;
-        return (totalExpenses / totalIncome) * 100;
+void MetricsRegistry::writePrometheus(ostream& out) const {
+    out << "# HELP expense_tracker_operation_seconds Wall time of tracker operations.\n"
+           "# TYPE expense_tracker_operation_seconds histogram\n";
+    out << setprecision(9);
+    for (size_t i = 0; i < kTrackedOperations; i++) {
+        const OperationMetrics& metrics = operations[i];
+        string label = string("operation=\"") + operationName(static_cast<TrackedOperation>(i)) + "\"";
+        // Powers of two only keep the exposition short; the sum stays exact
+        uint64_t cumulative = 0;
+        for (size_t bucket = 0; bucket < OperationMetrics::kBuckets; bucket++) {
+            cumulative += metrics.buckets[bucket].load(memory_order_relaxed);
+            if (bucket % OperationMetrics::kSubBuckets != 0) continue;
+            out << "expense_tracker_operation_seconds_bucket{" << label << ",le=\""
+                << OperationMetrics::bucketLimit(bucket) / 1e9 << "\"} " << cumulative << "\n";
+        }
+        out << "expense_tracker_operation_seconds_bucket{" << label << ",le=\"+Inf\"} "
+            << metrics.calls.load(memory_order_relaxed) << "\n";
+        out << "expense_tracker_operation_seconds_sum{" << label << "} "
+            << metrics.totalNanoseconds.load(memory_order_relaxed) / 1e9 << "\n";
+        out << "expense_tracker_operation_seconds_count{" << label << "} "
+            << metrics.calls.load(memory_order_relaxed) << "\n";
+    }
+    auto counter = [&](const char* name, const char* help, const atomic<uint64_t> OperationMetrics::*field) {
+        out << "# HELP expense_tracker_" << name << " " << help << "\n# TYPE expense_tracker_" << name
+            << " counter\n";
+        for (size_t i = 0; i < kTrackedOperations; i++) {
+            out << "expense_tracker_" << name << "{operation=\"" << operationName(static_cast<TrackedOperation>(i))
+                << "\"} " << (operations[i].*field).load(memory_order_relaxed) << "\n";
+        }
+    };
+    counter("rows_total", "Transactions processed by tracker operations.", &OperationMetrics::rows);
+    counter("read_bytes_total", "Bytes read by tracker operations.", &OperationMetrics::bytesRead);
+    counter("written_bytes_total", "Bytes written by tracker operations.", &OperationMetrics::bytesWritten);
+    if (kCountingAllocations) {
+        counter("allocations_total", "Heap allocations made during tracker operations.",
+                &OperationMetrics::allocations);
     }
+    out << "# HELP expense_tracker_peak_resident_bytes Peak resident memory of the process.\n"
+           "# TYPE expense_tracker_peak_resident_bytes gauge\n"
+           "expense_tracker_peak_resident_bytes " << peakResidentBytes() << "\n";
+}
 
-    // Get monthly expenses by category
-    map<string, double> getMonthlyExpensesByCategory(const string& monthYear) {
-        map<string, double> monthlyExpenses;
+// Number of decimal places kept by Money (2 = cents)
+const int kMoneyDecimals = 2;
+const int64_t kMoneyScale = 100;
+// Largest magnitude Money::parse accepts (one hundred billion), so ~1e5 rows
+// of it still sum, and scale by 100 for percentages, within int64_t
+const int64_t kMaxMoneyUnits = 10000000000000;
+
+// Fixed-point money amount stored as an integer number of cents, so sums
+// are exact and independent of the order rows are added in.
+class Money {
+private:
+    int64_t units;
+
+    explicit constexpr Money(int64_t value) : units(value) {}
+
+public:
+    constexpr Money() : units(0) {}
+
+    static constexpr Money fromUnits(int64_t value) { return Money(value); }
+    constexpr int64_t toUnits() const { return units; }
+    double toDouble() const { return static_cast<double>(units) / kMoneyScale; }
+
+    // Parse decimal text such as "150.75", "-3", "+.5"; extra decimals are
+    // rounded half away from zero. Exponents, separators and amounts beyond
+    // kMaxMoneyUnits are rejected.
+    static bool parse(string_view text, Money& out) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) text.remove_suffix(1);
+        bool negative = false;
+        if (!text.empty() && (text.front() == '+' || text.front() == '-')) {
+            negative = text.front() == '-';
+            text.remove_prefix(1);
+        }
 
-        for (const auto& transaction : transactions) {
-            if (transaction.type == "expense" && transaction.date.find(monthYear) != string::npos) {
-                monthlyExpenses[transaction.category] += transaction.amount;
+        int64_t whole = 0;
+        int64_t fraction = 0;
+        int fractionDigits = 0;
+        bool roundUp = false;
+        bool anyDigit = false;
+        size_t i = 0;
+        for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++) {
+            if (whole > kMaxMoneyUnits / kMoneyScale) return false;
+            whole = whole * 10 + (text[i] - '0');
+            anyDigit = true;
+        }
+        if (i < text.size() && text[i] == '.') {
+            for (i++; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++) {
+                if (fractionDigits < kMoneyDecimals) {
+                    fraction = fraction * 10 + (text[i] - '0');
+                    fractionDigits++;
+                } else if (fractionDigits == kMoneyDecimals) {
+                    roundUp = text[i] >= '5';
+                    fractionDigits++;
+                }
+                anyDigit = true;
             }
         }
+        if (!anyDigit || i != text.size()) return false;
 
-        return monthlyExpenses;
+        for (int d = min(fractionDigits, kMoneyDecimals); d < kMoneyDecimals; d++) fraction *= 10;
+        int64_t value = whole * kMoneyScale + fraction + (roundUp ? 1 : 0);
+        if (value > kMaxMoneyUnits) return false;
+        out = Money(negative ? -value : value);
+        return true;
     }
 
-    // Check budget limits for current month
-    void checkBudgetLimits() {
-        if (budgetLimits.empty()) {
-            cout << "\n📊 No budget limits set. Use option 8 to set budget limits." << endl;
-            return;
+    // Format as plain decimal text ("-12.05"); returns the end of the written text
+    char* format(char* out) const {
+        uint64_t magnitude = units < 0 ? 0 - static_cast<uint64_t>(units) : static_cast<uint64_t>(units);
+        if (units < 0) *out++ = '-';
+        out = to_chars(out, out + 24, magnitude / kMoneyScale).ptr;
+        if (kMoneyDecimals > 0) {
+            *out++ = '.';
+            uint64_t fraction = magnitude % kMoneyScale;
+            for (int64_t scale = kMoneyScale / 10; scale > 0; scale /= 10) {
+                *out++ = static_cast<char>('0' + fraction / scale % 10);
+            }
         }
+        return out;
+    }
 
-        string currentMonth = getCurrentMonthYear();
-        map<string, double> monthlyExpenses = getMonthlyExpensesByCategory(currentMonth);
+    string toString() const {
+        char buffer[32];
+        return string(buffer, format(buffer));
+    }
 
-        cout << "\n=== BUDGET ANALYSIS FOR " << currentMonth << " ===" << endl;
-        cout << left << setw(20) << "Category" << setw(12) << "Spent" 
-             << setw(12) << "Budget" << setw(12) << "Remaining" << "Status" << endl;
-        cout << string(70, '-') << endl;
+    // This amount as a percentage of whole (for display)
+    double percentOf(Money whole) const {
+        return whole.units == 0 ? 0.0 : static_cast<double>(units) * 100.0 / static_cast<double>(whole.units);
+    }
 
-        bool anyOverBudget = false;
+    // Exact test for "this >= percent% of whole"
+    bool reachesPercent(Money whole, int percent) const {
+        return units * 100 >= whole.units * percent;
+    }
 
-        for (const auto& budget : budgetLimits) {
-            double spent = monthlyExpenses[budget.category];
-            double remaining = budget.monthlyLimit - spent;
-            double percentage = (spent / budget.monthlyLimit) * 100;
+    // percent% of this amount, rounded half away from zero
+    Money percent(int percent) const {
+        int64_t scaled = units * percent;
+        return Money((scaled + (scaled >= 0 ? 50 : -50)) / 100);
+    }
 
-            cout << left << setw(20) << budget.category
-                 << "$" << right << setw(10) << fixed << setprecision(2) << spent
-                 << "$" << right << setw(10) << fixed << setprecision(2) << budget.monthlyLimit
-                 << "$" << right << setw(10) << fixed << setprecision(2) << remaining;
+    Money& operator+=(Money other) { units += other.units; return *this; }
+    Money& operator-=(Money other) { units -= other.units; return *this; }
+    friend Money operator+(Money a, Money b) { return Money(a.units + b.units); }
+    friend Money operator-(Money a, Money b) { return Money(a.units - b.units); }
+    friend bool operator==(Money a, Money b) { return a.units == b.units; }
+    friend bool operator!=(Money a, Money b) { return a.units != b.units; }
+    friend bool operator<(Money a, Money b) { return a.units < b.units; }
+    friend bool operator>(Money a, Money b) { return a.units > b.units; }
+    friend bool operator<=(Money a, Money b) { return a.units <= b.units; }
+    friend bool operator>=(Money a, Money b) { return a.units >= b.units; }
 
-            if (percentage >= 100) {
-                cout << " 🚨 OVER BUDGET!";
-                anyOverBudget = true;
-            } else if (percentage >= 80) {
-                cout << " ⚠️  WARNING!";
-            } else if (percentage >= 60) {
-                cout << " 🔔 ALERT";
-            } else {
-                cout << " ✅ GOOD";
+    // Streams always show exactly kMoneyDecimals places; width/alignment still apply
+    friend ostream& operator<<(ostream& out, Money money) {
+        char buffer[32];
+        return out << string_view(buffer, money.format(buffer) - buffer);
+    }
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    const char* data;
+    size_t length;
+    bool opened;
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+
+public:
+    explicit MappedFile(const string& path) : data(nullptr), length(0), opened(false) {
+#ifdef _WIN32
+        mappingHandle = NULL;
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                 OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) return;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize)) return;
+        opened = true;
+        length = static_cast<size_t>(fileSize.QuadPart);
+        if (length == 0) return;
+
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle == NULL) { opened = false; length = 0; return; }
+        data = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (data == nullptr) { opened = false; length = 0; }
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            opened = true;
+            length = static_cast<size_t>(st.st_size);
+            if (length > 0) {
+                void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped == MAP_FAILED) {
+                    opened = false;
+                    length = 0;
+                } else {
+                    data = static_cast<const char*>(mapped);
+                    madvise(mapped, length, MADV_SEQUENTIAL);
+                }
             }
-            cout << endl;
         }
+        close(fd);
+#endif
+    }
 
-        if (anyOverBudget) {
-            cout << "\n🚨 BUDGET ALERT: You have exceeded budget limits in some categories!" << endl;
-        }
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mappingHandle) CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+#else
+        if (data) munmap(const_cast<char*>(data), length);
+#endif
     }
 
-    // Enhanced alert system with budget integration
-    void checkAndShowAlerts() {
-        double percentage = getExpensePercentage();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
 
-        cout << "\n=== COMPREHENSIVE SPENDING ANALYSIS ===" << endl;
-        cout << "Total Income: $" << fixed << setprecision(2) << totalIncome << endl;
-        cout << "Total Expenses: $" << fixed << setprecision(2) << totalExpenses << endl;
-        cout << "Available Balance: $" << fixed << setprecision(2) << (totalIncome - totalExpenses) << endl;
-        cout << "Expense Percentage: " << fixed << setprecision(1) << percentage << "%" << endl;
+    bool isOpen() const { return opened; }
+    string_view view() const { return string_view(data ? data : "", length); }
+};
 
-        // Overall spending alerts
-        if (percentage >= 90) {
-            cout << "\n🚨 CRITICAL WARNING! 🚨" << endl;
-            cout << "You are spending " << fixed << setprecision(1) << percentage << "% of your income!" << endl;
-            cout << "IMMEDIATE ACTION REQUIRED: Cut down expenses drastically!" << endl;
-            cout << "Recommended actions:" << endl;
-            cout << "• Review all non-essential expenses" << endl;
-            cout << "• Cancel unnecessary subscriptions" << endl;
-            cout << "• Consider additional income sources" << endl;
-        }
-        else if (percentage >= 80) {
-            cout << "\n⚠️  WARNING! ⚠️" << endl;
-            cout << "You are spending " << fixed << setprecision(1) << percentage << "% of your income!" << endl;
-            cout << "Consider reducing your expenses to maintain financial stability." << endl;
-            cout << "Recommended actions:" << endl;
-            cout << "• Set budget limits for categories" << endl;
-            cout << "• Track daily expenses more carefully" << endl;
-        }
-        else if (percentage >= 70) {
-            cout << "\n🔔 ALERT! 🔔" << endl;
-            cout << "You are spending " << fixed << setprecision(1) << percentage << "% of your income!" << endl;
-            cout << "Monitor your spending carefully to avoid financial strain." << endl;
-            cout << "Consider setting budget limits for better control." << endl;
+// CSV dialect: field delimiter and quote character
+struct CsvDialect {
+    char delimiter;
+    char quote;
+
+    CsvDialect(char delim = ',', char quoteChar = '"') : delimiter(delim), quote(quoteChar) {}
+};
+
+// Options controlling how the ingest engine validates rows
+struct IngestOptions {
+    bool normalizeType;      // accept only income/expense (case-insensitive)
+    bool requirePositive;    // reject amounts <= 0
+    CsvDialect dialect;
+    atomic<uint64_t>* progress; // if set, bytes parsed so far are added to it as parsing goes
+
+    IngestOptions(bool normalize = false, bool positive = false, CsvDialect csv = CsvDialect())
+        : normalizeType(normalize), requirePositive(positive), dialect(csv), progress(nullptr) {}
+};
+
+// A parsed CSV row; text fields point into the ingested buffer
+struct RawRow {
+    string_view date;
+    string_view description;
+    string_view category;
+    string_view type;
+    Money amount;
+};
+
+// Result of one ingest pass: parsed rows, per-line errors and throughput
+struct IngestResult {
+    vector<RawRow> rows;
+    vector<pair<size_t, string>> errors; // line number -> message
+    size_t linesScanned = 0;
+    size_t bytesScanned = 0;
+    double seconds = 0.0;
+    list<string> cleanedText; // backing storage for unescaped quoted fields (stable addresses)
+    unsigned threadsUsed = 1;
+
+    double rowsPerSecond() const {
+        return seconds > 0 ? rows.size() / seconds : 0.0;
+    }
+};
+
+// Streaming RFC 4180 CSV tokenizer over a fixed buffer. Handles quoted
+// fields, doubled quotes, delimiters and line breaks inside quotes, CRLF
+// line endings and a leading UTF-8 BOM. Fields are views into the buffer;
+// only fields containing doubled quotes are unescaped, into a reusable
+// scratch buffer, and those views stay valid until the next call to next().
+// Records without quoted fields take a fast path that splits the line with
+// memchr (vectorized by the C runtime).
+class CsvTokenizer {
+private:
+    struct FieldRef {
+        bool inScratch;
+        size_t offset;
+        size_t length;
+    };
+
+    string_view buffer;
+    CsvDialect dialect;
+    size_t position;
+    size_t newlines;           // line breaks consumed so far
+    size_t recordFirstLine;    // 1-based line number where the current record starts
+    size_t recordStart;
+    size_t recordEnd;          // excludes the line terminator
+    bool terminated;           // current record ended with a line break
+    bool malformed;            // unterminated quote or text after a closing quote
+    uint32_t scratchMask;      // bit i set if field i points into scratch
+    string scratch;
+    vector<FieldRef> refs;
+
+    size_t countNewlines(size_t from, size_t to) const {
+        return static_cast<size_t>(count(buffer.begin() + from, buffer.begin() + to, '\n'));
+    }
+
+    // Full state machine for records that contain quote characters
+    void parseQuotedRecord(vector<string_view>& fields) {
+        const char* data = buffer.data();
+        const size_t size = buffer.size();
+        size_t p = position;
+        refs.clear();
+        scratch.clear();
+
+        while (true) {
+            FieldRef ref = {false, p, 0};
+            if (p < size && data[p] == dialect.quote) {
+                size_t start = ++p;
+                bool escaped = false;
+                while (true) {
+                    const char* q = static_cast<const char*>(memchr(data + p, dialect.quote, size - p));
+                    if (!q) {
+                        malformed = true; // unterminated quote: take the rest of the buffer
+                        newlines += countNewlines(p, size);
+                        if (escaped) {
+                            scratch.append(data + p, size - p);
+                            ref.length = scratch.size() - ref.offset;
+                        } else {
+                            ref.offset = start;
+                            ref.length = size - start;
+                        }
+                        p = size;
+                        break;
+                    }
+                    size_t at = static_cast<size_t>(q - data);
+                    newlines += countNewlines(p, at);
+                    if (at + 1 < size && data[at + 1] == dialect.quote) {
+                        if (!escaped) {
+                            ref.inScratch = true;
+                            ref.offset = scratch.size();
+                            scratch.append(data + start, at + 1 - start);
+                            escaped = true;
+                        } else {
+                            scratch.append(data + p, at + 1 - p);
+                        }
+                        p = at + 2;
+                        continue;
+                    }
+                    if (escaped) scratch.append(data + p, at - p);
+                    ref.length = escaped ? scratch.size() - ref.offset : at - start;
+                    if (!escaped) ref.offset = start;
+                    p = at + 1;
+                    break;
+                }
+                // Anything between the closing quote and the next delimiter is not RFC 4180
+                while (p < size && data[p] != dialect.delimiter && data[p] != '\n') {
+                    if (!(data[p] == '\r' && p + 1 < size && data[p + 1] == '\n')) malformed = true;
+                    p++;
+                }
+            } else {
+                const char* newline = static_cast<const char*>(memchr(data + p, '\n', size - p));
+                size_t lineEnd = newline ? static_cast<size_t>(newline - data) : size;
+                const char* delimiter = static_cast<const char*>(memchr(data + p, dialect.delimiter, lineEnd - p));
+                p = delimiter ? static_cast<size_t>(delimiter - data) : lineEnd;
+                ref.length = p - ref.offset;
+                if (p < size && data[p] == '\n' && ref.length > 0 && data[p - 1] == '\r') ref.length--;
+                if (p == size && ref.length > 0 && data[p - 1] == '\r') ref.length--;
+            }
+            refs.push_back(ref);
+
+            if (p < size && data[p] == dialect.delimiter) {
+                p++;
+                continue;
+            }
+            recordEnd = p;
+            if (p < size) { // line break
+                if (recordEnd > recordStart && data[recordEnd - 1] == '\r') recordEnd--;
+                newlines++;
+                terminated = true;
+                p++;
+            }
+            break;
         }
-        else {
-            cout << "\n✅ EXCELLENT! Your spending is under control." << endl;
-            cout << "Keep up the good financial habits!" << endl;
+        position = p;
+
+        fields.clear();
+        for (size_t i = 0; i < refs.size(); i++) {
+            if (refs[i].inScratch) {
+                if (i < 32) scratchMask |= 1u << i;
+                fields.emplace_back(scratch.data() + refs[i].offset, refs[i].length);
+            } else {
+                fields.emplace_back(data + refs[i].offset, refs[i].length);
+            }
         }
+    }
 
-        // Budget-specific alerts
-        checkBudgetLimits();
+public:
+    explicit CsvTokenizer(string_view data, const CsvDialect& csv = CsvDialect())
+        : buffer(data), dialect(csv), position(0), newlines(0), recordFirstLine(0), recordStart(0),
+          recordEnd(0), terminated(false), malformed(false), scratchMask(0) {
+        if (buffer.substr(0, 3) == "\xEF\xBB\xBF") position = 3;
+    }
 
-        // Savings recommendation
-        double recommendedSavings = totalIncome * 0.20; // 20% savings goal
-        double actualSavings = totalIncome - totalExpenses;
+    // Read the next record into fields; returns false at end of buffer
+    bool next(vector<string_view>& fields) {
+        if (position >= buffer.size()) return false;
+        recordFirstLine = newlines + 1;
+        recordStart = position;
+        terminated = false;
+        malformed = false;
+        scratchMask = 0;
 
-        cout << "\n💰 SAVINGS ANALYSIS:" << endl;
-        cout << "Recommended Savings (20%): $" << fixed << setprecision(2) << recommendedSavings << endl;
-        cout << "Current Savings: $" << fixed << setprecision(2) << actualSavings << endl;
+        const char* data = buffer.data();
+        const size_t size = buffer.size();
+        const char* newline = static_cast<const char*>(memchr(data + position, '\n', size - position));
+        size_t lineEnd = newline ? static_cast<size_t>(newline - data) : size;
 
-        if (actualSavings >= recommendedSavings) {
-            cout << "🎉 Great job! You're meeting your savings goal!" << endl;
-        } else {
-            cout << "💡 Try to save $" << fixed << setprecision(2) 
-                 << (recommendedSavings - actualSavings) << " more to reach 20% savings rate." << endl;
+        size_t contentEnd = lineEnd;
+        if (contentEnd > position && data[contentEnd - 1] == '\r') contentEnd--;
+
+        // Fast path: split the line on delimiters; a field opening with a quote
+        // (the only place RFC 4180 gives quotes meaning) switches to the state machine
+        fields.clear();
+        size_t p = position;
+        while (true) {
+            if (p < contentEnd && data[p] == dialect.quote) {
+                parseQuotedRecord(fields);
+                return true;
+            }
+            const char* delimiter = static_cast<const char*>(memchr(data + p, dialect.delimiter, contentEnd - p));
+            if (!delimiter) {
+                fields.emplace_back(data + p, contentEnd - p);
+                break;
+            }
+            size_t at = static_cast<size_t>(delimiter - data);
+            fields.emplace_back(data + p, at - p);
+            p = at + 1;
+        }
+
+        recordEnd = contentEnd;
+        position = newline ? lineEnd + 1 : size;
+        if (newline) {
+            newlines++;
+            terminated = true;
         }
+        return true;
     }
 
-    // Set budget limits for categories
-    void setBudgetLimit() {
-        string category;
-        double limit;
+    size_t recordLine() const { return recordFirstLine; }
+    size_t offset() const { return position; }
+    string_view recordText() const { return buffer.substr(recordStart, recordEnd - recordStart); }
+    bool recordTerminated() const { return terminated; }
+    bool recordMalformed() const { return malformed; }
+    bool fieldInScratch(size_t index) const { return index < 32 && (scratchMask >> index) & 1u; }
 
-        cout << "\n=== SET BUDGET LIMIT ===" << endl;
+    // Physical lines consumed so far (a final line without a break counts)
+    size_t lineCount() const {
+        bool openLastLine = position == buffer.size() && !buffer.empty() && buffer.back() != '\n';
+        return newlines + (openLastLine ? 1 : 0);
+    }
+};
 
-        // Show existing budget limits
-        if (!budgetLimits.empty()) {
-            cout << "Existing budget limits:" << endl;
-            for (const auto& budget : budgetLimits) {
-                cout << "• " << budget.category << ": $" << fixed << setprecision(2) 
-                     << budget.monthlyLimit << " per month" << endl;
-            }
-            cout << endl;
+// Append a field to a CSV line, quoting it only when required
+inline void appendCsvField(string& out, string_view field, const CsvDialect& dialect = CsvDialect()) {
+    bool needsQuotes = false;
+    for (char c : field) {
+        if (c == dialect.delimiter || c == dialect.quote || c == '\n' || c == '\r') {
+            needsQuotes = true;
+            break;
         }
+    }
+    if (!needsQuotes) {
+        out.append(field.data(), field.size());
+        return;
+    }
+    out.push_back(dialect.quote);
+    for (char c : field) {
+        if (c == dialect.quote) out.push_back(dialect.quote);
+        out.push_back(c);
+    }
+    out.push_back(dialect.quote);
+}
 
-        cout << "Enter category name: ";
-        cin.ignore();
-        getline(cin, category);
+// Trim surrounding blanks from a field
+inline string_view trimField(string_view field) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t')) field.remove_suffix(1);
+    return field;
+}
 
-        cout << "Enter monthly budget limit: $";
-        cin >> limit;
+// Case-insensitive comparison against a lowercase literal
+inline bool equalsLower(string_view field, string_view lower) {
+    if (field.size() != lower.size()) return false;
+    for (size_t i = 0; i < field.size(); i++) {
+        if (tolower(static_cast<unsigned char>(field[i])) != lower[i]) return false;
+    }
+    return true;
+}
 
-        if (!isValidAmount(limit)) {
-            cout << "Invalid amount! Please enter a positive number." << endl;
-            return;
+// Parse a decimal amount without allocating
+inline bool parseAmount(string_view field, Money& amount) {
+    return Money::parse(field, amount);
+}
+
+// Parse one record-aligned chunk of a CSV buffer. Line numbers in the
+// result are relative to the start of the chunk; the header is skipped
+// only in the first chunk.
+IngestResult ingestChunk(string_view buffer, bool firstChunk, const IngestOptions& options) {
+    IngestResult result;
+    CsvTokenizer tokenizer(buffer, options.dialect);
+    vector<string_view> fields;
+    fields.reserve(8);
+    result.rows.reserve(buffer.size() / 48);
+
+    // Fields unescaped into the tokenizer's scratch buffer must outlive the record
+    auto keep = [&](size_t index) -> string_view {
+        if (!tokenizer.fieldInScratch(index)) return fields[index];
+        result.cleanedText.emplace_back(fields[index]);
+        return result.cleanedText.back();
+    };
+
+    bool header = firstChunk;
+    size_t records = 0;
+    size_t reported = 0;
+    while (tokenizer.next(fields)) {
+        if (options.progress && ++records % 8192 == 0) {
+            options.progress->fetch_add(tokenizer.offset() - reported, memory_order_relaxed);
+            reported = tokenizer.offset();
+        }
+        if (header) { // Skip header line
+            header = false;
+            continue;
+        }
+        if (fields.size() == 1 && fields[0].empty()) continue;
+        while (fields.size() < 5) fields.emplace_back();
+
+        size_t lineNumber = tokenizer.recordLine();
+        if (tokenizer.recordMalformed()) {
+            result.errors.emplace_back(lineNumber, "malformed quoted field");
+            continue;
         }
 
-        // Check if category already exists
-        auto it = find_if(budgetLimits.begin(), budgetLimits.end(),
-                         [&category](const BudgetLimit& budget) {
-                             return budget.category == category;
-                         });
+        string_view amountField = fields[2];
+        if (amountField.empty()) continue;
 
-        if (it != budgetLimits.end()) {
-            cout << "Budget limit for '" << category << "' updated from $" 
-                 << fixed << setprecision(2) << it->monthlyLimit 
-                 << " to $" << limit << endl;
-            it->monthlyLimit = limit;
+        RawRow row;
+        row.type = fields[4];
+        if (options.normalizeType) {
+            if (equalsLower(row.type, "income")) {
+                row.type = "income";
+            } else if (equalsLower(row.type, "expense")) {
+                row.type = "expense";
+            } else {
+                continue;
+            }
         } else {
-            budgetLimits.push_back(BudgetLimit(category, limit));
-            cout << "Budget limit set for '" << category << "': $" 
-                 << fixed << setprecision(2) << limit << " per month" << endl;
+            row.type = keep(4);
+        }
+
+        if (!parseAmount(amountField, row.amount)) {
+            result.errors.emplace_back(lineNumber, "invalid amount '" + string(amountField) + "'");
+            continue;
         }
+        if (options.requirePositive && !(row.amount > Money())) continue;
+
+        row.date = keep(0);
+        row.description = keep(1);
+        row.category = keep(3);
+        result.rows.push_back(row);
     }
 
-    // Load budget limits from file
-    void loadBudgetLimits() {
-        ifstream file(budgetFile);
-        if (!file.is_open()) {
-            return; // No budget file exists yet
+    if (options.progress) options.progress->fetch_add(buffer.size() - reported, memory_order_relaxed);
+    result.linesScanned = tokenizer.lineCount();
+    result.bytesScanned = buffer.size();
+    return result;
+}
+
+// Offset of the first record boundary at or after target. Quote state is
+// tracked from the previous boundary (from) the way CsvTokenizer reads it,
+// so a line break inside a quoted field is never chosen: a quote opens a
+// field only at the start of one, "" inside a quoted field is an escape,
+// and any other quote is literal text.
+inline size_t nextRecordBoundary(string_view buffer, size_t from, size_t target, const CsvDialect& dialect) {
+    const char* data = buffer.data();
+    const size_t size = buffer.size();
+    auto opensField = [&](size_t at) {
+        return at == from || data[at - 1] == dialect.delimiter || data[at - 1] == '\n';
+    };
+    bool inQuotes = false;
+    size_t p = from;
+    while (p < target) {
+        const char* q = static_cast<const char*>(memchr(data + p, dialect.quote, target - p));
+        if (!q) break;
+        size_t at = static_cast<size_t>(q - data);
+        p = at + 1;
+        if (inQuotes) {
+            if (p < size && data[p] == dialect.quote) p++;  // escaped quote
+            else inQuotes = false;
+        } else if (opensField(at)) {
+            inQuotes = true;
+        }
+    }
+    for (p = max(p, target); p < size; p++) {
+        if (data[p] == dialect.quote) {
+            if (inQuotes) {
+                if (p + 1 < size && data[p + 1] == dialect.quote) p++;
+                else inQuotes = false;
+            } else if (opensField(p)) {
+                inQuotes = true;
+            }
+        } else if (data[p] == '\n' && !inQuotes) {
+            return p + 1;
         }
+    }
+    return size;
+}
 
-        string line;
-        // Skip header line
-        getline(file, line);
+// Worker count for a parallel ingest of the given size
+inline unsigned ingestThreadCount(size_t bytes) {
+    const size_t minChunkBytes = 1 << 20; // below this, thread startup dominates
+    unsigned hardware = max(1u, thread::hardware_concurrency());
+    return static_cast<unsigned>(max<size_t>(1, min<size_t>(hardware, bytes / minChunkBytes)));
+}
 
-        while (getline(file, line)) {
-            stringstream ss(line);
-            string category, limitStr;
+// Streaming CSV ingest over an in-memory buffer (usually a MappedFile).
+// The buffer is split into record-aligned chunks that are parsed in
+// parallel; rows are merged back in file order and error line numbers are
+// rebased so they match the file. Rows are kept as views into the buffer;
+// the caller materializes them.
+IngestResult ingestCsv(string_view buffer, const IngestOptions& options, unsigned threads = 0) {
+    auto start = chrono::steady_clock::now();
+    if (threads == 0) threads = ingestThreadCount(buffer.size());
 
-            getline(ss, category, ',');
-            getline(ss, limitStr, ',');
+    vector<string_view> chunks;
+    size_t begin = 0;
+    for (unsigned i = 1; i <= threads && begin < buffer.size(); i++) {
+        size_t end = i == threads ? buffer.size() : max(begin, buffer.size() / threads * i);
+        if (end < buffer.size()) end = nextRecordBoundary(buffer, begin, end, options.dialect);
+        chunks.push_back(buffer.substr(begin, end - begin));
+        begin = end;
+    }
 
-            if (!limitStr.empty()) {
-                double limit = stod(limitStr);
-                budgetLimits.push_back(BudgetLimit(category, limit));
-            }
+    vector<IngestResult> parts(chunks.size());
+    if (chunks.size() <= 1) {
+        if (!chunks.empty()) parts[0] = ingestChunk(chunks[0], true, options);
+    } else {
+        vector<thread> workers;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            workers.emplace_back([&, i] { parts[i] = ingestChunk(chunks[i], i == 0, options); });
         }
+        for (auto& worker : workers) worker.join();
+    }
 
-        file.close();
+    IngestResult result;
+    size_t totalRows = 0;
+    for (const auto& part : parts) totalRows += part.rows.size();
+    if (parts.size() == 1) {
+        result.rows.swap(parts[0].rows);
+    } else {
+        result.rows.reserve(totalRows);
+    }
+    for (auto& part : parts) {
+        // Release each part once merged so the rows are not held twice
+        result.rows.insert(result.rows.end(), part.rows.begin(), part.rows.end());
+        vector<RawRow>().swap(part.rows);
+        for (auto& error : part.errors) {
+            result.errors.emplace_back(result.linesScanned + error.first, std::move(error.second));
+        }
+        result.cleanedText.splice(result.cleanedText.end(), part.cleanedText);
+        result.linesScanned += part.linesScanned;
+        result.bytesScanned += part.bytesScanned;
     }
+    result.threadsUsed = static_cast<unsigned>(max<size_t>(1, chunks.size()));
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
 
-    // Save budget limits to file
-    void saveBudgetLimits() {
-        if (budgetLimits.empty()) return;
+// Transaction kind, stored as one byte per row in the ledger
+enum class TransactionType : uint8_t {
+    Income = 0,
+    Expense = 1
+};
 
-        ofstream file(budgetFile);
-        if (!file.is_open()) return;
+inline const char* typeName(TransactionType type) {
+    return type == TransactionType::Income ? "income" : "expense";
+}
 
-        // Write header
-        file << "Category,MonthlyLimit\n";
+inline TransactionType parseType(string_view type) {
+    return equalsLower(type, "income") ? TransactionType::Income : TransactionType::Expense;
+}
 
-        // Write budget limits
-        for (const auto& budget : budgetLimits) {
-            file << budget.category << "," << fixed << setprecision(2) 
-                 << budget.monthlyLimit << "\n";
-        }
+// Days since 1970-01-01 for a proleptic Gregorian date
+inline int32_t daysFromCivil(int year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int32_t>(doe) - 719468;
+}
+
+// Inverse of daysFromCivil
+inline void civilFromDays(int32_t days, int& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    const int era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int>(yoe) + era * 400 + (month <= 2);
+}
+
+const int32_t kUnknownDay = INT32_MIN;
+
+// Days in a month of the proleptic Gregorian calendar
+inline unsigned daysInMonth(int year, unsigned month) {
+    static const unsigned days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    return month == 2 && leap ? 29 : days[month - 1];
+}
+
+// Parse a fixed-width unsigned number
+inline bool parseDigits(string_view text, unsigned& value) {
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == errc() && result.ptr == text.data() + text.size();
+}
+
+// Parse a ctime()-style date ("Www Mmm dd hh:mm:ss yyyy") into a day number
+inline int32_t parseCtimeDate(string_view date) {
+    static const char* const monthNames[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                             "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    if (date.size() != 24 || date[3] != ' ' || date[7] != ' ' || date[10] != ' ' || date[19] != ' ') {
+        return kUnknownDay;
+    }
+    unsigned month = 0;
+    for (unsigned i = 0; i < 12; i++) {
+        if (date.substr(4, 3) == monthNames[i]) month = i + 1;
+    }
+    string_view dayText = date.substr(8, 2);
+    if (dayText.front() == ' ') dayText.remove_prefix(1);
+    unsigned year, day;
+    if (month == 0 || !parseDigits(dayText, day) || !parseDigits(date.substr(20, 4), year)) {
+        return kUnknownDay;
+    }
+    if (day < 1 || day > daysInMonth(static_cast<int>(year), month)) return kUnknownDay;
+    return daysFromCivil(static_cast<int>(year), month, day);
+}
 
-        file.close();
+// Parse a date into a day number; accepts YYYY-MM-DD and ctime() strings
+inline int32_t parseDate(string_view date) {
+    date = trimField(date);
+    if (date.size() == 24) return parseCtimeDate(date);
+    unsigned year, month, day;
+    if (date.size() != 10 || date[4] != '-' || date[7] != '-') return kUnknownDay;
+    if (!parseDigits(date.substr(0, 4), year) || !parseDigits(date.substr(5, 2), month) ||
+        !parseDigits(date.substr(8, 2), day)) {
+        return kUnknownDay;
     }
+    // Impossible dates such as 2024-02-31 are kept as text rather than rolled over
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth(static_cast<int>(year), month)) return kUnknownDay;
+    return daysFromCivil(static_cast<int>(year), month, day);
+}
 
-    // Add manual transaction with enhanced feedback
-    void addTransaction() {
-        string type, description, category, dateInput;
-        double amount;
+// Compact month number (year * 12 + month - 1) used to partition the ledger
+inline int32_t monthKeyFromDay(int32_t days) {
+    int year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    return year * 12 + static_cast<int32_t>(month) - 1;
+}
 
-        cout << "\n=== ADD TRANSACTION ===" << endl;
-        cout << "Enter transaction type (income/expense): ";
-        cin >> type;
-        transform(type.begin(), type.end(), type.begin(), ::tolower);
+// Parse a YYYY-MM month string into a month key
+inline int32_t parseMonthKey(string_view monthYear) {
+    unsigned year, month;
+    monthYear = trimField(monthYear);
+    if (monthYear.size() != 7 || monthYear[4] != '-') return kUnknownDay;
+    if (!parseDigits(monthYear.substr(0, 4), year) || !parseDigits(monthYear.substr(5, 2), month) ||
+        month < 1 || month > 12) {
+        return kUnknownDay;
+    }
+    return static_cast<int32_t>(year) * 12 + static_cast<int32_t>(month) - 1;
+}
 
-        if (type != "income" && type != "expense") {
-            cout << "Invalid transaction type! Please enter 'income' or 'expense'." << endl;
-            return;
+// Format a day number as YYYY-MM-DD
+inline string formatDate(int32_t days) {
+    int year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u", year, month, day);
+    return string(buffer);
+}
+
+// Dictionary encoding for repeated strings such as category names
+class StringDictionary {
+private:
+    deque<string> values;                      // deque keeps keys' storage stable
+    unordered_map<string_view, uint32_t> ids;
+
+public:
+    static const uint32_t npos = UINT32_MAX;
+
+    StringDictionary() = default;
+    StringDictionary(StringDictionary&&) = default;
+    StringDictionary& operator=(StringDictionary&&) = default;
+
+    // The keys are views of values, so a copy must key on its own strings
+    StringDictionary(const StringDictionary& other) {
+        for (const auto& value : other.values) intern(value);
+    }
+
+    StringDictionary& operator=(const StringDictionary& other) {
+        if (this != &other) *this = StringDictionary(other);
+        return *this;
+    }
+
+    uint32_t intern(string_view value) {
+        auto it = ids.find(value);
+        if (it != ids.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(values.size());
+        values.emplace_back(value);
+        ids.emplace(values.back(), id);
+        return id;
+    }
+
+    uint32_t find(string_view value) const {
+        auto it = ids.find(value);
+        return it == ids.end() ? npos : it->second;
+    }
+
+    const string& name(uint32_t id) const { return values[id]; }
+    size_t size() const { return values.size(); }
+
+    size_t bytesUsed() const {
+        size_t bytes = 0;
+        for (const auto& value : values) bytes += sizeof(string) + value.capacity();
+        return bytes + ids.size() * (sizeof(string_view) + sizeof(uint32_t) + 2 * sizeof(void*));
+    }
+};
+
+// Append-only text storage in fixed-size chunks. Stored text never moves, so
+// views stay valid while the arena lives, and growing costs one new chunk
+// instead of copying everything stored so far. Text is addressed by a
+// position in a virtual address space of kChunkBytes slots; each block
+// covers one or more consecutive slots, so text longer than a chunk simply
+// gets a block of its own.
+class TextArena {
+private:
+    struct Block {
+        unique_ptr<char[]> data;
+        uint64_t start;   // position of data[0]
+        uint64_t bytes;
+    };
+
+    static constexpr int kChunkShift = 20;
+    static constexpr uint64_t kChunkBytes = uint64_t(1) << kChunkShift;
+
+    vector<Block> blocks;
+    vector<char*> slots;  // base address of each kChunkBytes slot
+    uint64_t used;        // position of the next free byte
+    uint64_t blockEnd;    // position just past the last block
+
+    // Start a block of at least the given size at the next slot boundary
+    void addBlock(uint64_t bytes) {
+        bytes = (max<uint64_t>(bytes, 1) + kChunkBytes - 1) & ~(kChunkBytes - 1);
+        Block block;
+        block.data.reset(new char[bytes]);
+        block.start = blockEnd;
+        block.bytes = bytes;
+        for (uint64_t offset = 0; offset < bytes; offset += kChunkBytes) slots.push_back(block.data.get() + offset);
+        blocks.push_back(move(block));
+        used = blockEnd;
+        blockEnd += bytes;
+    }
+
+public:
+    // Longest text a reference can describe; positions get the other 40 bits
+    static constexpr size_t kMaxLength = (size_t(1) << 24) - 1;
+
+    TextArena() : used(0), blockEnd(0) {}
+    TextArena(TextArena&&) = default;
+    TextArena& operator=(TextArena&&) = default;
+
+    TextArena(const TextArena& other) : used(0), blockEnd(0) {
+        for (const auto& block : other.blocks) {
+            addBlock(block.bytes);
+            uint64_t live = min(block.bytes, other.used - block.start);
+            memcpy(blocks.back().data.get(), block.data.get(), live);
+        }
+        used = other.used;
+    }
+
+    TextArena& operator=(const TextArena& other) {
+        if (this != &other) *this = TextArena(other);
+        return *this;
+    }
+
+    // Copy text into the arena in one contiguous piece; returns its position
+    uint64_t append(string_view text) {
+        if (text.empty()) return used;
+        if (text.size() > blockEnd - used) addBlock(text.size());
+        uint64_t position = used;
+        memcpy(slots[position >> kChunkShift] + (position & (kChunkBytes - 1)), text.data(), text.size());
+        used += text.size();
+        return position;
+    }
+
+    // Pack a position and length (at most kMaxLength) into one reference
+    static uint64_t ref(uint64_t position, size_t length) { return position << 24 | length; }
+
+    string_view view(uint64_t ref) const {
+        size_t length = static_cast<size_t>(ref & kMaxLength);
+        if (length == 0) return string_view();
+        uint64_t position = ref >> 24;
+        return string_view(slots[position >> kChunkShift] + (position & (kChunkBytes - 1)), length);
+    }
+
+    void clear() {
+        blocks.clear();
+        slots.clear();
+        used = blockEnd = 0;
+    }
+
+    // Text stored so far; the unused tail of the last block is not counted
+    size_t bytesUsed() const {
+        return static_cast<size_t>(used) + slots.capacity() * sizeof(char*) + blocks.capacity() * sizeof(Block);
+    }
+};
+
+// Running total for one (month, category, type) cell
+struct AggregateCell {
+    Money sum;
+    uint32_t count;
+
+    AggregateCell() : count(0) {}
+};
+
+inline uint64_t aggregateKey(int32_t monthKey, uint32_t categoryId, TransactionType type) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(monthKey)) << 32) |
+           (static_cast<uint64_t>(categoryId) << 1) | static_cast<uint64_t>(type);
+}
+
+// Sum, count and range of the amounts selected by an aggregation kernel
+struct AmountStats {
+    int64_t sum;      // Money units
+    uint64_t count;
+    int64_t minimum;  // INT64_MAX when count == 0
+    int64_t maximum;  // INT64_MIN when count == 0
+
+    AmountStats() : sum(0), count(0), minimum(INT64_MAX), maximum(INT64_MIN) {}
+
+    Money total() const { return Money::fromUnits(sum); }
+    Money smallest() const { return Money::fromUnits(count ? minimum : 0); }
+    Money largest() const { return Money::fromUnits(count ? maximum : 0); }
+};
+
+// Category filter value meaning "every category"
+const uint32_t kAnyCategory = UINT32_MAX;
+
+// Cells produced by groupByCategoryType: index = categoryId * 2 + type
+inline size_t categoryTypeCell(uint32_t categoryId, TransactionType type) {
+    return static_cast<size_t>(categoryId) * 2 + static_cast<uint8_t>(type);
+}
+
+// One implementation of the aggregation kernels over the dense ledger columns.
+// filteredStats: sum/count/min/max of amounts whose type matches (and category, unless kAnyCategory).
+struct AggregationKernels {
+    const char* name;
+    AmountStats (*filteredStats)(const uint8_t* types, const uint32_t* categoryIds, const int64_t* amounts,
+                                 size_t rows, uint8_t type, uint32_t categoryId);
+};
+
+inline AmountStats filteredStatsScalar(const uint8_t* types, const uint32_t* categoryIds, const int64_t* amounts,
+                                       size_t rows, uint8_t type, uint32_t categoryId) {
+    AmountStats stats;
+    for (size_t i = 0; i < rows; i++) {
+        if (types[i] != type || (categoryId != kAnyCategory && categoryIds[i] != categoryId)) continue;
+        stats.sum += amounts[i];
+        stats.count++;
+        stats.minimum = min(stats.minimum, amounts[i]);
+        stats.maximum = max(stats.maximum, amounts[i]);
+    }
+    return stats;
+}
+
+// Add every row into sums/counts[categoryTypeCell(...)]. This stays scalar:
+// without a scatter instruction a vector version only wins for a couple of
+// cells, and real ledgers have many more categories than that.
+inline void groupByCategoryType(const uint8_t* types, const uint32_t* categoryIds, const int64_t* amounts,
+                                size_t rows, int64_t* sums, uint64_t* counts) {
+    for (size_t i = 0; i < rows; i++) {
+        size_t cell = static_cast<size_t>(categoryIds[i]) * 2 + types[i];
+        sums[cell] += amounts[i];
+        counts[cell]++;
+    }
+}
+
+#ifdef EXPENSE_TRACKER_X86_KERNELS
+__attribute__((target("sse4.2")))
+inline AmountStats filteredStatsSse42(const uint8_t* types, const uint32_t* categoryIds, const int64_t* amounts,
+                                      size_t rows, uint8_t type, uint32_t categoryId) {
+    const __m128i wantType = _mm_set1_epi64x(type);
+    const __m128i wantCategory = _mm_set1_epi64x(categoryId);
+    const __m128i high = _mm_set1_epi64x(INT64_MAX);
+    const __m128i low = _mm_set1_epi64x(INT64_MIN);
+    const bool anyCategory = categoryId == kAnyCategory;
+    __m128i sum = _mm_setzero_si128(), count = _mm_setzero_si128(), lo = high, hi = low;
+
+    size_t i = 0;
+    for (; i + 2 <= rows; i += 2) {
+        uint16_t packedTypes;
+        memcpy(&packedTypes, types + i, sizeof(packedTypes));
+        __m128i mask = _mm_cmpeq_epi64(_mm_cvtepu8_epi64(_mm_cvtsi32_si128(packedTypes)), wantType);
+        if (!anyCategory) {
+            __m128i ids = _mm_cvtepu32_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(categoryIds + i)));
+            mask = _mm_and_si128(mask, _mm_cmpeq_epi64(ids, wantCategory));
+        }
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(amounts + i));
+        sum = _mm_add_epi64(sum, _mm_and_si128(value, mask));
+        count = _mm_sub_epi64(count, mask);
+        __m128i forMin = _mm_blendv_epi8(high, value, mask);
+        __m128i forMax = _mm_blendv_epi8(low, value, mask);
+        lo = _mm_blendv_epi8(lo, forMin, _mm_cmpgt_epi64(lo, forMin));
+        hi = _mm_blendv_epi8(hi, forMax, _mm_cmpgt_epi64(forMax, hi));
+    }
+
+    alignas(16) int64_t lanes[4][2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[0]), sum);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[1]), count);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[2]), lo);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[3]), hi);
+    AmountStats stats = filteredStatsScalar(types + i, categoryIds + i, amounts + i, rows - i, type, categoryId);
+    for (int lane = 0; lane < 2; lane++) {
+        stats.sum += lanes[0][lane];
+        stats.count += static_cast<uint64_t>(lanes[1][lane]);
+        stats.minimum = min(stats.minimum, lanes[2][lane]);
+        stats.maximum = max(stats.maximum, lanes[3][lane]);
+    }
+    return stats;
+}
+
+__attribute__((target("avx2")))
+inline AmountStats filteredStatsAvx2(const uint8_t* types, const uint32_t* categoryIds, const int64_t* amounts,
+                                     size_t rows, uint8_t type, uint32_t categoryId) {
+    const __m256i wantType = _mm256_set1_epi64x(type);
+    const __m256i wantCategory = _mm256_set1_epi64x(categoryId);
+    const __m256i high = _mm256_set1_epi64x(INT64_MAX);
+    const __m256i low = _mm256_set1_epi64x(INT64_MIN);
+    const bool anyCategory = categoryId == kAnyCategory;
+    __m256i sum = _mm256_setzero_si256(), count = _mm256_setzero_si256(), lo = high, hi = low;
+
+    size_t i = 0;
+    for (; i + 4 <= rows; i += 4) {
+        uint32_t packedTypes;
+        memcpy(&packedTypes, types + i, sizeof(packedTypes));
+        __m256i mask = _mm256_cmpeq_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(static_cast<int>(packedTypes))),
+                                          wantType);
+        if (!anyCategory) {
+            __m256i ids = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(categoryIds + i)));
+            mask = _mm256_and_si256(mask, _mm256_cmpeq_epi64(ids, wantCategory));
+        }
+        __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(amounts + i));
+        sum = _mm256_add_epi64(sum, _mm256_and_si256(value, mask));
+        count = _mm256_sub_epi64(count, mask);
+        __m256i forMin = _mm256_blendv_epi8(high, value, mask);
+        __m256i forMax = _mm256_blendv_epi8(low, value, mask);
+        lo = _mm256_blendv_epi8(lo, forMin, _mm256_cmpgt_epi64(lo, forMin));
+        hi = _mm256_blendv_epi8(hi, forMax, _mm256_cmpgt_epi64(forMax, hi));
+    }
+
+    alignas(32) int64_t lanes[4][4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[0]), sum);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[1]), count);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[2]), lo);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[3]), hi);
+    AmountStats stats = filteredStatsScalar(types + i, categoryIds + i, amounts + i, rows - i, type, categoryId);
+    for (int lane = 0; lane < 4; lane++) {
+        stats.sum += lanes[0][lane];
+        stats.count += static_cast<uint64_t>(lanes[1][lane]);
+        stats.minimum = min(stats.minimum, lanes[2][lane]);
+        stats.maximum = max(stats.maximum, lanes[3][lane]);
+    }
+    return stats;
+}
+#endif
+
+// Every kernel set this CPU can run, slowest first
+inline vector<AggregationKernels> supportedAggregationKernels() {
+    vector<AggregationKernels> kernels = {{"scalar", filteredStatsScalar}};
+#ifdef EXPENSE_TRACKER_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        kernels.push_back({"sse4.2", filteredStatsSse42});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({"avx2", filteredStatsAvx2});
+    }
+#endif
+    return kernels;
+}
+
+// Kernels used by the ledger: the widest supported set, unless
+// EXPENSE_TRACKER_SIMD names a specific one (e.g. "scalar")
+inline const AggregationKernels& aggregationKernels() {
+    static const AggregationKernels selected = [] {
+        vector<AggregationKernels> kernels = supportedAggregationKernels();
+        const char* requested = getenv("EXPENSE_TRACKER_SIMD");
+        if (requested) {
+            for (const auto& kernel : kernels) {
+                if (strcmp(kernel.name, requested) == 0) return kernel;
+            }
+        }
+        return kernels.back();
+    }();
+    return selected;
+}
+
+// Inverted index over transaction descriptions. Descriptions are split into
+// lower-cased words, and every distinct word keeps an ascending list of the
+// rows that contain it. Words are kept sorted (lazily) for prefix queries and
+// indexed by their trigrams for substring queries, so no query scans rows.
+class DescriptionIndex {
+private:
+    unordered_map<string, uint32_t> termIds;
+    vector<string> terms;
+    vector<vector<uint32_t>> postings;                       // term -> rows, ascending
+    unordered_map<uint32_t, vector<uint32_t>> trigramTerms;  // trigram -> terms, ascending
+    mutable vector<uint32_t> sortedTerms;                    // term ids ordered by text
+    mutable bool sortedStale;
+    string scratch;
+
+    static uint32_t trigramKey(string_view text, size_t at) {
+        return static_cast<uint32_t>(static_cast<unsigned char>(text[at])) << 16 |
+               static_cast<uint32_t>(static_cast<unsigned char>(text[at + 1])) << 8 |
+               static_cast<uint32_t>(static_cast<unsigned char>(text[at + 2]));
+    }
+
+    static bool isWordByte(unsigned char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+    }
+
+    // Rows of every term in ids, merged into one ascending list
+    vector<uint32_t> rowsOfTerms(const vector<uint32_t>& ids) const {
+        vector<uint32_t> rows;
+        if (ids.size() == 1) return postings[ids[0]];
+        for (uint32_t id : ids) rows.insert(rows.end(), postings[id].begin(), postings[id].end());
+        sort(rows.begin(), rows.end());
+        rows.erase(unique(rows.begin(), rows.end()), rows.end());
+        return rows;
+    }
+
+    // Terms containing word as a substring
+    vector<uint32_t> termsContaining(const string& word) const {
+        vector<uint32_t> candidates;
+        if (word.size() < 3) { // too short for trigrams: check every distinct word
+            for (uint32_t id = 0; id < terms.size(); id++) {
+                if (terms[id].find(word) != string::npos) candidates.push_back(id);
+            }
+            return candidates;
+        }
+
+        vector<const vector<uint32_t>*> lists;
+        for (size_t i = 0; i + 3 <= word.size(); i++) {
+            auto it = trigramTerms.find(trigramKey(word, i));
+            if (it == trigramTerms.end()) return candidates;
+            lists.push_back(&it->second);
+        }
+        sort(lists.begin(), lists.end(), [](const vector<uint32_t>* a, const vector<uint32_t>* b) {
+            return a->size() < b->size();
+        });
+        candidates = *lists[0];
+        for (size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+            vector<uint32_t> both;
+            set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(),
+                             back_inserter(both));
+            candidates.swap(both);
+        }
+        // Trigrams can match out of order; confirm the substring
+        candidates.erase(remove_if(candidates.begin(), candidates.end(),
+                                   [&](uint32_t id) { return terms[id].find(word) == string::npos; }),
+                         candidates.end());
+        return candidates;
+    }
+
+    // Terms starting with word
+    vector<uint32_t> termsWithPrefix(const string& word) const {
+        if (sortedStale) {
+            sortedTerms.resize(terms.size());
+            iota(sortedTerms.begin(), sortedTerms.end(), 0u);
+            sort(sortedTerms.begin(), sortedTerms.end(), [&](uint32_t a, uint32_t b) { return terms[a] < terms[b]; });
+            sortedStale = false;
+        }
+        vector<uint32_t> ids;
+        auto it = lower_bound(sortedTerms.begin(), sortedTerms.end(), word,
+                              [&](uint32_t id, const string& value) { return terms[id] < value; });
+        for (; it != sortedTerms.end() && terms[*it].compare(0, word.size(), word) == 0; ++it) ids.push_back(*it);
+        return ids;
+    }
+
+public:
+    DescriptionIndex() : sortedStale(false) {}
+
+    // Call visit(word) for every lower-cased word in text; word is only valid during the call
+    template <typename Visitor>
+    static void forEachWord(string_view text, string& buffer, Visitor&& visit) {
+        size_t i = 0;
+        while (i < text.size()) {
+            while (i < text.size() && !isWordByte(static_cast<unsigned char>(text[i]))) i++;
+            size_t start = i;
+            while (i < text.size() && isWordByte(static_cast<unsigned char>(text[i]))) i++;
+            if (i == start) continue;
+            buffer.assign(text.data() + start, i - start);
+            for (char& c : buffer) {
+                if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+            }
+            visit(buffer);
+        }
+    }
+
+    void add(uint32_t row, string_view description) {
+        forEachWord(description, scratch, [&](const string& word) {
+            auto found = termIds.find(word);
+            uint32_t id;
+            if (found == termIds.end()) {
+                id = static_cast<uint32_t>(terms.size());
+                termIds.emplace(word, id);
+                terms.push_back(word);
+                postings.emplace_back();
+                for (size_t i = 0; i + 3 <= word.size(); i++) {
+                    vector<uint32_t>& list = trigramTerms[trigramKey(word, i)];
+                    if (list.empty() || list.back() != id) list.push_back(id);
+                }
+                sortedStale = true;
+            } else {
+                id = found->second;
+            }
+            vector<uint32_t>& rows = postings[id];
+            if (rows.empty() || rows.back() != row) rows.push_back(row);
+        });
+    }
+
+    void clear() {
+        termIds.clear();
+        terms.clear();
+        postings.clear();
+        trigramTerms.clear();
+        sortedTerms.clear();
+        sortedStale = false;
+    }
+
+    size_t termCount() const { return terms.size(); }
+
+    // Approximate heap bytes held by the index
+    size_t bytesUsed() const {
+        size_t bytes = termIds.bucket_count() * sizeof(void*) + sortedTerms.capacity() * sizeof(uint32_t);
+        for (size_t id = 0; id < terms.size(); id++) {
+            bytes += 2 * (sizeof(string) + terms[id].capacity()) + 32 + sizeof(vector<uint32_t>) +
+                     postings[id].capacity() * sizeof(uint32_t);
+        }
+        bytes += trigramTerms.bucket_count() * sizeof(void*);
+        for (const auto& entry : trigramTerms) bytes += 32 + sizeof(vector<uint32_t>) + entry.second.capacity() * sizeof(uint32_t);
+        return bytes;
+    }
+
+    // Rows whose description matches every word of query, ascending. A word
+    // matches descriptions containing a word that starts with it; a word
+    // written with a leading '*' (e.g. "*mart") matches anywhere inside words.
+    vector<uint32_t> search(string_view query) const {
+        vector<uint32_t> result;
+        bool first = true;
+        string buffer;
+        size_t i = 0;
+        while (i < query.size()) {
+            while (i < query.size() && (query[i] == ' ' || query[i] == '\t')) i++;
+            size_t start = i;
+            while (i < query.size() && query[i] != ' ' && query[i] != '\t') i++;
+            string_view token = query.substr(start, i - start);
+            if (token.empty()) continue;
+            bool substring = token.front() == '*';
+
+            bool matchedAny = false;
+            forEachWord(token, buffer, [&](const string& word) {
+                matchedAny = true;
+                vector<uint32_t> rows = rowsOfTerms(substring ? termsContaining(word) : termsWithPrefix(word));
+                if (first) {
+                    result.swap(rows);
+                    first = false;
+                } else {
+                    vector<uint32_t> both;
+                    set_intersection(result.begin(), result.end(), rows.begin(), rows.end(), back_inserter(both));
+                    result.swap(both);
+                }
+            });
+            if (!matchedAny) continue;
+            if (result.empty()) break;
+        }
+        return result;
+    }
+};
+
+// A financial transaction as views into a Ledger's storage. The views stay
+// valid while the ledger lives: its text arena and category names never move.
+struct Transaction {
+    int32_t day;              // kUnknownDay if the date could not be parsed
+    string_view rawDate;      // original date text of such rows
+    string_view description;
+    Money amount;
+    string_view category;
+    TransactionType type;
+
+    Transaction(int32_t d, string_view raw, string_view desc, Money amt, string_view cat, TransactionType t)
+        : day(d), rawDate(raw), description(desc), amount(amt), category(cat), type(t) {}
+
+    string dateText() const { return day == kUnknownDay ? string(rawDate) : formatDate(day); }
+};
+
+// Day bounds meaning "no limit" (kUnknownDay itself marks undated rows)
+const int32_t kFirstDay = INT32_MIN + 1;
+const int32_t kLastDay = INT32_MAX;
+
+// Filter for Ledger::select(). Every bound is inclusive and unset bounds
+// match everything; undated rows only match when no date range is set.
+struct TransactionQuery {
+    int32_t firstDay;
+    int32_t lastDay;
+    Money minAmount;
+    Money maxAmount;
+    vector<uint32_t> categoryIds;  // empty for any category; unknown ids match nothing
+    bool anyType;
+    TransactionType type;          // used when anyType is false
+
+    TransactionQuery() : firstDay(kFirstDay), lastDay(kLastDay),
+                         minAmount(Money::fromUnits(INT64_MIN)), maxAmount(Money::fromUnits(INT64_MAX)),
+                         anyType(true), type(TransactionType::Expense) {}
+
+    bool hasDateRange() const { return firstDay != kFirstDay || lastDay != kLastDay; }
+};
+
+// Summary of one block of the date-ordered rows, used to skip blocks that
+// cannot match a query's amount, category or type filter
+struct RowZone {
+    int64_t minAmount;
+    int64_t maxAmount;
+    uint64_t categoryMask;  // bit (id % 64) of every category present
+    uint8_t typeMask;       // bit of every TransactionType present
+};
+
+// What a select() call had to look at
+struct SelectStats {
+    size_t rowsExamined = 0;
+    size_t zonesSkipped = 0;
+};
+
+// Multiset of 64-bit row fingerprints: open addressing with linear probing,
+// keys and counts in parallel arrays (12 bytes a slot, at most 70% full).
+// Key 0 marks an empty slot, so fingerprints are never 0.
+class FingerprintSet {
+private:
+    vector<uint64_t> keys;
+    vector<uint32_t> counts;
+    size_t distinct;
+
+    size_t homeSlot(uint64_t fingerprint) const {
+        return static_cast<size_t>(fingerprint ^ (fingerprint >> 29)) & (keys.size() - 1);
+    }
+
+    size_t slotOf(uint64_t fingerprint) const {
+        size_t mask = keys.size() - 1;
+        size_t slot = homeSlot(fingerprint);
+        while (keys[slot] != 0 && keys[slot] != fingerprint) slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void grow(size_t slots) {
+        vector<uint64_t> oldKeys(slots, 0);
+        vector<uint32_t> oldCounts(slots, 0);
+        oldKeys.swap(keys);
+        oldCounts.swap(counts);
+        for (size_t i = 0; i < oldKeys.size(); i++) {
+            if (oldKeys[i] == 0) continue;
+            size_t slot = slotOf(oldKeys[i]);
+            keys[slot] = oldKeys[i];
+            counts[slot] = oldCounts[i];
+        }
+    }
+
+public:
+    static const size_t npos = SIZE_MAX;
+
+    FingerprintSet() : distinct(0) {}
+
+    // Make room for this many distinct fingerprints without rehashing
+    void reserve(size_t fingerprints) {
+        size_t slots = 16;
+        while (slots * 7 < fingerprints * 10) slots *= 2;
+        if (slots > keys.size()) grow(slots);
+    }
+
+    void add(uint64_t fingerprint) {
+        if ((distinct + 1) * 10 > keys.size() * 7) grow(max<size_t>(16, keys.size() * 2));
+        size_t slot = slotOf(fingerprint);
+        if (keys[slot] == 0) {
+            keys[slot] = fingerprint;
+            distinct++;
+        }
+        counts[slot]++;
+    }
+
+    // Slot holding the fingerprint, or npos; slots stay put until the next add
+    size_t find(uint64_t fingerprint) const {
+        if (keys.empty()) return npos;
+        size_t slot = slotOf(fingerprint);
+        return keys[slot] == 0 ? npos : slot;
+    }
+
+    // Start loading a fingerprint's slot into cache ahead of find() or add()
+    void prefetch(uint64_t fingerprint) const {
+#if defined(__GNUC__) || defined(__clang__)
+        if (keys.empty()) return;
+        size_t slot = homeSlot(fingerprint);
+        __builtin_prefetch(keys.data() + slot);
+        __builtin_prefetch(counts.data() + slot);
+#else
+        (void)fingerprint;
+#endif
+    }
+
+    uint32_t countAt(size_t slot) const { return counts[slot]; }
+    uint32_t count(uint64_t fingerprint) const {
+        size_t slot = find(fingerprint);
+        return slot == npos ? 0 : counts[slot];
+    }
+
+    size_t size() const { return distinct; }
+    size_t slotCount() const { return keys.size(); }
+    void clear() { *this = FingerprintSet(); }
+
+    size_t bytesUsed() const {
+        return keys.capacity() * sizeof(uint64_t) + counts.capacity() * sizeof(uint32_t);
+    }
+
+    const vector<uint64_t>& keyColumn() const { return keys; }
+    const vector<uint32_t>& countColumn() const { return counts; }
+
+    // Adopt slot arrays written out by keyColumn()/countColumn(); false
+    // (leaving the set empty) if they do not form a valid table. Checks the
+    // shape only: probing always ends at an empty slot, and the snapshot
+    // checksum already vouches for the contents.
+    bool assign(vector<uint64_t> keySlots, vector<uint32_t> countSlots, uint64_t& total) {
+        clear();
+        total = 0;
+        size_t slots = keySlots.size();
+        if (slots != countSlots.size() || (slots & (slots - 1)) != 0) return false;
+        size_t used = 0;
+        for (size_t i = 0; i < slots; i++) {
+            if ((keySlots[i] == 0) != (countSlots[i] == 0)) return false;
+            used += keySlots[i] != 0;
+            total += countSlots[i];
+        }
+        if (slots > 0 && used * 10 > slots * 7) return false;
+        keys.swap(keySlots);
+        counts.swap(countSlots);
+        distinct = used;
+        return true;
+    }
+};
+
+// Fingerprint of a transaction for duplicate detection. Dates compare by day
+// when they parse; descriptions and categories ignore ASCII case and
+// surrounding or repeated whitespace, so re-exports that only reformat a row
+// still match it. scratch is reused to avoid allocating per row.
+inline uint64_t transactionFingerprint(int32_t day, string_view rawDate, string_view description, Money amount,
+                                       string_view category, TransactionType type, string& scratch) {
+    scratch.clear();
+    auto appendNormalized = [&](string_view text) {
+        bool space = false;
+        for (char c : text) {
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                space = true;
+                continue;
+            }
+            if (space && !scratch.empty() && scratch.back() != '\x1f') scratch.push_back(' ');
+            space = false;
+            scratch.push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c);
+        }
+        scratch.push_back('\x1f');  // field separator
+    };
+    if (day == kUnknownDay) appendNormalized(rawDate);
+    appendNormalized(description);
+    appendNormalized(category);
+
+    // 64-bit multiply-xorshift over 8-byte words with a murmur3 finalizer
+    uint64_t hash = 0x9E3779B97F4A7C15ull;
+    auto mix = [&hash](uint64_t word) {
+        hash ^= word;
+        hash *= 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    };
+    mix(static_cast<uint64_t>(static_cast<uint32_t>(day)) | (static_cast<uint64_t>(type) << 32));
+    mix(static_cast<uint64_t>(amount.toUnits()));
+    size_t i = 0;
+    for (; i + 8 <= scratch.size(); i += 8) {
+        uint64_t word;
+        memcpy(&word, scratch.data() + i, 8);
+        mix(word);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, scratch.data() + i, scratch.size() - i);
+    mix(tail ^ (static_cast<uint64_t>(scratch.size()) << 56));
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash == 0 ? 1 : hash;
+}
+
+struct FileStamp;  // size and modification time of a file, see fileStamp()
+
+// Structure-of-arrays transaction store. Each column is dense so that
+// aggregations scan only the bytes they need; categories are dictionary
+// encoded and descriptions live in a shared chunked text arena.
+class Ledger {
+private:
+    vector<TransactionType> types;
+    vector<uint32_t> categoryIds;
+    vector<int32_t> days;
+    vector<int64_t> amounts;                   // Money units (cents)
+    TextArena descriptionText;
+    vector<uint64_t> descriptionRefs;          // TextArena::ref of each description
+    StringDictionary categories;
+    unordered_map<uint32_t, string> rawDates;  // rows whose date could not be parsed
+    unordered_map<int32_t, uint32_t> monthSlots; // month key -> index into monthRows
+    vector<vector<uint32_t>> monthRows;        // rows of each month, in append order
+    int32_t lastMonthKey;                      // month of the most recently indexed row
+    uint32_t lastMonthSlot;                    // and its slot
+    vector<uint32_t> undatedRows;              // rows without a parsed date
+    unordered_map<uint64_t, AggregateCell> monthTotals; // (month, category, type) -> sum/count
+    size_t rowObjectBytes;                     // what a vector of string-owning row objects would use
+    DescriptionIndex descriptionIndex;         // word index, kept only when enabled
+    bool indexDescriptions;
+    // Dated rows ordered by (day, row) with a zone per kZoneRows of them.
+    // Appends keep both current, so select() only reads them; inside a
+    // BulkAppend the new rows are sorted and merged in once at the end.
+    vector<uint32_t> dayOrder;
+    vector<RowZone> zones;                     // full blocks of dayOrder only
+    size_t bulkDepth;                          // open BulkAppend scopes
+    size_t bulkStart;                          // dayOrder entries present when the outer one opened
+    bool bulkSorted;                           // rows added since then are already in day order
+    // Every row's fingerprint, for duplicate checks. Built on first use so
+    // loading a ledger never pays for it, then kept current and persisted.
+    FingerprintSet fingerprints;
+    bool fingerprinted;
+    string fingerprintScratch;
+
+    static constexpr size_t kZoneRows = 1024;
+
+    static size_t heapBytes(size_t length) {
+        return length > 15 ? length + 1 : 0;   // typical small-string buffer
+    }
+
+    // A row object owning its date, description, category and type strings
+    static constexpr size_t kRowObjectBytes = 4 * sizeof(string) + sizeof(Money);
+
+public:
+    Ledger() : lastMonthKey(kUnknownDay), lastMonthSlot(0), rowObjectBytes(0), indexDescriptions(false),
+               bulkDepth(0), bulkStart(0), bulkSorted(true), fingerprinted(false) {}
+
+    // Defers ordering the day index while many rows are appended, so a
+    // shuffled or newest-first file costs one sort instead of one insertion
+    // per row. select() must not be called while one is open.
+    class BulkAppend {
+    private:
+        Ledger& ledger;
+
+    public:
+        explicit BulkAppend(Ledger& target) : ledger(target) {
+            if (ledger.bulkDepth++ == 0) {
+                ledger.bulkStart = ledger.dayOrder.size();
+                ledger.bulkSorted = true;
+            }
+        }
+        ~BulkAppend() {
+            if (--ledger.bulkDepth == 0) ledger.mergeBulkRows();
+        }
+        BulkAppend(const BulkAppend&) = delete;
+        BulkAppend& operator=(const BulkAppend&) = delete;
+    };
+
+    size_t size() const { return amounts.size(); }
+    bool empty() const { return amounts.empty(); }
+
+    void reserve(size_t rows) {
+        types.reserve(rows);
+        categoryIds.reserve(rows);
+        days.reserve(rows);
+        amounts.reserve(rows);
+        descriptionRefs.reserve(rows);
+        if (fingerprinted) fingerprints.reserve(rows);
+    }
+
+    // Store one row; fingerprint is its transactionFingerprint if already known, else 0
+    void append(string_view date, string_view description, Money amount,
+                string_view category, TransactionType type, uint64_t fingerprint = 0) {
+        uint32_t row = static_cast<uint32_t>(amounts.size());
+        int32_t day = parseDate(date);
+        if (day == kUnknownDay) rawDates.emplace(row, string(date));
+        if (fingerprinted) {
+            if (fingerprint == 0) {
+                fingerprint = transactionFingerprint(day, date, description, amount, category, type,
+                                                     fingerprintScratch);
+            }
+            fingerprints.add(fingerprint);
+        }
+
+        types.push_back(type);
+        categoryIds.push_back(categories.intern(category));
+        days.push_back(day);
+        amounts.push_back(amount.toUnits());
+        description = description.substr(0, TextArena::kMaxLength);
+        descriptionRefs.push_back(TextArena::ref(descriptionText.append(description), description.size()));
+        indexRow(row);
+    }
+
+    // Add a stored row to the month index and aggregates
+    void indexRow(uint32_t row) {
+        if (days[row] == kUnknownDay) {
+            undatedRows.push_back(row);
+        } else {
+            int32_t monthKey = monthKeyFromDay(days[row]);
+            // Ledgers are mostly chronological, so the previous row's month list usually matches
+            if (monthKey != lastMonthKey) {
+                auto slot = monthSlots.emplace(monthKey, static_cast<uint32_t>(monthRows.size()));
+                if (slot.second) monthRows.emplace_back();
+                lastMonthKey = monthKey;
+                lastMonthSlot = slot.first->second;
+            }
+            monthRows[lastMonthSlot].push_back(row);
+            addToDayOrder(row);
+            AggregateCell& cell = monthTotals[aggregateKey(monthKey, categoryIds[row], types[row])];
+            cell.sum += Money::fromUnits(amounts[row]);
+            cell.count++;
+        }
+
+        size_t dateLength = 10;
+        if (!rawDates.empty()) {
+            auto raw = rawDates.find(row);
+            if (raw != rawDates.end()) dateLength = raw->second.size();
+        }
+        rowObjectBytes += kRowObjectBytes + heapBytes(dateLength) + heapBytes(description(row).size()) +
+                          heapBytes(category(row).size()) + heapBytes(strlen(typeName(types[row])));
+        if (indexDescriptions) descriptionIndex.add(row, description(row));
+    }
+
+    // Rebuild all derived indexes from the stored columns
+    void rebuildIndexes() {
+        monthSlots.clear();
+        monthRows.clear();
+        lastMonthKey = kUnknownDay;
+        undatedRows.clear();
+        monthTotals.clear();
+        rowObjectBytes = 0;
+        descriptionIndex.clear();
+        dayOrder.clear();
+        zones.clear();
+        BulkAppend bulk(*this);
+        for (size_t row = 0; row < size(); row++) indexRow(static_cast<uint32_t>(row));
+    }
+
+    // Index the words of every description and keep the index current on append
+    void enableDescriptionIndex() {
+        if (indexDescriptions) return;
+        indexDescriptions = true;
+        for (size_t row = 0; row < size(); row++) {
+            descriptionIndex.add(static_cast<uint32_t>(row), description(row));
+        }
+    }
+
+    bool hasDescriptionIndex() const { return indexDescriptions; }
+
+    // The stored columns without the derived indexes, for writing the ledger
+    // out (CSV rows or a snapshot) while this one keeps changing
+    Ledger storedCopy() const {
+        Ledger copy;
+        copy.types = types;
+        copy.categoryIds = categoryIds;
+        copy.days = days;
+        copy.amounts = amounts;
+        copy.descriptionText = descriptionText;
+        copy.descriptionRefs = descriptionRefs;
+        copy.categories = categories;
+        copy.rawDates = rawDates;
+        copy.fingerprints = fingerprints;
+        copy.fingerprinted = fingerprinted;
+        return copy;
+    }
+
+    // Fingerprint every stored row (on all cores) and keep the set current from now on
+    void buildFingerprints() {
+        if (fingerprinted) return;
+        vector<uint64_t> rowFingerprints(size());
+        unsigned threads = static_cast<unsigned>(min<size_t>(max(1u, thread::hardware_concurrency()),
+                                                             size() / 65536 + 1));
+        auto fingerprintRange = [&](size_t begin, size_t end) {
+            string scratch;
+            for (size_t row = begin; row < end; row++) {
+                rowFingerprints[row] = transactionFingerprint(days[row], rawDateText(row), description(row),
+                                                              amount(row), category(row), types[row], scratch);
+            }
+        };
+        vector<thread> workers;
+        for (unsigned i = 1; i < threads; i++) {
+            workers.emplace_back(fingerprintRange, size() * i / threads, size() * (i + 1) / threads);
+        }
+        fingerprintRange(0, size() / threads);
+        for (auto& worker : workers) worker.join();
+
+        fingerprints.clear();
+        fingerprints.reserve(size());
+        const size_t ahead = 8;
+        for (size_t row = 0; row < size(); row++) {
+            if (row + ahead < size()) fingerprints.prefetch(rowFingerprints[row + ahead]);
+            fingerprints.add(rowFingerprints[row]);
+        }
+        fingerprinted = true;
+    }
+
+    bool hasFingerprints() const { return fingerprinted; }
+    const FingerprintSet& fingerprintSet() const { return fingerprints; }
+
+    uint64_t fingerprintOf(string_view date, string_view description, Money amount, string_view category,
+                           TransactionType type) {
+        return transactionFingerprint(parseDate(date), date, description, amount, category, type,
+                                      fingerprintScratch);
+    }
+
+    // Fingerprint incoming rows and flag the ones already in the ledger. The
+    // k-th copy of a row within rows is a duplicate when the ledger already
+    // holds at least k copies, so an export that overlaps the ledger adds only
+    // what is new while identical rows inside one file stay separate
+    // transactions. Returns the number of duplicates.
+    size_t findDuplicates(const vector<RawRow>& rows, vector<uint64_t>& rowFingerprints,
+                          vector<uint8_t>& duplicate) {
+        buildFingerprints();
+        rowFingerprints.resize(rows.size());
+        duplicate.assign(rows.size(), 0);
+        for (size_t i = 0; i < rows.size(); i++) {
+            const RawRow& row = rows[i];
+            rowFingerprints[i] = fingerprintOf(row.date, row.description, row.amount, row.category,
+                                               parseType(row.type));
+        }
+        // Probes are cache misses on large ledgers, so fetch a few rows ahead
+        const size_t ahead = 8;
+        vector<uint32_t> matched;  // per slot; allocated on the first match
+        size_t duplicates = 0;
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (i + ahead < rows.size()) fingerprints.prefetch(rowFingerprints[i + ahead]);
+            size_t slot = fingerprints.find(rowFingerprints[i]);
+            if (slot == FingerprintSet::npos) continue;
+            if (matched.empty()) matched.resize(fingerprints.slotCount());
+            if (matched[slot] < fingerprints.countAt(slot)) {
+                matched[slot]++;
+                duplicate[i] = 1;
+                duplicates++;
+            }
+        }
+        return duplicates;
+    }
+    const DescriptionIndex& descriptions() const { return descriptionIndex; }
+
+    bool writeSnapshot(const string& path, const FileStamp& source) const;
+    bool loadSnapshot(string_view data, const FileStamp& expectedSource, string& error);
+
+    TransactionType type(size_t row) const { return types[row]; }
+    uint32_t categoryId(size_t row) const { return categoryIds[row]; }
+    int32_t day(size_t row) const { return days[row]; }
+    Money amount(size_t row) const { return Money::fromUnits(amounts[row]); }
+
+    string_view description(size_t row) const { return descriptionText.view(descriptionRefs[row]); }
+
+    const string& category(size_t row) const { return categories.name(categoryIds[row]); }
+
+    string dateText(size_t row) const {
+        if (days[row] != kUnknownDay) return formatDate(days[row]);
+        return string(rawDateText(row));
+    }
+
+    // Original text of a date that could not be parsed
+    string_view rawDateText(size_t row) const {
+        auto it = rawDates.find(static_cast<uint32_t>(row));
+        return it == rawDates.end() ? string_view() : string_view(it->second);
+    }
+
+    // One row as views into this ledger's storage
+    Transaction row(size_t row) const {
+        return Transaction(days[row], days[row] == kUnknownDay ? rawDateText(row) : string_view(), description(row),
+                           amount(row), category(row), types[row]);
+    }
+
+    // Rows dated in the given month (empty if none)
+    const vector<uint32_t>& rowsInMonth(int32_t monthKey) const {
+        static const vector<uint32_t> none;
+        auto it = monthSlots.find(monthKey);
+        return it == monthSlots.end() ? none : monthRows[it->second];
+    }
+
+    const vector<uint32_t>& rowsWithoutDate() const { return undatedRows; }
+
+    // Materialized total for one month/category/type; O(1)
+    AggregateCell monthTotal(int32_t monthKey, uint32_t categoryId, TransactionType type) const {
+        auto it = monthTotals.find(aggregateKey(monthKey, categoryId, type));
+        return it == monthTotals.end() ? AggregateCell() : it->second;
+    }
+
+    // Sum/count/min/max of one transaction type, optionally limited to one category
+    AmountStats amountStats(TransactionType type, uint32_t categoryId = kAnyCategory) const {
+        return aggregationKernels().filteredStats(reinterpret_cast<const uint8_t*>(types.data()), categoryIds.data(),
+                                                  amounts.data(), size(), static_cast<uint8_t>(type), categoryId);
+    }
+
+private:
+    // Put a dated row into dayOrder. Outside a BulkAppend an out-of-order row
+    // is moved back to its place, which costs one step per later row.
+    void addToDayOrder(uint32_t row) {
+        bool inOrder = dayOrder.size() == (bulkDepth ? bulkStart : 0) || days[dayOrder.back()] <= days[row];
+        dayOrder.push_back(row);
+        if (bulkDepth) {
+            bulkSorted = bulkSorted && inOrder;
+            return;
+        }
+        if (!inOrder) {
+            auto place = upper_bound(dayOrder.begin(), dayOrder.end() - 1, days[row],
+                                     [&](int32_t day, uint32_t other) { return day < days[other]; });
+            dropZonesFrom(static_cast<size_t>(place - dayOrder.begin()));
+            rotate(place, dayOrder.end() - 1, dayOrder.end());
+        }
+        buildZones();
+    }
+
+    // Sort the rows a BulkAppend added and merge them into the ordered ones
+    void mergeBulkRows() {
+        auto middle = dayOrder.begin() + bulkStart;
+        auto byDay = [&](uint32_t a, uint32_t b) { return days[a] < days[b]; };
+        if (!bulkSorted) stable_sort(middle, dayOrder.end(), byDay);
+        if (middle != dayOrder.begin() && middle != dayOrder.end() && byDay(*middle, *(middle - 1))) {
+            auto place = upper_bound(dayOrder.begin(), middle, days[*middle],
+                                     [&](int32_t day, uint32_t other) { return day < days[other]; });
+            dropZonesFrom(static_cast<size_t>(place - dayOrder.begin()));
+            inplace_merge(dayOrder.begin(), middle, dayOrder.end(), byDay);
+        }
+        buildZones();
+    }
+
+    // Forget the zones from the one holding dayOrder[position] onwards
+    void dropZonesFrom(size_t position) {
+        zones.resize(min(zones.size(), position / kZoneRows));
+    }
+
+    // Summarize the full blocks of dayOrder that have no zone yet
+    void buildZones() {
+        for (size_t zone = zones.size(); (zone + 1) * kZoneRows <= dayOrder.size(); zone++) {
+            RowZone summary = {INT64_MAX, INT64_MIN, 0, 0};
+            for (size_t i = zone * kZoneRows; i < (zone + 1) * kZoneRows; i++) {
+                uint32_t row = dayOrder[i];
+                summary.minAmount = min(summary.minAmount, amounts[row]);
+                summary.maxAmount = max(summary.maxAmount, amounts[row]);
+                summary.categoryMask |= 1ULL << (categoryIds[row] % 64);
+                summary.typeMask |= static_cast<uint8_t>(1u << static_cast<unsigned>(types[row]));
+            }
+            zones.push_back(summary);
+        }
+    }
+
+public:
+    // Rows matching query: dated rows in (day, row) order, then undated rows
+    // when no date range is set. The date range is found by binary search
+    // and zones that cannot hold a match are skipped without reading rows.
+    vector<uint32_t> select(const TransactionQuery& query, SelectStats* stats = nullptr) const {
+        SelectStats local;
+        SelectStats& counters = stats ? *stats : local;
+
+        bool anyCategory = query.categoryIds.empty();
+        vector<bool> categoryWanted(anyCategory ? 0 : categories.size(), false);
+        uint64_t categoryMask = anyCategory ? ~0ULL : 0;
+        for (uint32_t id : query.categoryIds) {
+            if (id >= categories.size()) continue;
+            categoryWanted[id] = true;
+            categoryMask |= 1ULL << (id % 64);
+        }
+        unsigned typeMask = query.anyType ? 3u : 1u << static_cast<unsigned>(query.type);
+        int64_t minAmount = query.minAmount.toUnits();
+        int64_t maxAmount = query.maxAmount.toUnits();
+        auto rowMatches = [&](uint32_t row) {
+            return (typeMask >> static_cast<unsigned>(types[row]) & 1) && amounts[row] >= minAmount &&
+                   amounts[row] <= maxAmount && (anyCategory || categoryWanted[categoryIds[row]]);
+        };
+
+        vector<uint32_t> result;
+        auto first = lower_bound(dayOrder.begin(), dayOrder.end(), query.firstDay,
+                                 [&](uint32_t row, int32_t day) { return days[row] < day; });
+        auto last = upper_bound(first, dayOrder.end(), query.lastDay,
+                                [&](int32_t day, uint32_t row) { return day < days[row]; });
+        size_t position = static_cast<size_t>(first - dayOrder.begin());
+        size_t stop = static_cast<size_t>(last - dayOrder.begin());
+        while (position < stop) {
+            size_t zone = position / kZoneRows;
+            size_t zoneEnd = min(stop, (zone + 1) * kZoneRows);
+            if (zone < zones.size()) {
+                const RowZone& summary = zones[zone];
+                if (!(summary.typeMask & typeMask) || !(summary.categoryMask & categoryMask) ||
+                    summary.maxAmount < minAmount || summary.minAmount > maxAmount) {
+                    counters.zonesSkipped++;
+                    position = zoneEnd;
+                    continue;
+                }
+            }
+            counters.rowsExamined += zoneEnd - position;
+            for (; position < zoneEnd; position++) {
+                if (rowMatches(dayOrder[position])) result.push_back(dayOrder[position]);
+            }
+        }
+
+        if (!query.hasDateRange()) {
+            counters.rowsExamined += undatedRows.size();
+            for (uint32_t row : undatedRows) {
+                if (rowMatches(row)) result.push_back(row);
+            }
+        }
+        return result;
+    }
+
+    // Latest transaction day, or kUnknownDay if no row has a date
+    int32_t latestDay() const {
+        return dayOrder.empty() ? kUnknownDay : days[dayOrder.back()];
+    }
+
+    // Cross-check the materialized totals against a full recomputation.
+    // Returns the number of mismatching cells and reports each one.
+    size_t verifyMonthTotals(ostream& out) const {
+        unordered_map<uint64_t, AggregateCell> recomputed;
+        for (size_t i = 0; i < size(); i++) {
+            if (days[i] == kUnknownDay) continue;
+            AggregateCell& cell = recomputed[aggregateKey(monthKeyFromDay(days[i]), categoryIds[i], types[i])];
+            cell.sum += Money::fromUnits(amounts[i]);
+            cell.count++;
+        }
+
+        size_t mismatches = 0;
+        for (const auto& entry : recomputed) {
+            auto it = monthTotals.find(entry.first);
+            if (it == monthTotals.end() || it->second.sum != entry.second.sum ||
+                it->second.count != entry.second.count) {
+                out << "Aggregate mismatch for key " << entry.first << ": expected "
+                    << entry.second.sum << " (" << entry.second.count << " rows)" << endl;
+                mismatches++;
+            }
+        }
+        if (recomputed.size() != monthTotals.size()) {
+            out << "Aggregate table has " << monthTotals.size() << " cells, expected "
+                << recomputed.size() << endl;
+            mismatches++;
+        }
+        return mismatches;
+    }
+
+    const vector<TransactionType>& typeColumn() const { return types; }
+    const vector<uint32_t>& categoryColumn() const { return categoryIds; }
+    const vector<int32_t>& dayColumn() const { return days; }
+    const vector<int64_t>& amountColumn() const { return amounts; }
+    const StringDictionary& categoryDictionary() const { return categories; }
+
+    size_t bytesUsed() const {
+        size_t bytes = types.capacity() * sizeof(TransactionType) + categoryIds.capacity() * sizeof(uint32_t) +
+                       days.capacity() * sizeof(int32_t) + amounts.capacity() * sizeof(int64_t) +
+                       descriptionText.bytesUsed() + descriptionRefs.capacity() * sizeof(uint64_t) +
+                       fingerprints.bytesUsed() +
+                       categories.bytesUsed();
+        for (const auto& raw : rawDates) bytes += sizeof(raw) + 2 * sizeof(void*) + heapBytes(raw.second.size());
+        bytes += monthTotals.size() * (sizeof(uint64_t) + sizeof(AggregateCell) + 2 * sizeof(void*));
+        bytes += monthSlots.size() * (sizeof(int32_t) + sizeof(uint32_t) + 2 * sizeof(void*));
+        for (const auto& rows : monthRows) bytes += sizeof(rows) + rows.capacity() * sizeof(uint32_t);
+        bytes += undatedRows.capacity() * sizeof(uint32_t);
+        bytes += dayOrder.capacity() * sizeof(uint32_t) + zones.capacity() * sizeof(RowZone);
+        return bytes;
+    }
+
+    // Bytes per row in this layout vs. the equivalent string-owning row objects
+    double bytesPerRow() const { return empty() ? 0.0 : static_cast<double>(bytesUsed()) / size(); }
+    double rowObjectBytesPerRow() const {
+        return empty() ? 0.0 : static_cast<double>(rowObjectBytes) / size();
+    }
+};
+
+// Fixed set of worker threads, each owning a task deque. A worker runs its
+// newest task first and, when its deque is empty, steals the oldest task of
+// another worker. The thread calling parallelFor() takes part as worker 0.
+// parallelFor() must not be called from two threads at once.
+class WorkStealingPool {
+private:
+    struct TaskQueue {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<TaskQueue>> queues;
+    vector<thread> workers;
+    mutex stateLock;
+    condition_variable wake;      // workers wait here for queued tasks
+    condition_variable finished;  // parallelFor waits here for the last task
+    atomic<size_t> queued;
+    atomic<size_t> unfinished;
+    atomic<size_t> steals;
+    bool stopping;
+
+    bool tryRun(size_t self) {
+        function<void()> task;
+        {
+            lock_guard<mutex> guard(queues[self]->lock);
+            if (!queues[self]->tasks.empty()) {
+                task = move(queues[self]->tasks.back());
+                queues[self]->tasks.pop_back();
+            }
+        }
+        for (size_t offset = 1; !task && offset < queues.size(); offset++) {
+            TaskQueue& victim = *queues[(self + offset) % queues.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = move(victim.tasks.front());
+                victim.tasks.pop_front();
+                steals++;
+            }
+        }
+        if (!task) return false;
+
+        queued--;
+        task();
+        if (--unfinished == 0) {
+            lock_guard<mutex> guard(stateLock);
+            finished.notify_all();
+        }
+        return true;
+    }
+
+    void workerLoop(size_t self) {
+        while (true) {
+            if (tryRun(self)) continue;
+            unique_lock<mutex> lock(stateLock);
+            wake.wait(lock, [&] { return stopping || queued > 0; });
+            if (stopping) return;
+        }
+    }
+
+public:
+    explicit WorkStealingPool(unsigned threads) : queued(0), unfinished(0), steals(0), stopping(false) {
+        threads = max(1u, threads);
+        for (unsigned i = 0; i < threads; i++) queues.push_back(make_unique<TaskQueue>());
+        for (unsigned i = 1; i < threads; i++) workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> guard(stateLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    unsigned threadCount() const { return static_cast<unsigned>(queues.size()); }
+    size_t stealCount() const { return steals; }
+
+    // Run body(0..tasks-1) across the pool and wait for all of them
+    void parallelFor(size_t tasks, const function<void(size_t)>& body) {
+        unfinished += tasks;
+        for (size_t i = 0; i < tasks; i++) {
+            TaskQueue& queue = *queues[i % queues.size()];
+            lock_guard<mutex> guard(queue.lock);
+            queued++;
+            queue.tasks.push_back([&body, i] { body(i); });
+        }
+        {
+            lock_guard<mutex> guard(stateLock);
+        }
+        wake.notify_all();
+
+        while (tryRun(0)) {}
+        unique_lock<mutex> lock(stateLock);
+        finished.wait(lock, [&] { return unfinished == 0; });
+    }
+};
+
+// Open-addressing hash table of aggregate cells keyed by aggregateKey()
+class AggregateTable {
+private:
+    static constexpr uint64_t kEmpty = UINT64_MAX; // never produced by aggregateKey()
+
+    vector<uint64_t> keys;
+    vector<AggregateCell> cells;
+    size_t used;
+    int shift;
+
+    size_t slotFor(uint64_t key) const {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> shift);
+    }
+
+    void grow() {
+        vector<uint64_t> oldKeys = move(keys);
+        vector<AggregateCell> oldCells = move(cells);
+        keys.assign(oldKeys.size() * 2, kEmpty);
+        cells.assign(oldKeys.size() * 2, AggregateCell());
+        shift--;
+        for (size_t i = 0; i < oldKeys.size(); i++) {
+            if (oldKeys[i] == kEmpty) continue;
+            size_t slot = slotFor(oldKeys[i]);
+            while (keys[slot] != kEmpty) slot = (slot + 1) & (keys.size() - 1);
+            keys[slot] = oldKeys[i];
+            cells[slot] = oldCells[i];
+        }
+    }
+
+public:
+    AggregateTable() : keys(64, kEmpty), cells(64), used(0), shift(58) {}
+
+    AggregateCell& operator[](uint64_t key) {
+        size_t slot = slotFor(key);
+        while (keys[slot] != key) {
+            if (keys[slot] == kEmpty) {
+                if ((used + 1) * 2 > keys.size()) {
+                    grow();
+                    return (*this)[key];
+                }
+                keys[slot] = key;
+                used++;
+                break;
+            }
+            slot = (slot + 1) & (keys.size() - 1);
+        }
+        return cells[slot];
+    }
+
+    size_t size() const { return used; }
+
+    template <typename Visitor>
+    void forEach(Visitor&& visit) const {
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (keys[i] != kEmpty) visit(keys[i], cells[i]);
+        }
+    }
+};
+
+// Month filter value meaning "every month"
+const int32_t kAnyMonth = INT32_MAX;
+
+// A group-by over the ledger. Results are always split by type; month and
+// category are kept only when requested. Filters narrow the rows first.
+struct GroupQuery {
+    bool byMonth;
+    bool byCategory;
+    int32_t monthKey;      // kAnyMonth for no filter
+    int32_t firstDay;      // inclusive day range; kFirstDay/kLastDay for no filter
+    int32_t lastDay;
+    uint32_t categoryId;   // kAnyCategory for no filter
+    bool anyType;
+    TransactionType type;  // used when anyType is false
+
+    GroupQuery() : byMonth(false), byCategory(true), monthKey(kAnyMonth), firstDay(kFirstDay), lastDay(kLastDay),
+                   categoryId(kAnyCategory), anyType(true), type(TransactionType::Expense) {}
+
+    bool hasDateRange() const { return firstDay != kFirstDay || lastDay != kLastDay; }
+};
+
+// One output group. monthKey is kAnyMonth / categoryId kAnyCategory when
+// that dimension is not grouped; undated rows group under kUnknownDay.
+struct QueryRow {
+    int32_t monthKey;
+    uint32_t categoryId;
+    TransactionType type;
+    AggregateCell cell;
+};
+
+// Group-by engine over a Ledger. Single-month queries are answered from the
+// ledger's materialized month totals and day ranges from the ledger's
+// date-ordered index; everything else is a parallel scan in which each chunk
+// builds its own table and the tables are merged in chunk order, so results
+// do not depend on scheduling.
+class QueryEngine {
+private:
+    const Ledger& ledger;
+    unsigned threads;
+    unique_ptr<WorkStealingPool> pool;  // created by the first parallel scan
+    double lastSeconds;
+    bool lastFromAggregates;
+
+    static constexpr size_t kMinChunkRows = 1 << 16;
+    static constexpr size_t kMinParallelRows = 1 << 18;
+
+    bool matches(const GroupQuery& query, size_t row) const {
+        return (query.anyType || ledger.type(row) == query.type) &&
+               (query.categoryId == kAnyCategory || ledger.categoryId(row) == query.categoryId) &&
+               (!query.hasDateRange() || (ledger.day(row) != kUnknownDay && ledger.day(row) >= query.firstDay &&
+                                          ledger.day(row) <= query.lastDay));
+    }
+
+    uint64_t groupKey(const GroupQuery& query, int32_t monthKey, uint32_t categoryId, TransactionType type) const {
+        return aggregateKey(query.byMonth ? monthKey : 0, query.byCategory ? categoryId : 0, type);
+    }
+
+    QueryRow decode(const GroupQuery& query, uint64_t key, const AggregateCell& cell) const {
+        QueryRow row;
+        row.monthKey = query.byMonth ? static_cast<int32_t>(static_cast<uint32_t>(key >> 32)) : kAnyMonth;
+        row.categoryId = query.byCategory ? static_cast<uint32_t>((key & 0xFFFFFFFFULL) >> 1) : kAnyCategory;
+        row.type = static_cast<TransactionType>(key & 1);
+        row.cell = cell;
+        return row;
+    }
+
+    // O(categories) answer from the materialized (month, category, type) totals
+    void fromAggregates(const GroupQuery& query, AggregateTable& table) const {
+        uint32_t firstCategory = query.categoryId == kAnyCategory ? 0 : query.categoryId;
+        uint32_t endCategory = query.categoryId == kAnyCategory ? static_cast<uint32_t>(ledger.categoryDictionary().size())
+                                                                 : query.categoryId + 1;
+        for (uint32_t id = firstCategory; id < endCategory; id++) {
+            for (TransactionType type : {TransactionType::Income, TransactionType::Expense}) {
+                if (!query.anyType && type != query.type) continue;
+                AggregateCell cell = ledger.monthTotal(query.monthKey, id, type);
+                if (cell.count == 0) continue;
+                AggregateCell& out = table[groupKey(query, query.monthKey, id, type)];
+                out.sum += cell.sum;
+                out.count += cell.count;
+            }
+        }
+    }
+
+    // Aggregate the rows inside the query's day range, found through Ledger::select()
+    void fromDayRange(const GroupQuery& query, AggregateTable& table) const {
+        TransactionQuery range;
+        range.firstDay = query.firstDay;
+        range.lastDay = query.lastDay;
+        if (query.categoryId != kAnyCategory) range.categoryIds.push_back(query.categoryId);
+        range.anyType = query.anyType;
+        range.type = query.type;
+        for (uint32_t row : ledger.select(range)) {
+            int32_t monthKey = monthKeyFromDay(ledger.day(row));
+            if (query.monthKey != kAnyMonth && monthKey != query.monthKey) continue;
+            AggregateCell& cell = table[groupKey(query, monthKey, ledger.categoryId(row), ledger.type(row))];
+            cell.sum += ledger.amount(row);
+            cell.count++;
+        }
+    }
+
+    // Aggregate rows [begin, end) into table
+    void scanChunk(const GroupQuery& query, size_t begin, size_t end, AggregateTable& table) const {
+        if (!query.byMonth && query.monthKey == kAnyMonth && !query.hasDateRange()) {
+            // No month or day involved: dense (category, type) cells straight off the columns
+            vector<int64_t> sums(ledger.categoryDictionary().size() * 2, 0);
+            vector<uint64_t> counts(sums.size(), 0);
+            groupByCategoryType(reinterpret_cast<const uint8_t*>(ledger.typeColumn().data()) + begin,
+                                ledger.categoryColumn().data() + begin, ledger.amountColumn().data() + begin,
+                                end - begin, sums.data(), counts.data());
+            for (size_t cell = 0; cell < sums.size(); cell++) {
+                uint32_t id = static_cast<uint32_t>(cell / 2);
+                TransactionType type = static_cast<TransactionType>(cell % 2);
+                if (counts[cell] == 0 || (query.categoryId != kAnyCategory && id != query.categoryId) ||
+                    (!query.anyType && type != query.type)) {
+                    continue;
+                }
+                AggregateCell& out = table[groupKey(query, 0, id, type)];
+                out.sum += Money::fromUnits(sums[cell]);
+                out.count += static_cast<uint32_t>(counts[cell]);
+            }
+            return;
+        }
+
+        // Rows are mostly chronological, so remember the day range of the last month seen
+        int32_t monthStart = 1, monthEnd = 0, monthKey = kUnknownDay;
+        for (size_t row = begin; row < end; row++) {
+            if (!matches(query, row)) continue;
+            int32_t day = ledger.day(row);
+            if (day == kUnknownDay) {
+                monthKey = kUnknownDay;
+                monthStart = 1;
+                monthEnd = 0;
+            } else if (day < monthStart || day >= monthEnd) {
+                monthKey = monthKeyFromDay(day);
+                int year = monthKey / 12;
+                unsigned month = static_cast<unsigned>(monthKey % 12) + 1;
+                monthStart = daysFromCivil(year, month, 1);
+                monthEnd = month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, month + 1, 1);
+            }
+            if (query.monthKey != kAnyMonth && monthKey != query.monthKey) continue;
+            AggregateCell& cell = table[groupKey(query, monthKey, ledger.categoryId(row), ledger.type(row))];
+            cell.sum += ledger.amount(row);
+            cell.count++;
+        }
+    }
+
+public:
+    explicit QueryEngine(const Ledger& source, unsigned threadCount = 0)
+        : ledger(source), threads(threadCount ? threadCount : max(1u, thread::hardware_concurrency())),
+          lastSeconds(0.0), lastFromAggregates(false) {}
+
+    unsigned threadCount() const { return threads; }
+    double lastQuerySeconds() const { return lastSeconds; }
+    bool lastQueryUsedAggregates() const { return lastFromAggregates; }
+
+    // Run a group-by; rows come back sorted by (month, category, type)
+    vector<QueryRow> groupBy(const GroupQuery& query, bool forceScan = false) {
+        ScopedTimer timer(TrackedOperation::Report);
+        auto start = chrono::steady_clock::now();
+        AggregateTable merged;
+        lastFromAggregates = !forceScan && !query.hasDateRange() && query.monthKey != kAnyMonth &&
+                             query.monthKey != kUnknownDay;
+
+        if (lastFromAggregates) {
+            fromAggregates(query, merged);
+        } else if (query.hasDateRange() && !forceScan) {
+            fromDayRange(query, merged);
+        } else if (threads == 1 || ledger.size() < kMinParallelRows) {
+            scanChunk(query, 0, ledger.size(), merged);
+        } else {
+            if (!pool) pool = make_unique<WorkStealingPool>(threads);
+            size_t chunkRows = max(kMinChunkRows, (ledger.size() + threads * 8 - 1) / (threads * 8));
+            size_t chunks = (ledger.size() + chunkRows - 1) / chunkRows;
+            vector<AggregateTable> partials(chunks);
+            pool->parallelFor(chunks, [&](size_t chunk) {
+                scanChunk(query, chunk * chunkRows, min(ledger.size(), (chunk + 1) * chunkRows), partials[chunk]);
+            });
+            for (const auto& partial : partials) {
+                partial.forEach([&](uint64_t key, const AggregateCell& cell) {
+                    AggregateCell& out = merged[key];
+                    out.sum += cell.sum;
+                    out.count += cell.count;
+                });
+            }
+        }
+
+        vector<pair<uint64_t, AggregateCell>> cells;
+        cells.reserve(merged.size());
+        merged.forEach([&](uint64_t key, const AggregateCell& cell) { cells.emplace_back(key, cell); });
+        sort(cells.begin(), cells.end(), [](const pair<uint64_t, AggregateCell>& a, const pair<uint64_t, AggregateCell>& b) {
+            int32_t monthA = static_cast<int32_t>(static_cast<uint32_t>(a.first >> 32));
+            int32_t monthB = static_cast<int32_t>(static_cast<uint32_t>(b.first >> 32));
+            return monthA != monthB ? monthA < monthB : (a.first & 0xFFFFFFFFULL) < (b.first & 0xFFFFFFFFULL);
+        });
+        vector<QueryRow> rows;
+        rows.reserve(cells.size());
+        for (const auto& entry : cells) rows.push_back(decode(query, entry.first, entry.second));
+        lastSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return rows;
+    }
+};
+
+// CRC-32 (IEEE) used to detect torn or corrupted records on disk
+inline uint32_t crc32(string_view data, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool initialized = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)initialized;
+    crc = ~crc;
+    for (unsigned char byte : data) crc = table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Flush a stdio stream all the way to stable storage
+inline bool syncFile(FILE* file) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// Cut a file back to size bytes
+inline bool truncateFile(const string& path, uint64_t size) {
+#ifdef _WIN32
+    int descriptor = _open(path.c_str(), _O_WRONLY | _O_BINARY);
+    if (descriptor < 0) return false;
+    bool ok = _chsize_s(descriptor, static_cast<__int64>(size)) == 0;
+    _close(descriptor);
+    return ok;
+#else
+    return truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+// Atomically replace target with source (both on the same filesystem)
+inline bool replaceFile(const string& source, const string& target) {
+#ifdef _WIN32
+    return MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(source.c_str(), target.c_str()) == 0;
+#endif
+}
+
+// Size of a file in bytes, or 0 if it does not exist
+inline uint64_t fileSizeOrZero(const string& path) {
+    error_code ec;
+    uint64_t size = filesystem::file_size(path, ec);
+    return ec ? 0 : size;
+}
+
+// Size and modification time of a file, kept by a snapshot to tell whether
+// the CSV file it mirrors has changed since it was written
+struct FileStamp {
+    uint64_t size = 0;
+    int64_t modified = 0;  // file clock ticks; 0 if the file does not exist
+};
+
+inline FileStamp fileStamp(const string& path) {
+    FileStamp stamp;
+    stamp.size = fileSizeOrZero(path);
+    error_code ec;
+    auto modified = filesystem::last_write_time(path, ec);
+    if (!ec) stamp.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+    return stamp;
+}
+
+// Write a day number as YYYY-MM-DD (at most 16 bytes); returns the end of the text
+inline char* formatIsoDate(char* out, int32_t days) {
+    int year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    if (year < 0 || year > 9999) {
+        return out + snprintf(out, 16, "%04d-%02u-%02u", year, month % 100, day % 100);
+    }
+    out[0] = static_cast<char>('0' + year / 1000);
+    out[1] = static_cast<char>('0' + year / 100 % 10);
+    out[2] = static_cast<char>('0' + year / 10 % 10);
+    out[3] = static_cast<char>('0' + year % 10);
+    out[4] = '-';
+    out[5] = static_cast<char>('0' + month / 10);
+    out[6] = static_cast<char>('0' + month % 10);
+    out[7] = '-';
+    out[8] = static_cast<char>('0' + day / 10);
+    out[9] = static_cast<char>('0' + day % 10);
+    return out + 10;
+}
+
+// Buffered CSV writer. Rows are formatted into a large reusable buffer that
+// is flushed in big blocks; output goes to a temporary file that replaces
+// the target only in commit(), so a crash never leaves a half-written file.
+class CsvWriter {
+private:
+    string path;
+    string tempPath;
+    FILE* file;
+    vector<char> buffer;
+    size_t used;
+    uint64_t written;
+    bool failed;
+
+    void ensure(size_t bytes) {
+        if (used + bytes > buffer.size()) flush();
+        if (bytes > buffer.size()) buffer.resize(bytes);
+    }
+
+    void flush() {
+        if (used == 0 || !file) return;
+        if (fwrite(buffer.data(), 1, used, file) != used) failed = true;
+        written += used;
+        used = 0;
+    }
+
+public:
+    explicit CsvWriter(const string& target, size_t bufferBytes = 4 << 20)
+        : path(target), tempPath(target + ".tmp"), file(nullptr), buffer(bufferBytes), used(0),
+          written(0), failed(false) {
+        file = fopen(tempPath.c_str(), "wb");
+        if (file) setvbuf(file, nullptr, _IONBF, 0); // we already write whole blocks
+    }
+
+    ~CsvWriter() {
+        if (file) { // not committed: discard the partial output
+            fclose(file);
+            remove(tempPath.c_str());
+        }
+    }
+
+    CsvWriter(const CsvWriter&) = delete;
+    CsvWriter& operator=(const CsvWriter&) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+
+    void raw(string_view text) {
+        ensure(text.size());
+        memcpy(buffer.data() + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    void field(string_view text) {
+        bool needsQuotes = text.find_first_of(",\"\r\n") != string_view::npos;
+        if (!needsQuotes) {
+            raw(text);
+            return;
+        }
+        string quoted;
+        appendCsvField(quoted, text);
+        raw(quoted);
+    }
+
+    void amount(Money value) {
+        ensure(32);
+        used = static_cast<size_t>(value.format(buffer.data() + used) - buffer.data());
+    }
+
+    void integer(uint64_t value) {
+        ensure(24);
+        auto result = to_chars(buffer.data() + used, buffer.data() + buffer.size(), value);
+        used = static_cast<size_t>(result.ptr - buffer.data());
+    }
+
+    // YYYY-MM-DD without going through a temporary string
+    void date(int32_t days) {
+        ensure(16);
+        used = static_cast<size_t>(formatIsoDate(buffer.data() + used, days) - buffer.data());
+    }
+
+    void separator() { raw(","); }
+    void endRow() { raw("\n"); }
+
+    // Flush, sync and atomically move the output into place
+    bool commit() {
+        if (!file) return false;
+        flush();
+        bool ok = !failed && syncFile(file);
+        ok = fclose(file) == 0 && ok;
+        file = nullptr;
+        if (ok) ok = replaceFile(tempPath, path);
+        if (!ok) remove(tempPath.c_str());
+        return ok;
+    }
+
+    uint64_t bytesWritten() const { return written + used; }
+};
+
+// Write every ledger row in the standard Date,Description,Amount,Category,Type layout
+inline void writeLedgerRows(CsvWriter& writer, const Ledger& ledger) {
+    const auto& days = ledger.dayColumn();
+    for (size_t i = 0; i < ledger.size(); i++) {
+        if (days[i] != kUnknownDay) {
+            writer.date(days[i]);
+        } else {
+            writer.field(ledger.rawDateText(i));
+        }
+        writer.separator();
+        writer.field(ledger.description(i));
+        writer.separator();
+        writer.amount(ledger.amount(i));
+        writer.separator();
+        writer.field(ledger.category(i));
+        writer.separator();
+        writer.raw(typeName(ledger.type(i)));
+        writer.endRow();
+    }
+}
+
+// Buffered text output for reports. Everything is formatted into one large
+// buffer that is written to stdout, a file or a pipe in big blocks; endl
+// does not flush it, only flush() or a full buffer does. Table rows use the
+// column writers below; free-form sections write through stream().
+class ReportRenderer : private streambuf {
+private:
+    FILE* sink;
+    bool ownsSink;
+    vector<char> buffer;
+    ostream out;
+    uint64_t written;
+    bool failed;
+
+    void writeBuffer() {
+        size_t used = static_cast<size_t>(pptr() - pbase());
+        if (used > 0 && sink && fwrite(pbase(), 1, used, sink) != used) failed = true;
+        written += used;
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+
+    int_type overflow(int_type ch) override {
+        writeBuffer();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override { return 0; } // endl must not flush every line
+
+    char* reserve(size_t bytes) {
+        if (static_cast<size_t>(epptr() - pptr()) < bytes) writeBuffer();
+        return pptr();
+    }
+
+public:
+    explicit ReportRenderer(FILE* stream = stdout, size_t bufferBytes = 1 << 20)
+        : sink(stream), ownsSink(false), buffer(max<size_t>(bufferBytes, 256)), out(this), written(0), failed(false) {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+
+    // Render into a file instead of stdout
+    explicit ReportRenderer(const string& path, size_t bufferBytes = 1 << 20)
+        : ReportRenderer(fopen(path.c_str(), "wb"), bufferBytes) {
+        ownsSink = true;
+    }
+
+    ~ReportRenderer() {
+        flush();
+        if (ownsSink && sink) fclose(sink);
+    }
+
+    ReportRenderer(const ReportRenderer&) = delete;
+    ReportRenderer& operator=(const ReportRenderer&) = delete;
+
+    bool isOpen() const { return sink != nullptr; }
+    ostream& stream() { return out; }
+
+    void text(string_view value) { pad(value, 0, 0); }
+
+    // value with before/after spaces around it, copied straight into the buffer
+    void pad(string_view value, size_t before, size_t after) {
+        size_t total = before + value.size() + after;
+        char* cursor = reserve(total);
+        if (static_cast<size_t>(epptr() - cursor) < total) { // wider than the whole buffer
+            for (size_t i = 0; i < before; i++) sputc(' ');
+            sputn(value.data(), static_cast<streamsize>(value.size()));
+            for (size_t i = 0; i < after; i++) sputc(' ');
+            return;
+        }
+        memset(cursor, ' ', before);
+        memcpy(cursor + before, value.data(), value.size());
+        memset(cursor + before + value.size(), ' ', after);
+        pbump(static_cast<int>(total));
+    }
+
+    // value left-aligned in a column of width bytes (never truncated)
+    void left(string_view value, size_t width) {
+        pad(value, 0, value.size() < width ? width - value.size() : 0);
+    }
+
+    // value right-aligned in a column of width bytes
+    void right(string_view value, size_t width) {
+        pad(value, value.size() < width ? width - value.size() : 0, 0);
+    }
+
+    void money(Money value, size_t width) {
+        char digits[32];
+        right(string_view(digits, value.format(digits) - digits), width);
+    }
+
+    void date(int32_t days, size_t width) {
+        char digits[16];
+        left(string_view(digits, formatIsoDate(digits, days) - digits), width);
+    }
+
+    // One CSV field, quoted only when it needs to be
+    void csvField(string_view value) {
+        if (value.find_first_of(",\"\r\n") == string_view::npos) {
+            text(value);
+            return;
+        }
+        string quoted;
+        appendCsvField(quoted, value);
+        text(quoted);
+    }
+
+    void newline() { text("\n"); }
+
+    // Write out everything rendered so far
+    bool flush() {
+        writeBuffer();
+        if (sink) fflush(sink);
+        return !failed;
+    }
+
+    uint64_t bytesRendered() const { return written + static_cast<uint64_t>(pptr() - pbase()); }
+};
+
+// Render one ledger row as a line of the fixed-width transaction table
+inline void renderTransactionRow(ReportRenderer& renderer, const Ledger& ledger, size_t i) {
+    if (ledger.day(i) != kUnknownDay) {
+        renderer.date(ledger.day(i), 20);
+    } else {
+        renderer.left(ledger.rawDateText(i).substr(0, 19), 20);
+    }
+    renderer.left(ledger.description(i).substr(0, 29), 30);
+    renderer.text("$");
+    renderer.money(ledger.amount(i), 10);
+    renderer.left(string_view(ledger.category(i)).substr(0, 14), 15);
+    renderer.left(typeName(ledger.type(i)), 10);
+    renderer.newline();
+}
+
+// Render ledger rows [begin, end) as the fixed-width transaction table
+inline void renderTransactionRows(ReportRenderer& renderer, const Ledger& ledger, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) renderTransactionRow(renderer, ledger, i);
+}
+
+// Render one ledger row as a CSV line
+inline void renderCsvRow(ReportRenderer& renderer, const Ledger& ledger, size_t i) {
+    if (ledger.day(i) != kUnknownDay) {
+        renderer.date(ledger.day(i), 0);
+    } else {
+        renderer.csvField(ledger.rawDateText(i));
+    }
+    renderer.text(",");
+    renderer.csvField(ledger.description(i));
+    renderer.text(",");
+    renderer.money(ledger.amount(i), 0);
+    renderer.text(",");
+    renderer.csvField(ledger.category(i));
+    renderer.text(",");
+    renderer.text(typeName(ledger.type(i)));
+    renderer.newline();
+}
+
+// Render ledger rows [begin, end) as CSV with a header line
+inline void renderCsvRows(ReportRenderer& renderer, const Ledger& ledger, size_t begin, size_t end) {
+    renderer.text("Date,Description,Amount,Category,Type\n");
+    for (size_t i = begin; i < end; i++) renderCsvRow(renderer, ledger, i);
+}
+
+// Fast 64-bit checksum over a byte stream, consumed eight bytes at a time
+class Checksum64 {
+private:
+    uint64_t state;
+    uint64_t carry;
+    size_t carryBytes;
+    uint64_t length;
+
+    void mix(uint64_t word) {
+        state ^= word;
+        state = (state << 29) | (state >> 35);
+        state *= 0x9E3779B97F4A7C15ull;
+    }
+
+public:
+    Checksum64() : state(0x243F6A8885A308D3ull), carry(0), carryBytes(0), length(0) {}
+
+    void update(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        length += size;
+        while (carryBytes > 0 && size > 0) {
+            carry |= static_cast<uint64_t>(*bytes++) << (8 * carryBytes++);
+            size--;
+            if (carryBytes == 8) {
+                mix(carry);
+                carry = 0;
+                carryBytes = 0;
+            }
+        }
+        for (; size >= 8; size -= 8, bytes += 8) {
+            uint64_t word;
+            memcpy(&word, bytes, 8);
+            mix(word);
+        }
+        while (size-- > 0) carry |= static_cast<uint64_t>(*bytes++) << (8 * carryBytes++);
+    }
+
+    uint64_t finish() const {
+        Checksum64 copy = *this;
+        if (copy.carryBytes > 0) copy.mix(copy.carry);
+        copy.mix(length);
+        return copy.state;
+    }
+};
+
+// On-disk header of a binary ledger snapshot. Sections follow in order, each
+// padded to 8 bytes: types, category ids, days, amounts, description ends,
+// description text, category string table, unparsed-date table.
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;         // 0x01020304 as written by the producing host
+    uint64_t rowCount;
+    uint64_t categoryCount;
+    uint64_t descriptionBytes;
+    uint64_t categoryTableBytes;
+    uint64_t rawDateTableBytes;
+    uint64_t sourceSize;        // size of the CSV file this snapshot mirrors
+    int64_t sourceModified;     // and its modification time (FileStamp::modified)
+    uint64_t fingerprintSlots;  // slots of the fingerprint table
+    uint64_t payloadBytes;
+    uint64_t checksum;          // Checksum64 of the payload
+};
+
+const char kSnapshotMagic[8] = {'E', 'T', 'S', 'N', 'A', 'P', '\0', '\1'};
+// 2: amounts stored as int64 cents, 3: fingerprint table, 4: source modification time
+const uint32_t kSnapshotVersion = 4;
+const uint32_t kSnapshotByteOrder = 0x01020304;
+
+inline uint64_t paddedSize(uint64_t size) { return (size + 7) & ~static_cast<uint64_t>(7); }
+
+// Write the ledger as a binary snapshot (temp file + rename)
+bool Ledger::writeSnapshot(const string& path, const FileStamp& source) const {
+    ScopedTimer timer(TrackedOperation::SnapshotWrite);
+    timer.addRows(size());
+    string categoryTable;
+    for (uint32_t id = 0; id < categories.size(); id++) {
+        uint32_t length = static_cast<uint32_t>(categories.name(id).size());
+        categoryTable.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        categoryTable.append(categories.name(id));
+    }
+    vector<pair<uint32_t, const string*>> sortedRawDates;
+    for (const auto& raw : rawDates) sortedRawDates.emplace_back(raw.first, &raw.second);
+    sort(sortedRawDates.begin(), sortedRawDates.end());
+    string rawDateTable;
+    for (const auto& raw : sortedRawDates) {
+        uint32_t length = static_cast<uint32_t>(raw.second->size());
+        rawDateTable.append(reinterpret_cast<const char*>(&raw.first), sizeof(raw.first));
+        rawDateTable.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        rawDateTable.append(*raw.second);
+    }
+    // The file keeps descriptions back to back with cumulative end offsets
+    vector<uint64_t> descriptionEnds;
+    descriptionEnds.reserve(size());
+    uint64_t descriptionBytes = 0;
+    for (size_t row = 0; row < size(); row++) {
+        descriptionBytes += description(row).size();
+        descriptionEnds.push_back(descriptionBytes);
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.byteOrder = kSnapshotByteOrder;
+    header.rowCount = size();
+    header.categoryCount = categories.size();
+    header.descriptionBytes = descriptionBytes;
+    header.categoryTableBytes = categoryTable.size();
+    header.rawDateTableBytes = rawDateTable.size();
+    header.sourceSize = source.size;
+    header.sourceModified = source.modified;
+    header.fingerprintSlots = fingerprints.slotCount();
+
+    string temp = path + ".tmp";
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (!file) return false;
+
+    Checksum64 checksum;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    auto writeBytes = [&](const void* data, uint64_t bytes) {
+        if (bytes > 0) ok = ok && fwrite(data, 1, bytes, file) == bytes;
+        checksum.update(data, bytes);
+        header.payloadBytes += bytes;
+    };
+    auto writePadding = [&](uint64_t bytes) {
+        static const char zeros[8] = {0};
+        writeBytes(zeros, paddedSize(bytes) - bytes);
+    };
+    auto writeSection = [&](const void* data, uint64_t bytes) {
+        writeBytes(data, bytes);
+        writePadding(bytes);
+    };
+    writeSection(types.data(), types.size() * sizeof(TransactionType));
+    writeSection(categoryIds.data(), categoryIds.size() * sizeof(uint32_t));
+    writeSection(days.data(), days.size() * sizeof(int32_t));
+    writeSection(amounts.data(), amounts.size() * sizeof(int64_t));
+    writeSection(descriptionEnds.data(), descriptionEnds.size() * sizeof(uint64_t));
+    // Rows stored next to each other in the arena go out in one write
+    string_view run;
+    for (size_t row = 0; row < size(); row++) {
+        string_view text = description(row);
+        if (text.empty()) continue;
+        if (!run.empty() && run.data() + run.size() == text.data()) {
+            run = string_view(run.data(), run.size() + text.size());
+        } else {
+            writeBytes(run.data(), run.size());
+            run = text;
+        }
+    }
+    writeBytes(run.data(), run.size());
+    writePadding(descriptionBytes);
+    writeSection(categoryTable.data(), categoryTable.size());
+    writeSection(rawDateTable.data(), rawDateTable.size());
+    writeSection(fingerprints.keyColumn().data(), fingerprints.slotCount() * sizeof(uint64_t));
+    writeSection(fingerprints.countColumn().data(), fingerprints.slotCount() * sizeof(uint32_t));
+
+    header.checksum = checksum.finish();
+    timer.addBytesWritten(sizeof(header) + header.payloadBytes);
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && syncFile(file);
+    ok = fclose(file) == 0 && ok;
+    if (ok) ok = replaceFile(temp, path);
+    if (!ok) remove(temp.c_str());
+    return ok;
+}
+
+// Load a snapshot produced by writeSnapshot into an empty ledger
+bool Ledger::loadSnapshot(string_view data, const FileStamp& expectedSource, string& error) {
+    SnapshotHeader header;
+    if (data.size() < sizeof(header)) {
+        error = "file too small";
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 ||
+        header.byteOrder != kSnapshotByteOrder) {
+        error = "not a ledger snapshot";
+        return false;
+    }
+    if (header.version != kSnapshotVersion) {
+        error = "unsupported snapshot version " + to_string(header.version);
+        return false;
+    }
+    if (header.sourceSize != expectedSource.size || header.sourceModified != expectedSource.modified) {
+        error = "out of date";
+        return false;
+    }
+
+    uint64_t rows = header.rowCount;
+    uint64_t expectedPayload = paddedSize(rows * sizeof(TransactionType)) + paddedSize(rows * sizeof(uint32_t)) +
+                               paddedSize(rows * sizeof(int32_t)) + rows * sizeof(int64_t) + rows * sizeof(uint64_t) +
+                               paddedSize(header.descriptionBytes) + paddedSize(header.categoryTableBytes) +
+                               paddedSize(header.rawDateTableBytes) + header.fingerprintSlots * sizeof(uint64_t) +
+                               paddedSize(header.fingerprintSlots * sizeof(uint32_t));
+    string_view payload = data.substr(sizeof(header));
+    if (header.payloadBytes != expectedPayload || payload.size() != expectedPayload) {
+        error = "truncated or malformed";
+        return false;
+    }
+    Checksum64 checksum;
+    checksum.update(payload.data(), payload.size());
+    if (checksum.finish() != header.checksum) {
+        error = "checksum mismatch";
+        return false;
+    }
+
+    const char* cursor = payload.data();
+    auto takeColumn = [&](auto& column, uint64_t count) {
+        using Element = typename remove_reference<decltype(column)>::type::value_type;
+        column.resize(count);
+        if (count > 0) memcpy(column.data(), cursor, count * sizeof(Element));
+        cursor += paddedSize(count * sizeof(Element));
+    };
+    takeColumn(types, rows);
+    takeColumn(categoryIds, rows);
+    takeColumn(days, rows);
+    takeColumn(amounts, rows);
+    vector<uint64_t> descriptionEnds;
+    takeColumn(descriptionEnds, rows);
+    bool valid = rows == 0 || descriptionEnds.back() == header.descriptionBytes;
+    // All descriptions go into the arena as one piece, then each row refers into it
+    uint64_t base = descriptionText.append(string_view(cursor, header.descriptionBytes));
+    cursor += paddedSize(header.descriptionBytes);
+    descriptionRefs.resize(rows);
+    for (uint64_t i = 0; valid && i < rows; i++) {
+        uint64_t begin = i == 0 ? 0 : descriptionEnds[i - 1];
+        valid = descriptionEnds[i] >= begin && descriptionEnds[i] - begin <= TextArena::kMaxLength;
+        descriptionRefs[i] = TextArena::ref(base + begin, descriptionEnds[i] - begin);
+    }
+
+    string_view table(cursor, header.categoryTableBytes);
+    cursor += paddedSize(header.categoryTableBytes);
+    for (uint64_t id = 0; id < header.categoryCount; id++) {
+        uint32_t length;
+        if (table.size() < sizeof(length)) break;
+        memcpy(&length, table.data(), sizeof(length));
+        categories.intern(table.substr(sizeof(length), length));
+        table.remove_prefix(min<size_t>(table.size(), sizeof(length) + length));
+    }
+
+    string_view rawTable(cursor, header.rawDateTableBytes);
+    while (rawTable.size() >= 2 * sizeof(uint32_t)) {
+        uint32_t row, length;
+        memcpy(&row, rawTable.data(), sizeof(row));
+        memcpy(&length, rawTable.data() + sizeof(row), sizeof(length));
+        rawDates.emplace(row, string(rawTable.substr(2 * sizeof(uint32_t), length)));
+        rawTable.remove_prefix(min<size_t>(rawTable.size(), 2 * sizeof(uint32_t) + length));
+    }
+    cursor += paddedSize(header.rawDateTableBytes);
+
+    vector<uint64_t> fingerprintKeys;
+    vector<uint32_t> fingerprintCounts;
+    takeColumn(fingerprintKeys, header.fingerprintSlots);
+    takeColumn(fingerprintCounts, header.fingerprintSlots);
+    // A snapshot written before the fingerprints were built has none
+    uint64_t fingerprintedRows = 0;
+    fingerprinted = header.fingerprintSlots > 0;
+    valid = valid && fingerprints.assign(move(fingerprintKeys), move(fingerprintCounts), fingerprintedRows) &&
+            (!fingerprinted || fingerprintedRows == rows);
+
+    // Reject references that would read outside the loaded columns
+    valid = valid && categories.size() == header.categoryCount;
+    for (uint64_t i = 0; valid && i < rows; i++) valid = categoryIds[i] < categories.size();
+    if (!valid) {
+        *this = Ledger();
+        error = "inconsistent columns";
+        return false;
+    }
+
+    rebuildIndexes();
+    return true;
+}
+
+// Append-only write-ahead journal of transactions added since the last
+// compaction. Each record is a CSV line "<crc32>,<date>,<description>,<amount>,<category>,<type>"
+// whose checksum covers everything after the first comma.
+// The header records the size and modification time of the main data file
+// the journal applies to, so a journal left behind by an interrupted
+// compaction, or a data file replaced since, is recognized as stale.
+class TransactionJournal {
+private:
+    string path;
+    FILE* file;
+    string pending;             // records not yet written (group commit)
+    size_t pendingRecords;
+    size_t groupSize;           // write + fsync once this many records are pending
+    size_t records;             // records in the journal file
+    uint64_t durableBytes;      // file size after the last successful commit
+    size_t commits;
+    double commitSeconds;       // total time spent in commit()
+    double lastSeconds;         // time the last successful commit took
+    string failure;             // why the last commit or reset failed
+
+    static string header(const FileStamp& base) {
+        return "# expense-tracker journal v2 base=" + to_string(base.size) + " modified=" + to_string(base.modified) +
+               "\n";
+    }
+
+public:
+    explicit TransactionJournal(size_t group = 256)
+        : file(nullptr), pendingRecords(0), groupSize(group), records(0), durableBytes(0), commits(0),
+          commitSeconds(0.0), lastSeconds(0.0) {}
+
+    ~TransactionJournal() {
+        commit();
+        if (file) fclose(file);
+    }
+
+    TransactionJournal(const TransactionJournal&) = delete;
+    TransactionJournal& operator=(const TransactionJournal&) = delete;
+
+    // Whether an existing journal's header names the data file with this
+    // stamp. v1 headers hold only the size, so only the size is compared.
+    static bool appliesTo(string_view contents, const FileStamp& data) {
+        const string_view prefix = "# expense-tracker journal v";
+        if (contents.substr(0, prefix.size()) != prefix) return false;
+        contents.remove_prefix(prefix.size());
+        bool v1 = contents.substr(0, 7) == "1 base=";
+        if (!v1 && contents.substr(0, 7) != "2 base=") return false;
+        contents.remove_prefix(7);
+        const char* end = contents.data() + contents.size();
+        uint64_t size = 0;
+        auto result = from_chars(contents.data(), end, size);
+        if (result.ec != errc() || size != data.size) return false;
+        if (v1) return true;
+        const string_view modifiedKey = " modified=";
+        if (string_view(result.ptr, static_cast<size_t>(end - result.ptr)).substr(0, modifiedKey.size()) != modifiedKey) {
+            return false;
+        }
+        int64_t modified = 0;
+        result = from_chars(result.ptr + modifiedKey.size(), end, modified);
+        return result.ec == errc() && modified == data.modified;
+    }
+
+    // Open for appending; existingRecords is the number of valid records already replayed
+    bool open(const string& journalPath, size_t existingRecords) {
+        path = journalPath;
+        records = existingRecords;
+        durableBytes = fileSizeOrZero(path);
+        file = fopen(path.c_str(), "ab");
+        return file != nullptr;
+    }
+
+    // Truncate the journal and start a new one on top of the main file stamped base
+    bool reset(const FileStamp& base) {
+        pending.clear();
+        pendingRecords = 0;
+        if (file) fclose(file);
+
+        string temp = path + ".tmp";
+        FILE* fresh = fopen(temp.c_str(), "wb");
+        if (!fresh) {
+            failure = "could not create journal '" + temp + "': " + strerror(errno);
+            file = fopen(path.c_str(), "ab");
+            return false;
+        }
+        string head = header(base);
+        bool ok = fwrite(head.data(), 1, head.size(), fresh) == head.size();
+        ok = syncFile(fresh) && ok;
+        ok = fclose(fresh) == 0 && ok;
+        ok = ok && replaceFile(temp, path);
+        if (!ok) {
+            failure = "could not write journal '" + temp + "': " + strerror(errno);
+            remove(temp.c_str());
+        }
+
+        file = fopen(path.c_str(), "ab");
+        durableBytes = fileSizeOrZero(path);
+        if (ok) records = 0;
+        return ok && file != nullptr;
+    }
+
+    // Add one record to out in the journal's format, so callers can prepare
+    // records on one thread and append() them on another
+    static void formatRecord(string& out, string_view date, string_view description, Money amount,
+                             string_view category, TransactionType type) {
+        char amountText[32];
+        char* amountEnd = amount.format(amountText);
+        string body;
+        body.reserve(date.size() + description.size() + category.size() + 32);
+        appendCsvField(body, date);
+        body.push_back(',');
+        appendCsvField(body, description);
+        body.push_back(',');
+        body.append(amountText, amountEnd).append(1, ',');
+        appendCsvField(body, category);
+        body.push_back(',');
+        body.append(typeName(type));
+
+        char crcText[16];
+        snprintf(crcText, sizeof(crcText), "%08x,", crc32(body));
+        out.append(crcText).append(body).append(1, '\n');
+    }
+
+    // Queue count records made by formatRecord
+    void append(string_view formatted, size_t count) {
+        pending.append(formatted);
+        pendingRecords += count;
+        if (pendingRecords >= groupSize) commit();
+    }
+
+    // Write and fsync all pending records as one group. On failure the file
+    // is cut back to what was durable before and the records stay pending,
+    // so the next commit retries them; false is returned and error() says why.
+    bool commit() {
+        if (pendingRecords == 0) return true;
+        if (!file) {
+            failure = "journal '" + path + "' is not open";
+            return false;
+        }
+        auto start = chrono::steady_clock::now();
+        bool ok = fwrite(pending.data(), 1, pending.size(), file) == pending.size();
+        int error = errno; // read before a later call overwrites it
+        if (ok) {
+            ok = syncFile(file);
+            error = errno;
+        }
+        if (!ok) {
+            failure = "could not write journal '" + path + "': " + strerror(error);
+            fclose(file);
+            truncateFile(path, durableBytes); // cuts off the torn tail, including what fclose flushed
+            file = fopen(path.c_str(), "ab");
+            return false;
+        }
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        records += pendingRecords;
+        durableBytes += pending.size();
+        pending.clear();
+        pendingRecords = 0;
+        commits++;
+        commitSeconds += elapsed;
+        lastSeconds = elapsed;
+        return true;
+    }
+
+    const string& error() const { return failure; }
+    double lastCommitSeconds() const { return lastSeconds; }
+    size_t recordCount() const { return records + pendingRecords; }
+    size_t commitCount() const { return commits; }
+    double averageCommitSeconds() const { return commits ? commitSeconds / commits : 0.0; }
+};
+
+// Parse one tokenized journal record, verifying its checksum
+inline bool parseJournalRecord(string_view text, const vector<string_view>& fields, RawRow& row) {
+    if (text.size() < 10 || text[8] != ',' || fields.size() != 6) return false;
+    uint32_t expected = 0;
+    auto result = from_chars(text.data(), text.data() + 8, expected, 16);
+    if (result.ec != errc() || result.ptr != text.data() + 8) return false;
+    if (crc32(text.substr(9)) != expected) return false;
+
+    row.date = fields[1];
+    row.description = fields[2];
+    row.category = fields[4];
+    row.type = fields[5];
+    return parseAmount(fields[3], row.amount);
+}
+
+// One background thread for disk work. Tasks run one at a time in the
+// order they were submitted, so a journal write queued after an append
+// lands after it, and a save queued at some point covers exactly the
+// journal records queued before it.
+class IoWorker {
+private:
+    mutable mutex stateLock;
+    condition_variable wake;      // the worker waits here for tasks
+    condition_variable progress;  // wait() waits here for finished tasks
+    deque<function<void()>> tasks;
+    uint64_t submitted;
+    uint64_t finished;
+    double busySeconds;           // time spent running tasks
+    bool stopping;
+    thread worker;                // last, so it starts after the rest is set up
+
+    void workerLoop() {
+        unique_lock<mutex> lock(stateLock);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return; // stopping, and everything queued has run
+            function<void()> task = move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            auto start = chrono::steady_clock::now();
+            task();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            lock.lock();
+            busySeconds += seconds;
+            finished++;
+            progress.notify_all();
+        }
+    }
+
+public:
+    IoWorker() : submitted(0), finished(0), busySeconds(0.0), stopping(false), worker(&IoWorker::workerLoop, this) {}
+
+    // Runs everything still queued before returning
+    ~IoWorker() {
+        {
+            lock_guard<mutex> guard(stateLock);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    IoWorker(const IoWorker&) = delete;
+    IoWorker& operator=(const IoWorker&) = delete;
+
+    // Queue a task; returns its sequence number for wait()
+    uint64_t submit(function<void()> task) {
+        uint64_t sequence;
+        {
+            lock_guard<mutex> guard(stateLock);
+            tasks.push_back(move(task));
+            sequence = ++submitted;
+        }
+        wake.notify_one();
+        return sequence;
+    }
+
+    // Block until the task with the given sequence number, and all before it, has run
+    void wait(uint64_t sequence) {
+        unique_lock<mutex> lock(stateLock);
+        progress.wait(lock, [&] { return finished >= sequence; });
+    }
+
+    // Block until everything queued so far has run
+    void drain() {
+        uint64_t last;
+        {
+            lock_guard<mutex> guard(stateLock);
+            last = submitted;
+        }
+        wait(last);
+    }
+
+    size_t pending() const {
+        lock_guard<mutex> guard(stateLock);
+        return static_cast<size_t>(submitted - finished);
+    }
+
+    uint64_t completed() const {
+        lock_guard<mutex> guard(stateLock);
+        return finished;
+    }
+
+    double busyTime() const {
+        lock_guard<mutex> guard(stateLock);
+        return busySeconds;
+    }
+};
+
+// Outcome of importing one file into the tracker
+struct ImportReport {
+    size_t added = 0;
+    size_t duplicates = 0;  // rows skipped because the ledger already had them
+    size_t categorized = 0; // rows given a category by a categorization rule
+    size_t linesScanned = 0;
+    double seconds = 0.0;
+    unsigned threadsUsed = 1;
+    vector<pair<size_t, string>> errors; // line number -> message
+
+    double rowsPerSecond() const {
+        return seconds > 0 ? added / seconds : 0.0;
+    }
+};
+
+// Transactions matched by a search or query, with their totals
+struct SearchResult {
+    vector<uint32_t> rows;  // matching ledger rows
+    Money income;
+    Money expenses;
+    double seconds = 0.0;   // index lookup and totals
+};
+
+// Which parts of a report to render. Sections that are not requested are
+// not computed at all.
+struct ReportOptions {
+    size_t offset = 0;            // first transaction row to show
+    size_t limit = SIZE_MAX;      // maximum number of transaction rows
+    bool rows = true;             // transaction table
+    bool summary = false;         // income/expense totals
+    bool categories = false;      // category analysis
+    bool alerts = false;          // spending, budget and savings analysis
+    bool csv = false;             // transaction rows as CSV instead of a table
+};
+
+// How far spending is into a budget
+enum class BudgetLevel {
+    Good,
+    Alert,    // a lower threshold reached (60% by default)
+    Warning,  // the highest threshold below 100% reached (80% by default)
+    Over      // 100% or more
+};
+
+inline const char* budgetLevelName(BudgetLevel level) {
+    switch (level) {
+        case BudgetLevel::Over: return "over";
+        case BudgetLevel::Warning: return "warning";
+        case BudgetLevel::Alert: return "alert";
+        default: return "good";
+    }
+}
+
+inline BudgetLevel budgetLevel(Money spent, Money limit, const vector<int>& thresholds) {
+    if (spent.reachesPercent(limit, 100)) return BudgetLevel::Over;
+    bool highest = true;
+    for (auto it = thresholds.rbegin(); it != thresholds.rend(); ++it) {
+        if (*it >= 100) continue;
+        if (spent.reachesPercent(limit, *it)) return highest ? BudgetLevel::Warning : BudgetLevel::Alert;
+        highest = false;
+    }
+    return BudgetLevel::Good;
+}
+
+// Length of the window a budget rule limits
+enum class BudgetPeriod : uint8_t {
+    Weekly,   // Monday to Sunday
+    Monthly,
+    Yearly
+};
+
+const size_t kBudgetPeriods = 3;
+
+inline const char* budgetPeriodName(BudgetPeriod period) {
+    switch (period) {
+        case BudgetPeriod::Weekly: return "weekly";
+        case BudgetPeriod::Yearly: return "yearly";
+        default: return "monthly";
+    }
+}
+
+// "per week" / "per month" / "per year"
+inline const char* budgetPeriodUnit(BudgetPeriod period) {
+    switch (period) {
+        case BudgetPeriod::Weekly: return "week";
+        case BudgetPeriod::Yearly: return "year";
+        default: return "month";
+    }
+}
+
+inline bool parseBudgetPeriod(string_view text, BudgetPeriod& period) {
+    if (equalsLower(text, "weekly")) period = BudgetPeriod::Weekly;
+    else if (equalsLower(text, "monthly")) period = BudgetPeriod::Monthly;
+    else if (equalsLower(text, "yearly")) period = BudgetPeriod::Yearly;
+    else return false;
+    return true;
+}
+
+// Number of the period containing day (weeks are counted from Monday 1969-12-29)
+inline int32_t budgetPeriodKey(BudgetPeriod period, int32_t day) {
+    switch (period) {
+        case BudgetPeriod::Weekly: return (day + 3 >= 0 ? day + 3 : day - 3) / 7;
+        case BudgetPeriod::Yearly: {
+            int32_t monthKey = monthKeyFromDay(day);
+            return (monthKey >= 0 ? monthKey : monthKey - 11) / 12;
+        }
+        default: return monthKeyFromDay(day);
+    }
+}
+
+// First and last day of a period number
+inline void budgetPeriodDays(BudgetPeriod period, int32_t key, int32_t& first, int32_t& last) {
+    switch (period) {
+        case BudgetPeriod::Weekly:
+            first = key * 7 - 3;
+            last = first + 6;
+            break;
+        case BudgetPeriod::Yearly:
+            first = daysFromCivil(key, 1, 1);
+            last = daysFromCivil(key + 1, 1, 1) - 1;
+            break;
+        default: {
+            int year = key / 12;
+            unsigned month = static_cast<unsigned>(key % 12) + 1;
+            first = daysFromCivil(year, month, 1);
+            last = (month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, month + 1, 1)) - 1;
+        }
+    }
+}
+
+// Parse "60,80,100" into ascending percentages
+inline bool parseThresholds(string_view text, vector<int>& thresholds) {
+    vector<int> parsed;
+    while (!text.empty()) {
+        size_t comma = text.find_first_of(",;");
+        string_view item = trimField(text.substr(0, comma));
+        int value = 0;
+        auto result = from_chars(item.data(), item.data() + item.size(), value);
+        if (result.ec != errc() || result.ptr != item.data() + item.size() || value <= 0 ||
+            (!parsed.empty() && value <= parsed.back())) {
+            return false;
+        }
+        parsed.push_back(value);
+        text = comma == string_view::npos ? string_view() : text.substr(comma + 1);
+    }
+    if (parsed.empty()) return false;
+    thresholds = parsed;
+    return true;
+}
+
+inline string formatThresholds(const vector<int>& thresholds, char separator = ',') {
+    string text;
+    for (int value : thresholds) {
+        if (!text.empty()) text.push_back(separator);
+        text += to_string(value);
+    }
+    return text;
+}
+
+inline const vector<int>& defaultBudgetThresholds() {
+    static const vector<int> thresholds = {60, 80, 100};
+    return thresholds;
+}
+
+// Spending limit for one category, or for all expenses, over a period
+struct BudgetRule {
+    string category;         // empty for a global rule over every expense
+    BudgetPeriod period;
+    Money limit;
+    vector<int> thresholds;  // ascending alert percentages of limit
+
+    BudgetRule(const string& cat, BudgetPeriod per, Money lim, const vector<int>& levels)
+        : category(cat), period(per), limit(lim), thresholds(levels) {}
+
+    bool isGlobal() const { return category.empty(); }
+    string label() const { return isGlobal() ? "All expenses" : category; }
+
+    // Smallest spending (in Money units) that reaches thresholds[index]
+    int64_t alertUnits(size_t index) const {
+        if (index >= thresholds.size()) return INT64_MAX;
+        int64_t scaled = limit.toUnits() * thresholds[index];
+        return scaled >= 0 ? (scaled + 99) / 100 : scaled / 100;
+    }
+};
+
+// Running total of a rule for the latest period it has seen
+struct BudgetProgress {
+    Money spent;
+    int64_t nextAlert;       // spending that reaches the next threshold (INT64_MAX if none left)
+    int32_t periodKey;       // kUnknownDay before the first expense
+    uint32_t nextThreshold;  // index of that threshold
+};
+
+// A threshold crossed by a new expense
+struct BudgetAlert {
+    size_t rule;    // index into BudgetRuleEngine::all()
+    int threshold;  // percent of the limit reached
+    Money spent;    // spending in the period after the expense
+};
+
+// Budget rules keyed by (category, period) in a hash map. Every expense
+// touches at most one rule per period for its category plus the global
+// rules, so the cost of an insert does not depend on how many rules exist.
+// Running totals live apart from the rule definitions so an insert only
+// touches a few small records. Each rule tracks the latest period it has
+// seen; back-dated expenses in older periods do not raise alerts.
+class BudgetRuleEngine {
+private:
+    typedef array<int32_t, kBudgetPeriods> RuleSlots;  // rule index per period, -1 if none
+
+    vector<BudgetRule> rules;
+    vector<BudgetProgress> progressOf;  // parallel to rules
+    unordered_map<string, RuleSlots> categoryRules;
+    RuleSlots globalRules;
+    vector<int> incomeThresholds;       // alert / warning / critical share of income spent
+    string scratch;
+
+    static RuleSlots emptySlots() {
+        RuleSlots slots;
+        slots.fill(-1);
+        return slots;
+    }
+
+    // Point progress at the first threshold its spending has not reached
+    void rearm(size_t index) {
+        BudgetProgress& progress = progressOf[index];
+        progress.nextThreshold = 0;
+        progress.nextAlert = rules[index].alertUnits(0);
+        while (progress.spent.toUnits() >= progress.nextAlert) {
+            progress.nextAlert = rules[index].alertUnits(++progress.nextThreshold);
+        }
+    }
+
+    void account(size_t index, int32_t key, Money amount, vector<BudgetAlert>* alerts) {
+        BudgetProgress& progress = progressOf[index];
+        if (key != progress.periodKey) {
+            if (progress.periodKey != kUnknownDay && key < progress.periodKey) return; // an older period
+            progress.periodKey = key;
+            progress.spent = Money();
+            progress.nextThreshold = 0;
+            progress.nextAlert = rules[index].alertUnits(0);
+        }
+        progress.spent += amount;
+        while (progress.spent.toUnits() >= progress.nextAlert) {
+            const BudgetRule& rule = rules[index];
+            if (alerts) alerts->push_back(BudgetAlert{index, rule.thresholds[progress.nextThreshold], progress.spent});
+            progress.nextAlert = rule.alertUnits(++progress.nextThreshold);
+        }
+    }
+
+    void accountSlots(const RuleSlots& slots, const int32_t* keys, Money amount, vector<BudgetAlert>* alerts) {
+        for (size_t period = 0; period < kBudgetPeriods; period++) {
+            if (slots[period] >= 0) account(static_cast<size_t>(slots[period]), keys[period], amount, alerts);
+        }
+    }
+
+public:
+    BudgetRuleEngine() : globalRules(emptySlots()), incomeThresholds({70, 80, 90}) {}
+
+    bool empty() const { return rules.empty(); }
+    size_t size() const { return rules.size(); }
+    const vector<BudgetRule>& all() const { return rules; }
+    const BudgetProgress& progress(size_t index) const { return progressOf[index]; }
+
+    // Index of the rule for a category ("" for global) and period, or -1
+    int32_t indexOf(const string& category, BudgetPeriod period) const {
+        const RuleSlots* slots = &globalRules;
+        if (!category.empty()) {
+            auto it = categoryRules.find(category);
+            if (it == categoryRules.end()) return -1;
+            slots = &it->second;
+        }
+        return (*slots)[static_cast<size_t>(period)];
+    }
+
+    // Add or replace a rule; returns true (and the old limit in previous) when
+    // one existed. A new rule starts empty, so call rebuild() to count past expenses.
+    bool set(const string& category, BudgetPeriod period, Money limit, const vector<int>& thresholds,
+             Money& previous) {
+        RuleSlots& slots = category.empty() ? globalRules
+                                            : categoryRules.emplace(category, emptySlots()).first->second;
+        int32_t& index = slots[static_cast<size_t>(period)];
+        if (index >= 0) {
+            BudgetRule& rule = rules[static_cast<size_t>(index)];
+            previous = rule.limit;
+            rule.limit = limit;
+            rule.thresholds = thresholds;
+            rearm(static_cast<size_t>(index));
+            return true;
+        }
+        index = static_cast<int32_t>(rules.size());
+        rules.emplace_back(category, period, limit, thresholds);
+        progressOf.push_back(BudgetProgress{Money(), 0, kUnknownDay, 0});
+        rearm(rules.size() - 1);
+        return false;
+    }
+
+    // Account one expense; thresholds it crosses are appended to alerts (if given)
+    void observe(string_view category, int32_t day, Money amount, vector<BudgetAlert>* alerts) {
+        if (rules.empty() || day == kUnknownDay) return;
+        int32_t keys[kBudgetPeriods];
+        keys[static_cast<size_t>(BudgetPeriod::Weekly)] = budgetPeriodKey(BudgetPeriod::Weekly, day);
+        int32_t monthKey = monthKeyFromDay(day);
+        keys[static_cast<size_t>(BudgetPeriod::Monthly)] = monthKey;
+        keys[static_cast<size_t>(BudgetPeriod::Yearly)] = (monthKey >= 0 ? monthKey : monthKey - 11) / 12;
+
+        accountSlots(globalRules, keys, amount, alerts);
+        if (categoryRules.empty()) return;
+        scratch.assign(category.data(), category.size());
+        auto it = categoryRules.find(scratch);
+        if (it != categoryRules.end()) accountSlots(it->second, keys, amount, alerts);
+    }
+
+    // Recompute every running total from the expenses of a ledger. Only rows
+    // from the start of the latest week or year onwards can be in a rule's
+    // latest period, so older rows are not read.
+    void rebuild(const Ledger& ledger) {
+        for (size_t index = 0; index < rules.size(); index++) {
+            progressOf[index].periodKey = kUnknownDay;
+            progressOf[index].spent = Money();
+            rearm(index);
+        }
+        int32_t lastDay = ledger.latestDay();
+        if (rules.empty() || lastDay == kUnknownDay) return;
+
+        int32_t yearStart, weekStart, unused;
+        budgetPeriodDays(BudgetPeriod::Yearly, budgetPeriodKey(BudgetPeriod::Yearly, lastDay), yearStart, unused);
+        budgetPeriodDays(BudgetPeriod::Weekly, budgetPeriodKey(BudgetPeriod::Weekly, lastDay), weekStart, unused);
+        TransactionQuery recent;
+        recent.firstDay = min(yearStart, weekStart);
+        recent.anyType = false;
+        recent.type = TransactionType::Expense;
+        for (uint32_t row : ledger.select(recent)) {
+            observe(ledger.category(row), ledger.day(row), ledger.amount(row), nullptr);
+        }
+    }
+
+    // Expense-to-income percentages for the alert, warning and critical levels
+    const vector<int>& incomeAlertThresholds() const { return incomeThresholds; }
+    void setIncomeAlertThresholds(const vector<int>& thresholds) { incomeThresholds = thresholds; }
+};
+
+// Spending against one budget rule for one period
+struct BudgetStatus {
+    string category;  // empty for a global rule
+    BudgetPeriod period;
+    Money limit;
+    Money spent;
+    Money remaining;
+    BudgetLevel level;
+
+    BudgetStatus(const BudgetRule& rule, Money sp)
+        : category(rule.category), period(rule.period), limit(rule.limit), spent(sp), remaining(rule.limit - sp),
+          level(budgetLevel(sp, rule.limit, rule.thresholds)) {}
+};
+
+// Expense totals per day in a Fenwick tree, so adding an expense and
+// summing any range of days both cost O(log days). The covered range grows
+// by doubling in either direction as earlier or later days arrive, up to
+// kMaxDenseDays; days beyond that (a mistyped year, say) are kept in a
+// sparse map, so one stray date cannot allocate centuries of empty days.
+class DailySeries {
+public:
+    static constexpr int32_t kMaxDenseDays = 1 << 13;  // about 22 years
+
+private:
+    int32_t origin;          // day of slot 0
+    vector<int64_t> daily;   // units spent per day
+    vector<int64_t> tree;    // Fenwick tree over daily
+    map<int32_t, int64_t> outliers;  // units spent per day outside the dense range
+
+    void buildTree() {
+        tree = daily;
+        for (size_t i = 0; i < tree.size(); i++) {
+            size_t parent = i | (i + 1);
+            if (parent < tree.size()) tree[parent] += tree[i];
+        }
+    }
+
+    // Units spent on slots [0, slot]
+    int64_t prefix(size_t slot) const {
+        int64_t sum = 0;
+        for (size_t i = slot + 1; i > 0; i &= i - 1) sum += tree[i - 1];
+        return sum;
+    }
+
+    // Make day a dense slot; false if the dense range would grow past kMaxDenseDays
+    bool cover(int32_t day) {
+        if (daily.empty()) {
+            origin = day;
+            daily.assign(64, 0);
+            tree.assign(64, 0);
+            return true;
+        }
+        if (day >= origin && day < origin + static_cast<int32_t>(daily.size())) return true;
+        size_t size = daily.size();
+        int32_t first = min(origin, day);
+        int32_t last = max(origin + static_cast<int32_t>(size) - 1, day);
+        if (static_cast<int64_t>(last) - first >= kMaxDenseDays) return false;
+        while (static_cast<int64_t>(last) - first >= static_cast<int64_t>(size)) size *= 2;
+        // Leave room on the side that grew, so appending in either direction stays amortized
+        int32_t newOrigin = day < origin ? last - static_cast<int32_t>(size) + 1 : first;
+        vector<int64_t> moved(size, 0);
+        copy(daily.begin(), daily.end(), moved.begin() + (origin - newOrigin));
+        daily.swap(moved);
+        origin = newOrigin;
+        buildTree();
+        return true;
+    }
+
+public:
+    DailySeries() : origin(0) {}
+
+    bool empty() const { return daily.empty() && outliers.empty(); }
+
+    void add(int32_t day, int64_t units) {
+        if (!cover(day)) {
+            outliers[day] += units;
+            return;
+        }
+        size_t slot = static_cast<size_t>(day - origin);
+        daily[slot] += units;
+        for (size_t i = slot; i < tree.size(); i |= i + 1) tree[i] += units;
+    }
+
+    // Replace the contents with per-day totals starting at first (at most kMaxDenseDays of them)
+    void assign(int32_t first, vector<int64_t> days) {
+        size_t size = 64;
+        while (size < days.size()) size *= 2;
+        days.resize(size, 0);
+        origin = first;
+        daily.swap(days);
+        outliers.clear();
+        buildTree();
+    }
+
+    // Units spent on days [first, last]
+    int64_t sum(int32_t first, int32_t last) const {
+        int64_t total = 0;
+        for (auto it = outliers.lower_bound(first); it != outliers.end() && it->first <= last; ++it) {
+            total += it->second;
+        }
+        if (daily.empty()) return total;
+        int64_t begin = max<int64_t>(first, origin) - origin;
+        int64_t end = min<int64_t>(last, static_cast<int64_t>(origin) + static_cast<int64_t>(daily.size()) - 1) - origin;
+        if (begin > end) return total;
+        return total + prefix(static_cast<size_t>(end)) - (begin > 0 ? prefix(static_cast<size_t>(begin - 1)) : 0);
+    }
+
+    size_t bytesUsed() const {
+        const size_t nodeBytes = sizeof(pair<const int32_t, int64_t>) + 4 * sizeof(void*);
+        return (daily.capacity() + tree.capacity()) * sizeof(int64_t) + outliers.size() * nodeBytes;
+    }
+};
+
+// Bucket length of a spending series
+enum class SeriesBucket : uint8_t {
+    Daily,
+    Weekly,   // Monday to Sunday, like weekly budgets
+    Monthly
+};
+
+inline const char* seriesBucketName(SeriesBucket bucket) {
+    switch (bucket) {
+        case SeriesBucket::Daily: return "day";
+        case SeriesBucket::Weekly: return "week";
+        default: return "month";
+    }
+}
+
+inline bool parseSeriesBucket(string_view text, SeriesBucket& bucket) {
+    if (equalsLower(text, "day")) bucket = SeriesBucket::Daily;
+    else if (equalsLower(text, "week")) bucket = SeriesBucket::Weekly;
+    else if (equalsLower(text, "month")) bucket = SeriesBucket::Monthly;
+    else return false;
+    return true;
+}
+
+// First and last day of the bucket containing day
+inline void seriesBucketDays(SeriesBucket bucket, int32_t day, int32_t& first, int32_t& last) {
+    if (bucket == SeriesBucket::Daily) {
+        first = last = day;
+        return;
+    }
+    BudgetPeriod period = bucket == SeriesBucket::Weekly ? BudgetPeriod::Weekly : BudgetPeriod::Monthly;
+    budgetPeriodDays(period, budgetPeriodKey(period, day), first, last);
+}
+
+// One bucket of a spending series with the moving average of the buckets up to it
+struct SeriesPoint {
+    int32_t firstDay;
+    int32_t lastDay;
+    Money spent;
+    Money movingAverage;  // mean spending of this bucket and the window - 1 before it
+};
+
+// Pace of one category's (or all) spending as of a day
+struct SpendingForecast {
+    uint32_t categoryId;         // kAnyCategory for all expenses
+    Money monthToDate;           // spent from the first of the month to the day
+    Money dailyAverage7;         // mean spending per day over the last 7 days
+    Money dailyAverage30;        // ... and the last 30 days: the burn rate
+    Money previous30;            // spent in the 30 days before those
+    Money projectedMonthEnd;     // month to date plus the burn rate for the rest of the month
+    int32_t daysLeft;            // days of the month after the day
+
+    // Change of the last 30 days against the 30 before, in percent (false when there is nothing to compare to)
+    bool velocityChange(double& percent) const {
+        if (previous30 <= Money()) return false;
+        percent = (dailyAverage30.toDouble() * 30 - previous30.toDouble()) / previous30.toDouble() * 100;
+        return true;
+    }
+};
+
+// Daily expense series per category and in total, built from the ledger in
+// one pass and then kept current by observe() as expenses are appended, so
+// moving averages, burn rates and month-end projections only read
+// O(log days) range sums however long the history is.
+class SpendingTrends {
+private:
+    vector<DailySeries> byCategory;  // indexed by ledger category id
+    DailySeries total;
+    bool built;
+
+    const DailySeries* seriesFor(uint32_t categoryId) const {
+        if (categoryId == kAnyCategory) return &total;
+        return categoryId < byCategory.size() ? &byCategory[categoryId] : nullptr;
+    }
+
+    static Money divide(int64_t units, int64_t days) {
+        return Money::fromUnits(units >= 0 ? (units + days / 2) / days : (units - days / 2) / days);
+    }
+
+public:
+    SpendingTrends() : built(false) {}
+
+    // False until rebuild(); until then observe() does nothing
+    bool isBuilt() const { return built; }
+
+    // Bucket every dated expense of the ledger by day. Each category's
+    // series spans only its own first to last day. If the ledger spans more
+    // than DailySeries::kMaxDenseDays, the dense days are centred on the
+    // median expense day and the rows outside go to the sparse outliers.
+    void rebuild(const Ledger& ledger) {
+        const auto& types = ledger.typeColumn();
+        const auto& categories = ledger.categoryColumn();
+        const auto& days = ledger.dayColumn();
+        const auto& amounts = ledger.amountColumn();
+        byCategory.assign(ledger.categoryDictionary().size(), DailySeries());
+        total = DailySeries();
+        built = true;
+
+        vector<pair<int32_t, int32_t>> ranges(byCategory.size(), make_pair(INT32_MAX, INT32_MIN));
+        int32_t first = INT32_MAX, last = INT32_MIN;
+        for (size_t row = 0; row < ledger.size(); row++) {
+            if (types[row] != TransactionType::Expense || days[row] == kUnknownDay) continue;
+            pair<int32_t, int32_t>& range = ranges[categories[row]];
+            range.first = min(range.first, days[row]);
+            range.second = max(range.second, days[row]);
+            first = min(first, range.first);
+            last = max(last, range.second);
+        }
+        if (first > last) return;
+
+        if (static_cast<int64_t>(last) - first >= DailySeries::kMaxDenseDays) {
+            vector<int32_t> dated;
+            for (size_t row = 0; row < ledger.size(); row++) {
+                if (types[row] == TransactionType::Expense && days[row] != kUnknownDay) dated.push_back(days[row]);
+            }
+            nth_element(dated.begin(), dated.begin() + static_cast<ptrdiff_t>(dated.size() / 2), dated.end());
+            int32_t median = dated[dated.size() / 2];
+            int32_t centred = max(first, median - DailySeries::kMaxDenseDays / 2);
+            last = min(last, centred + DailySeries::kMaxDenseDays - 1);
+            first = max(first, last - DailySeries::kMaxDenseDays + 1);
+        }
+        for (auto& range : ranges) {
+            range.first = max(range.first, first);
+            range.second = min(range.second, last);
+        }
+
+        vector<vector<int64_t>> perCategory(byCategory.size());
+        vector<int64_t> all(static_cast<size_t>(last - first + 1), 0);
+        vector<size_t> outlying;
+        for (size_t row = 0; row < ledger.size(); row++) {
+            if (types[row] != TransactionType::Expense || days[row] == kUnknownDay) continue;
+            if (days[row] < first || days[row] > last) {
+                outlying.push_back(row);
+                continue;
+            }
+            const pair<int32_t, int32_t>& range = ranges[categories[row]];
+            vector<int64_t>& series = perCategory[categories[row]];
+            if (series.empty()) series.assign(static_cast<size_t>(range.second - range.first + 1), 0);
+            series[static_cast<size_t>(days[row] - range.first)] += amounts[row];
+            all[static_cast<size_t>(days[row] - first)] += amounts[row];
+        }
+        for (size_t id = 0; id < perCategory.size(); id++) {
+            if (!perCategory[id].empty()) byCategory[id].assign(ranges[id].first, move(perCategory[id]));
+        }
+        total.assign(first, move(all));
+        for (size_t row : outlying) {
+            byCategory[categories[row]].add(days[row], amounts[row]);
+            total.add(days[row], amounts[row]);
+        }
+    }
+
+    // Account one appended expense; DailySeries keeps far-off days sparse
+    void observe(uint32_t categoryId, int32_t day, Money amount) {
+        if (!built || day == kUnknownDay) return;
+        if (categoryId >= byCategory.size()) byCategory.resize(categoryId + 1);
+        byCategory[categoryId].add(day, amount.toUnits());
+        total.add(day, amount.toUnits());
+    }
+
+    // Spent on days [first, last] in a category (kAnyCategory for all expenses)
+    Money spent(uint32_t categoryId, int32_t first, int32_t last) const {
+        const DailySeries* series = seriesFor(categoryId);
+        return Money::fromUnits(series ? series->sum(first, last) : 0);
+    }
+
+    // Burn rate and month-end projection as of day
+    SpendingForecast forecast(uint32_t categoryId, int32_t day) const {
+        SpendingForecast result;
+        result.categoryId = categoryId;
+        int32_t monthFirst, monthLast;
+        seriesBucketDays(SeriesBucket::Monthly, day, monthFirst, monthLast);
+        result.monthToDate = spent(categoryId, monthFirst, day);
+        int64_t last30 = spent(categoryId, day - 29, day).toUnits();
+        result.dailyAverage7 = divide(spent(categoryId, day - 6, day).toUnits(), 7);
+        result.dailyAverage30 = divide(last30, 30);
+        result.previous30 = spent(categoryId, day - 59, day - 30);
+        result.daysLeft = monthLast - day;
+        result.projectedMonthEnd = result.monthToDate + divide(last30 * result.daysLeft, 30);
+        return result;
+    }
+
+    // The periods buckets ending with the one containing lastDay, oldest
+    // first, each with the moving average over window buckets
+    vector<SeriesPoint> series(uint32_t categoryId, SeriesBucket bucket, int32_t lastDay, size_t periods,
+                               size_t window) const {
+        window = max<size_t>(window, 1);
+        size_t buckets = periods + window - 1;  // earlier buckets feed the first averages
+        vector<SeriesPoint> points(buckets);
+        int32_t day = lastDay;
+        for (size_t i = buckets; i-- > 0;) {
+            seriesBucketDays(bucket, day, points[i].firstDay, points[i].lastDay);
+            points[i].spent = spent(categoryId, points[i].firstDay, points[i].lastDay);
+            day = points[i].firstDay - 1;
+        }
+        int64_t windowSum = 0;
+        for (size_t i = 0; i < buckets; i++) {
+            windowSum += points[i].spent.toUnits();
+            if (i >= window) windowSum -= points[i - window].spent.toUnits();
+            points[i].movingAverage = divide(windowSum, static_cast<int64_t>(min(window, i + 1)));
+        }
+        points.erase(points.begin(), points.begin() + static_cast<ptrdiff_t>(window - 1));
+        return points;
+    }
+
+    size_t bytesUsed() const {
+        size_t bytes = total.bytesUsed();
+        for (const auto& series : byCategory) bytes += sizeof(DailySeries) + series.bytesUsed();
+        return bytes;
+    }
+};
+
+// How a categorization rule compares a description with its pattern
+enum class MatchKind : uint8_t {
+    Exact,      // the whole description
+    Prefix,     // the start of the description
+    Substring,  // anywhere in the description
+    Regex       // ECMAScript regular expression, searched anywhere
+};
+
+inline const char* matchKindName(MatchKind kind) {
+    switch (kind) {
+        case MatchKind::Exact: return "exact";
+        case MatchKind::Prefix: return "prefix";
+        case MatchKind::Substring: return "substring";
+        default: return "regex";
+    }
+}
+
+inline bool parseMatchKind(string_view text, MatchKind& kind) {
+    if (equalsLower(text, "exact")) kind = MatchKind::Exact;
+    else if (equalsLower(text, "prefix")) kind = MatchKind::Prefix;
+    else if (equalsLower(text, "substring") || equalsLower(text, "contains")) kind = MatchKind::Substring;
+    else if (equalsLower(text, "regex")) kind = MatchKind::Regex;
+    else return false;
+    return true;
+}
+
+// Description -> category rule; all matching ignores ASCII case
+struct CategoryRule {
+    MatchKind kind;
+    string pattern;
+    string category;
+
+    CategoryRule(MatchKind k, const string& pat, const string& cat) : kind(k), pattern(pat), category(cat) {}
+};
+
+// Longest run of literal characters every match of an ECMAScript regex
+// must contain (lowercased), or "" when there is no safe one. Used to skip
+// regexes whose literal does not occur in a description.
+inline string requiredRegexLiteral(string_view pattern) {
+    if (pattern.find('|') != string_view::npos) return "";
+    string best, run;
+    auto endRun = [&] {
+        if (run.size() > best.size()) best = run;
+        run.clear();
+    };
+    int depth = 0;  // inside () or [] nothing is taken
+    for (size_t i = 0; i < pattern.size(); i++) {
+        char c = pattern[i];
+        if (c == '\\') {
+            endRun();
+            i++;
+            continue;
+        }
+        if (c == '(' || c == '[') depth++;
+        if (c == ')' || c == ']') depth = max(0, depth - 1);
+        if (c == '?' || c == '*' || c == '{') {
+            if (!run.empty()) run.pop_back();  // the quantified character is optional
+            endRun();
+            if (c == '{') i = min(pattern.find('}', i), pattern.size());
+            continue;
+        }
+        if (depth > 0 || strchr("()[]^$.+", c)) {
+            endRun();  // "ab+" still needs "ab", but not what follows
+            continue;
+        }
+        run.push_back(static_cast<char>(tolower(static_cast<unsigned char>(c))));
+    }
+    endRun();
+    return best.size() >= 3 ? best : "";
+}
+
+// Rules that fill in the category of imported transactions. The first rule
+// (in the order added) that matches a description wins. compile() builds:
+// a hash map for exact rules; one Aho-Corasick automaton over the prefix
+// and substring patterns, as a dense DFA over the byte classes the
+// patterns use, so a description is scanned once whatever the rule count;
+// and the regexes, each gated by a literal it requires, which goes into
+// the same automaton so a regex only runs when its literal occurs.
+class CategoryRuleEngine {
+public:
+    // Per-thread buffers for matching
+    struct MatchScratch {
+        string text;          // lowercased description
+        vector<uint8_t> hit;  // per regex: its literal occurs
+    };
+
+private:
+    static constexpr uint32_t kNoRule = UINT32_MAX;
+
+    vector<CategoryRule> rules;
+    bool compiled;
+
+    unordered_map<string, uint32_t> exactRules;   // lowercase description -> first rule
+    array<uint16_t, 256> byteClass;               // 0 for bytes no pattern uses
+    size_t classes;
+    vector<uint32_t> next;                        // state * classes + class -> state
+    vector<uint32_t> depth;                       // pattern length that leads to a state
+    vector<uint32_t> substringRule;               // first substring rule ending here or at a suffix
+    vector<uint32_t> prefixRule;                  // first prefix rule spelled by the state
+    vector<int32_t> gateHead;                     // first gated regex whose literal ends here, or -1
+    vector<uint32_t> gateLink;                    // nearest proper suffix state with gates (0 = none)
+    vector<int32_t> gateNext;                     // next gated regex with the same literal, or -1
+    vector<pair<uint32_t, regex>> regexes;        // rule index and compiled expression
+    vector<uint8_t> gated;                        // per regex: runs only when its literal occurs
+
+    static void lowerInto(string_view text, string& out) {
+        out.resize(text.size());
+        for (size_t i = 0; i < text.size(); i++) out[i] = static_cast<char>(tolower(static_cast<unsigned char>(text[i])));
+    }
+
+    void compile() {
+        exactRules.clear();
+        regexes.clear();
+        gated.clear();
+        byteClass.fill(0);
+        classes = 1;
+
+        // Patterns that go into the automaton: (lowercase text, rule or regex slot, kind)
+        struct Literal {
+            string text;
+            uint32_t id;
+            MatchKind kind;
+        };
+        vector<Literal> literals;
+        string lowered;
+        for (uint32_t index = 0; index < rules.size(); index++) {
+            const CategoryRule& rule = rules[index];
+            lowerInto(rule.pattern, lowered);
+            if (rule.kind == MatchKind::Exact) {
+                exactRules.emplace(lowered, index);
+            } else if (rule.kind == MatchKind::Regex) {
+                string literal = requiredRegexLiteral(rule.pattern);
+                gated.push_back(!literal.empty());
+                if (!literal.empty()) literals.push_back(Literal{literal, static_cast<uint32_t>(regexes.size()), rule.kind});
+                regexes.emplace_back(index, regex(rule.pattern, regex::ECMAScript | regex::icase | regex::optimize));
+            } else if (!lowered.empty()) {
+                literals.push_back(Literal{lowered, index, rule.kind});
+            }
+        }
+        for (const Literal& literal : literals) {
+            for (unsigned char c : literal.text) {
+                if (byteClass[c] == 0) byteClass[c] = static_cast<uint16_t>(classes++);
+            }
+        }
+
+        // Trie of the literals
+        next.assign(classes, kNoRule);
+        depth.assign(1, 0);
+        substringRule.assign(1, kNoRule);
+        prefixRule.assign(1, kNoRule);
+        gateHead.assign(1, -1);
+        gateNext.assign(regexes.size(), -1);
+        for (const Literal& literal : literals) {
+            uint32_t state = 0;
+            for (unsigned char c : literal.text) {
+                uint32_t& child = next[state * classes + byteClass[c]];
+                if (child == kNoRule) {
+                    child = static_cast<uint32_t>(depth.size());
+                    uint32_t parentDepth = depth[state];
+                    next.resize(next.size() + classes, kNoRule);
+                    depth.push_back(parentDepth + 1);
+                    substringRule.push_back(kNoRule);
+                    prefixRule.push_back(kNoRule);
+                    gateHead.push_back(-1);
+                }
+                state = next[state * classes + byteClass[c]];
+            }
+            if (literal.kind == MatchKind::Substring) {
+                substringRule[state] = min(substringRule[state], literal.id);
+            } else if (literal.kind == MatchKind::Prefix) {
+                prefixRule[state] = min(prefixRule[state], literal.id);
+            } else {
+                gateNext[literal.id] = gateHead[state];
+                gateHead[state] = static_cast<int32_t>(literal.id);
+            }
+        }
+
+        // Failure links, breadth first, turning the trie into a full DFA
+        size_t states = depth.size();
+        vector<uint32_t> failure(states, 0);
+        gateLink.assign(states, 0);
+        vector<uint32_t> queue;
+        queue.reserve(states);
+        for (size_t c = 0; c < classes; c++) {
+            uint32_t& child = next[c];
+            if (child == kNoRule) {
+                child = 0;
+            } else {
+                queue.push_back(child);
+            }
+        }
+        for (size_t head = 0; head < queue.size(); head++) {
+            uint32_t state = queue[head];
+            uint32_t fail = failure[state];
+            substringRule[state] = min(substringRule[state], substringRule[fail]);
+            gateLink[state] = gateHead[fail] >= 0 ? fail : gateLink[fail];
+            for (size_t c = 0; c < classes; c++) {
+                uint32_t& child = next[state * classes + c];
+                if (child == kNoRule) {
+                    child = next[fail * classes + c];
+                } else {
+                    failure[child] = next[fail * classes + c];
+                    queue.push_back(child);
+                }
+            }
+        }
+        compiled = true;
+    }
+
+    // Index of the first rule matching description, or kNoRule; needs compile()
+    uint32_t find(string_view description, MatchScratch& scratch) const {
+        string& text = scratch.text;
+        lowerInto(description, text);
+        uint32_t best = kNoRule;
+        if (!exactRules.empty()) {
+            auto it = exactRules.find(text);
+            if (it != exactRules.end()) best = it->second;
+        }
+
+        // One pass of the automaton; gated regexes whose literal occurs are marked
+        scratch.hit.assign(regexes.size(), 0);
+        uint32_t state = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            state = next[state * classes + byteClass[static_cast<unsigned char>(text[i])]];
+            best = min(best, substringRule[state]);
+            if (depth[state] == i + 1) best = min(best, prefixRule[state]);
+            for (uint32_t gate = gateHead[state] >= 0 ? state : gateLink[state]; gate != 0; gate = gateLink[gate]) {
+                for (int32_t id = gateHead[gate]; id >= 0; id = gateNext[static_cast<size_t>(id)]) {
+                    scratch.hit[static_cast<size_t>(id)] = 1;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < regexes.size() && regexes[i].first < best; i++) {
+            if ((!gated[i] || scratch.hit[i]) && regex_search(text, regexes[i].second)) best = regexes[i].first;
+        }
+        return best;
+    }
+
+public:
+    CategoryRuleEngine() : compiled(false), classes(1) {}
+
+    bool empty() const { return rules.empty(); }
+    size_t size() const { return rules.size(); }
+    const vector<CategoryRule>& all() const { return rules; }
+
+    // Add a rule after the existing ones; false with a message if a regex does not compile
+    bool add(MatchKind kind, const string& pattern, const string& category, string& error) {
+        if (pattern.empty() || category.empty()) {
+            error = "a rule needs a pattern and a category";
+            return false;
+        }
+        if (kind == MatchKind::Regex) {
+            try {
+                regex check(pattern, regex::ECMAScript);
+            } catch (const regex_error& e) {
+                error = "invalid regex '" + pattern + "': " + e.what();
+                return false;
+            }
+        }
+        rules.emplace_back(kind, pattern, category);
+        compiled = false;
+        return true;
+    }
+
+    // The first rule matching description, or null
+    const CategoryRule* match(string_view description, MatchScratch& scratch) {
+        if (rules.empty()) return nullptr;
+        if (!compiled) compile();
+        uint32_t rule = find(description, scratch);
+        return rule == kNoRule ? nullptr : &rules[rule];
+    }
+
+    // Give rows a category from the first matching rule: rows with a blank
+    // category, or every row that matches when overwrite is set. Rows are
+    // split over threads for large imports. Returns the rows changed.
+    size_t categorize(vector<RawRow>& rows, bool overwrite) {
+        if (rules.empty() || rows.empty()) return 0;
+        if (!compiled) compile();
+        unsigned threads = static_cast<unsigned>(min<size_t>(max(1u, thread::hardware_concurrency()),
+                                                             rows.size() / 16384 + 1));
+        vector<size_t> changed(threads, 0);
+        auto categorizeRange = [&](unsigned part) {
+            MatchScratch scratch;
+            for (size_t i = rows.size() * part / threads; i < rows.size() * (part + 1) / threads; i++) {
+                RawRow& row = rows[i];
+                if (!overwrite && !trimField(row.category).empty()) continue;
+                uint32_t rule = find(row.description, scratch);
+                if (rule == kNoRule) continue;
+                row.category = rules[rule].category;
+                changed[part]++;
+            }
+        };
+        vector<thread> workers;
+        for (unsigned part = 1; part < threads; part++) workers.emplace_back(categorizeRange, part);
+        categorizeRange(0);
+        for (auto& worker : workers) worker.join();
+        return accumulate(changed.begin(), changed.end(), size_t(0));
+    }
+
+    size_t stateCount() {
+        if (!compiled) compile();
+        return depth.size();
+    }
+
+    size_t bytesUsed() const {
+        return next.capacity() * sizeof(uint32_t) + depth.capacity() * sizeof(uint32_t) * 3 +
+               (gateHead.capacity() + gateLink.capacity()) * sizeof(int32_t) +
+               exactRules.size() * (sizeof(string) + 32);
+    }
+};
+
+// A file being parsed on the I/O thread. The UI thread reads the progress
+// counters at any time, and everything else only once parsed is set.
+struct BackgroundImport {
+    string filename;
+    atomic<uint64_t> bytesParsed{0};
+    atomic<uint64_t> totalBytes{0};
+    atomic<bool> parsed{false};
+    bool opened = false;
+    unique_ptr<MappedFile> file;            // the parsed rows point into it
+    unique_ptr<CategoryRuleEngine> rules;   // copy the I/O thread categorizes with; categories point into it
+    IngestResult result;
+    size_t categorized = 0;
+    chrono::steady_clock::time_point started;
+};
+
+// Enhanced ExpenseTracker class with budget management
+class ExpenseTracker {
+private:
+    Ledger transactions;
+    QueryEngine queries;   // group-by reports over transactions
+    BudgetRuleEngine budgetRules;
+    vector<BudgetAlert> budgetAlerts;  // raised by new expenses and not reported yet
+    SpendingTrends trends;             // built on first use, then kept current
+    Money totalIncome;
+    Money totalExpenses;
+    string dataFile;
+    string budgetFile;
+    string journalFile;
+    string snapshotFile;
+    string rulesFile;
+    CategoryRuleEngine categoryRules;  // fill in categories of imported rows
+    TransactionJournal journal;
+    bool verifyAggregates; // cross-check materialized totals (EXPENSE_TRACKER_VERIFY)
+    ostream& log;          // load/save status messages (stderr in batch mode)
+    // With background I/O (the interactive menu), journal writes, saves and
+    // exports are queued on io, which then owns the journal and works from
+    // copies, and imports are parsed there and merged by the menu thread
+    mutex noticeLock;
+    vector<string> notices;                       // finished background work not shown yet
+    vector<shared_ptr<BackgroundImport>> imports; // still parsing, or parsed and not merged
+    size_t unsavedRows;                           // journaled since the last save was queued
+    string journalFailure;                        // last foreground journal write error, not reported yet
+    chrono::seconds autosaveInterval;
+    chrono::steady_clock::time_point lastAutosave;
+    unique_ptr<IoWorker> io;
+
+    static string inDirectory(const string& directory, const char* file) {
+        return directory.empty() ? file : directory + "/" + file;
+    }
+
+public:
+    // Keeps its files in directory (created if missing), or the working
+    // directory when it is empty
+    explicit ExpenseTracker(ostream& logStream = cout, const string& directory = "")
+        : queries(transactions), totalIncome(), totalExpenses(),
+          dataFile(inDirectory(directory, "financial_data.csv")), budgetFile(inDirectory(directory, "budget_limits.csv")),
+          journalFile(inDirectory(directory, "financial_data.journal")),
+          snapshotFile(inDirectory(directory, "financial_data.snap")),
+          rulesFile(inDirectory(directory, "category_rules.csv")),
+          verifyAggregates(getenv("EXPENSE_TRACKER_VERIFY") != nullptr), log(logStream), unsavedRows(0),
+          autosaveInterval(0) {
+        if (!directory.empty()) {
+            error_code error;
+            filesystem::create_directories(directory, error);
+        }
+        loadData();
+        buildDescriptionIndex();
+        replayJournal();
+        loadBudgetLimits();
+        loadCategoryRules();
+        budgetRules.rebuild(transactions);
+    }
+
+    ~ExpenseTracker() {
+        finishBackgroundIo();
+        if (!journal.commit()) log << "❌ " << journal.error() << endl;
+        // Fold the journal into the main file when the ledger is small enough to rewrite
+        // cheaply or the journal has grown to a sizeable fraction of it
+        size_t journaled = journal.recordCount();
+        if (journaled > 0 && (transactions.size() <= 100000 || journaled >= 10000 ||
+                              journaled * 8 >= transactions.size())) {
+            compactJournal();
+        }
+        saveBudgetLimits();
+    }
+
+    // Move disk writes to a background thread from now on, saving the whole
+    // ledger every interval while there are transactions not yet saved
+    void startBackgroundIo(chrono::seconds interval) {
+        if (io) return;
+        autosaveInterval = interval;
+        lastAutosave = chrono::steady_clock::now();
+        unsavedRows = journal.recordCount();
+        io = make_unique<IoWorker>();
+    }
+
+    // Wait for queued disk work and merge the imports it parsed; writes
+    // happen in the foreground again afterwards
+    void finishBackgroundIo() {
+        if (!io) return;
+        if (io->pending() > 0) log << "⏳ Finishing " << io->pending() << " background task(s)..." << endl;
+        io.reset();
+        finishBackgroundImports();
+    }
+
+    size_t backgroundTasks() const { return io ? io->pending() : 0; }
+
+    // Block until all queued disk work has run
+    void waitForBackgroundIo() {
+        if (io) io->drain();
+    }
+
+    // Get current date as string
+    string getCurrentDate() {
+        time_t now = time(0);
+        char* dt = ctime(&now);
+        string dateStr(dt);
+        dateStr.pop_back(); // Remove newline
+        return dateStr;
+    }
+
+    // Get current month-year string
+    string getCurrentMonthYear() {
+        time_t now = time(0);
+        struct tm* timeinfo = localtime(&now);
+        char buffer[20];
+        strftime(buffer, sizeof(buffer), "%Y-%m", timeinfo);
+        return string(buffer);
+    }
+
+    // Validate amount input
+    bool isValidAmount(Money amount) {
+        return amount > Money() && amount <= Money::fromUnits(kMaxMoneyUnits);
+    }
+
+    Money getTotalIncome() const { return totalIncome; }
+    Money getTotalExpenses() const { return totalExpenses; }
+    const Ledger& ledger() const { return transactions; }
+
+    // Run a group-by report over the ledger
+    vector<QueryRow> runQuery(const GroupQuery& query) { return queries.groupBy(query); }
+
+    // Read an amount typed by the user; invalid text yields zero
+    Money readAmount() {
+        string text;
+        cin >> text;
+        Money amount;
+        return parseAmount(text, amount) ? amount : Money();
+    }
+
+    // Calculate expense percentage of income
+    double getExpensePercentage() {
+        return totalExpenses.percentOf(totalIncome);
+    }
+
+    // Exact test for "expenses are at least percent% of income"
+    bool expensesReachPercent(int percent) {
+        return totalIncome > Money() && totalExpenses.reachesPercent(totalIncome, percent);
+    }
+
+    // Get monthly expenses by category from the materialized month totals
+    map<string, Money> getMonthlyExpensesByCategory(const string& monthYear) {
+        map<string, Money> monthlyExpenses;
+        const StringDictionary& categories = transactions.categoryDictionary();
+        int32_t monthKey = parseMonthKey(monthYear);
+
+        if (monthKey != kUnknownDay) {
+            GroupQuery query;
+            query.monthKey = monthKey;
+            query.anyType = false;
+            query.type = TransactionType::Expense;
+            for (const QueryRow& row : queries.groupBy(query)) {
+                monthlyExpenses[categories.name(row.categoryId)] = row.cell.sum;
+            }
+        }
+        // Free-form dates that could not be normalized still match by text
+        for (uint32_t row : transactions.rowsWithoutDate()) {
+            if (transactions.type(row) == TransactionType::Expense &&
+                transactions.dateText(row).find(monthYear) != string::npos) {
+                monthlyExpenses[transactions.category(row)] += transactions.amount(row);
+            }
+        }
+        return monthlyExpenses;
+    }
+
+    // Expenses for one category in one month
+    Money getMonthlyCategoryExpense(const string& monthYear, const string& category) {
+        auto monthlyExpenses = getMonthlyExpensesByCategory(monthYear);
+        auto it = monthlyExpenses.find(category);
+        return it == monthlyExpenses.end() ? Money() : it->second;
+    }
+
+    // Expenses per category between two days (inclusive)
+    map<string, Money> getExpensesByCategory(int32_t firstDay, int32_t lastDay) {
+        map<string, Money> expenses;
+        GroupQuery query;
+        query.firstDay = firstDay;
+        query.lastDay = lastDay;
+        query.anyType = false;
+        query.type = TransactionType::Expense;
+        const StringDictionary& categories = transactions.categoryDictionary();
+        for (const QueryRow& row : queries.groupBy(query)) expenses[categories.name(row.categoryId)] = row.cell.sum;
+        return expenses;
+    }
+
+    // Spending against every budget rule in the periods around a month:
+    // today's week and year for the current month, else the month's last ones
+    vector<BudgetStatus> getBudgetStatus(const string& monthYear) {
+        vector<BudgetStatus> statuses;
+        int32_t monthKey = parseMonthKey(monthYear);
+        int32_t reference = parseDate(getCurrentDate());
+        if (monthKey != kUnknownDay && monthYear != getCurrentMonthYear()) {
+            int32_t first;
+            budgetPeriodDays(BudgetPeriod::Monthly, monthKey, first, reference);
+        }
+
+        // One group-by per period length, shared by all rules of that length
+        array<map<string, Money>, kBudgetPeriods> expenses;
+        array<Money, kBudgetPeriods> totals;
+        array<bool, kBudgetPeriods> loaded = {false, false, false};
+        for (const BudgetRule& rule : budgetRules.all()) {
+            size_t period = static_cast<size_t>(rule.period);
+            if (!loaded[period]) {
+                loaded[period] = true;
+                if (rule.period == BudgetPeriod::Monthly) {
+                    expenses[period] = getMonthlyExpensesByCategory(monthYear);
+                } else {
+                    int32_t first, last;
+                    budgetPeriodDays(rule.period, budgetPeriodKey(rule.period, reference), first, last);
+                    expenses[period] = getExpensesByCategory(first, last);
+                }
+                for (const auto& entry : expenses[period]) totals[period] += entry.second;
+            }
+            auto spent = expenses[period].find(rule.category);
+            statuses.emplace_back(rule, rule.isGlobal() ? totals[period]
+                                        : spent == expenses[period].end() ? Money() : spent->second);
+        }
+        return statuses;
+    }
+
+    // Budget table label: category (or "All expenses") plus the period unless monthly
+    static string budgetLabel(const string& category, BudgetPeriod period) {
+        string label = category.empty() ? "All expenses" : category;
+        if (period != BudgetPeriod::Monthly) label += string(" (") + budgetPeriodName(period) + ")";
+        return label;
+    }
+
+    // In verification mode, compare the aggregate table with a full recomputation
+    void verifyAggregatesIfEnabled(ostream& out = cout) {
+        if (!verifyAggregates) return;
+        size_t mismatches = transactions.verifyMonthTotals(out);
+        if (mismatches == 0) {
+            out << "🔍 Aggregate verification passed (" << transactions.size() << " rows)." << endl;
+        } else {
+            out << "❌ Aggregate verification found " << mismatches << " mismatches!" << endl;
+        }
+    }
+
+    // Check budget limits for current month
+    void checkBudgetLimits(ostream& out = cout) {
+        verifyAggregatesIfEnabled(out);
+
+        if (budgetRules.empty()) {
+            out << "\n📊 No budget limits set. Use option 7 to set budget limits." << endl;
+            return;
+        }
+
+        string currentMonth = getCurrentMonthYear();
+
+        out << "\n=== BUDGET ANALYSIS FOR " << currentMonth << " ===" << endl;
+        out << left << setw(20) << "Category" << setw(12) << "Spent" 
+             << setw(12) << "Budget" << setw(12) << "Remaining" << "Status" << endl;
+        out << string(70, '-') << endl;
+
+        bool anyOverBudget = false;
+
+        for (const auto& budget : getBudgetStatus(currentMonth)) {
+            out << left << setw(20) << budgetLabel(budget.category, budget.period)
+                 << "$" << right << setw(10) << fixed << setprecision(2) << budget.spent
+                 << "$" << right << setw(10) << fixed << setprecision(2) << budget.limit
+                 << "$" << right << setw(10) << fixed << setprecision(2) << budget.remaining;
+
+            if (budget.level == BudgetLevel::Over) {
+                out << " 🚨 OVER BUDGET!";
+                anyOverBudget = true;
+            } else if (budget.level == BudgetLevel::Warning) {
+                out << " ⚠️  WARNING!";
+            } else if (budget.level == BudgetLevel::Alert) {
+                out << " 🔔 ALERT";
+            } else {
+                out << " ✅ GOOD";
+            }
+            out << endl;
+        }
+
+        if (anyOverBudget) {
+            out << "\n🚨 BUDGET ALERT: You have exceeded budget limits in some categories!" << endl;
+        }
+    }
+
+    // Enhanced alert system with budget integration
+    void checkAndShowAlerts(ostream& out = cout) {
+        ScopedTimer timer(TrackedOperation::Alerts);
+        double percentage = getExpensePercentage();
+
+        out << "\n=== COMPREHENSIVE SPENDING ANALYSIS ===" << endl;
+        out << "Total Income: $" << fixed << setprecision(2) << totalIncome << endl;
+        out << "Total Expenses: $" << fixed << setprecision(2) << totalExpenses << endl;
+        out << "Available Balance: $" << fixed << setprecision(2) << (totalIncome - totalExpenses) << endl;
+        out << "Expense Percentage: " << fixed << setprecision(1) << percentage << "%" << endl;
+
+        // Overall spending alerts
+        const vector<int>& incomeThresholds = budgetRules.incomeAlertThresholds();
+        if (expensesReachPercent(incomeThresholds[2])) {
+            out << "\n🚨 CRITICAL WARNING! 🚨" << endl;
+            out << "You are spending " << fixed << setprecision(1) << percentage << "% of your income!" << endl;
+            out << "IMMEDIATE ACTION REQUIRED: Cut down expenses drastically!" << endl;
+            out << "Recommended actions:" << endl;
+            out << "• Review all non-essential expenses" << endl;
+            out << "• Cancel unnecessary subscriptions" << endl;
+            out << "• Consider additional income sources" << endl;
+        }
+        else if (expensesReachPercent(incomeThresholds[1])) {
+            out << "\n⚠️  WARNING! ⚠️" << endl;
+            out << "You are spending " << fixed << setprecision(1) << percentage << "% of your income!" << endl;
+            out << "Consider reducing your expenses to maintain financial stability." << endl;
+            out << "Recommended actions:" << endl;
+            out << "• Set budget limits for categories" << endl;
+            out << "• Track daily expenses more carefully" << endl;
+        }
+        else if (expensesReachPercent(incomeThresholds[0])) {
+            out << "\n🔔 ALERT! 🔔" << endl;
+            out << "You are spending " << fixed << setprecision(1) << percentage << "% of your income!" << endl;
+            out << "Monitor your spending carefully to avoid financial strain." << endl;
+            out << "Consider setting budget limits for better control." << endl;
+        }
+        else {
+            out << "\n✅ EXCELLENT! Your spending is under control." << endl;
+            out << "Keep up the good financial habits!" << endl;
+        }
+
+        // Budget-specific alerts
+        checkBudgetLimits(out);
+
+        // Savings recommendation
+        Money recommendedSavings = totalIncome.percent(20); // 20% savings goal
+        Money actualSavings = totalIncome - totalExpenses;
+
+        out << "\n💰 SAVINGS ANALYSIS:" << endl;
+        out << "Recommended Savings (20%): $" << fixed << setprecision(2) << recommendedSavings << endl;
+        out << "Current Savings: $" << fixed << setprecision(2) << actualSavings << endl;
+
+        if (actualSavings >= recommendedSavings) {
+            out << "🎉 Great job! You're meeting your savings goal!" << endl;
+        } else {
+            out << "💡 Try to save $" << fixed << setprecision(2) 
+                 << (recommendedSavings - actualSavings) << " more to reach 20% savings rate." << endl;
+        }
+    }
+
+    // Daily expense series, built from the ledger on first use
+    const SpendingTrends& spendingTrends() {
+        if (!trends.isBuilt()) trends.rebuild(transactions);
+        return trends;
+    }
+
+    // Spending pace as of day for every category with expenses in the 60
+    // days before it or this month, fastest projected first, then all expenses
+    vector<SpendingForecast> getSpendingForecasts(int32_t day) {
+        ScopedTimer timer(TrackedOperation::Trends);
+        const SpendingTrends& series = spendingTrends();
+        vector<SpendingForecast> forecasts;
+        for (uint32_t id = 0; id < transactions.categoryDictionary().size(); id++) {
+            SpendingForecast forecast = series.forecast(id, day);
+            if (forecast.monthToDate > Money() || forecast.dailyAverage30 > Money() ||
+                forecast.previous30 > Money()) {
+                forecasts.push_back(forecast);
+            }
+        }
+        sort(forecasts.begin(), forecasts.end(), [](const SpendingForecast& a, const SpendingForecast& b) {
+            return a.projectedMonthEnd > b.projectedMonthEnd;
+        });
+        forecasts.push_back(series.forecast(kAnyCategory, day));
+        timer.addRows(forecasts.size());
+        return forecasts;
+    }
+
+    // Expense series of a category (kAnyCategory for all) up to day
+    vector<SeriesPoint> getSpendingSeries(uint32_t categoryId, SeriesBucket bucket, int32_t day, size_t periods,
+                                          size_t window) {
+        ScopedTimer timer(TrackedOperation::Trends);
+        vector<SeriesPoint> points = spendingTrends().series(categoryId, bucket, day, periods, window);
+        timer.addRows(points.size());
+        return points;
+    }
+
+    // The monthly budget rule a forecast is compared with, or null
+    const BudgetRule* monthlyBudgetFor(const SpendingForecast& forecast) const {
+        string category = forecast.categoryId == kAnyCategory
+                              ? string() : transactions.categoryDictionary().name(forecast.categoryId);
+        int32_t index = budgetRules.indexOf(category, BudgetPeriod::Monthly);
+        return index < 0 ? nullptr : &budgetRules.all()[static_cast<size_t>(index)];
+    }
+
+    // Show burn rates and month-end projections against the monthly budgets,
+    // then the weekly expense series with its moving average
+    void showSpendingTrends(ostream& out = cout) {
+        int32_t today = parseDate(getCurrentDate());
+        vector<SpendingForecast> forecasts = getSpendingForecasts(today);
+
+        out << "\n=== SPENDING TRENDS AS OF " << formatDate(today) << " ===" << endl;
+        if (forecasts.size() == 1 && forecasts.back().dailyAverage30 == Money() &&
+            forecasts.back().monthToDate == Money()) {
+            out << "No expenses in the last 60 days." << endl;
+        } else {
+            out << left << setw(20) << "Category" << setw(12) << "This month" << setw(11) << "7-day avg"
+                << setw(11) << "30-day avg" << setw(10) << "Trend" << setw(12) << "Projected" << setw(13)
+                << "Budget" << "Status" << endl;
+            out << string(100, '-') << endl;
+            for (const SpendingForecast& forecast : forecasts) {
+                if (forecast.categoryId == kAnyCategory) out << string(100, '-') << endl;
+                string label = forecast.categoryId == kAnyCategory
+                                   ? "All expenses" : transactions.categoryDictionary().name(forecast.categoryId);
+                double change;
+                string trend = "n/a";
+                if (forecast.velocityChange(change)) {
+                    char text[16];
+                    snprintf(text, sizeof(text), "%+.0f%%", change);
+                    trend = text;
+                }
+                out << left << setw(20) << label.substr(0, 19) << "$" << right << setw(11) << fixed
+                    << setprecision(2) << forecast.monthToDate << " $" << setw(9) << forecast.dailyAverage7
+                    << " $" << setw(9) << forecast.dailyAverage30 << "  " << left << setw(8) << trend << "$"
+                    << right << setw(11) << forecast.projectedMonthEnd;
+                const BudgetRule* budget = monthlyBudgetFor(forecast);
+                if (!budget) {
+                    out << endl;
+                    continue;
+                }
+                out << " $" << setw(10) << budget->limit << " ";
+                switch (budgetLevel(forecast.projectedMonthEnd, budget->limit, budget->thresholds)) {
+                    case BudgetLevel::Over: out << "🚨 HEADING OVER"; break;
+                    case BudgetLevel::Warning: out << "⚠️  WARNING"; break;
+                    case BudgetLevel::Alert: out << "🔔 ALERT"; break;
+                    default: out << "✅ ON TRACK"; break;
+                }
+                out << endl;
+            }
+            out << "Averages are per day; the projection adds the 30-day average for each of the "
+                << forecasts.back().daysLeft << " days left this month." << endl;
+        }
+
+        const size_t weeks = 12, window = 4;
+        out << "\n=== WEEKLY EXPENSES (last " << weeks << " weeks, " << window << "-week moving average) ===" << endl;
+        out << left << setw(16) << "Week of" << setw(14) << "Spent" << "Moving avg" << endl;
+        out << string(40, '-') << endl;
+        for (const SeriesPoint& point : getSpendingSeries(kAnyCategory, SeriesBucket::Weekly, today, weeks, window)) {
+            out << left << setw(16) << formatDate(point.firstDay) << "$" << right << setw(11) << fixed
+                << setprecision(2) << point.spent << "  $" << setw(11) << point.movingAverage << endl;
+        }
+    }
+
+    // Set budget limits for categories
+    void setBudgetLimit() {
+        string category, periodText, thresholdText;
+        Money limit;
+
+        cout << "\n=== SET BUDGET LIMIT ===" << endl;
+
+        // Show existing budget limits
+        if (!budgetRules.empty()) {
+            cout << "Existing budget limits:" << endl;
+            for (const auto& rule : budgetRules.all()) {
+                cout << "• " << rule.label() << ": $" << fixed << setprecision(2)
+                     << rule.limit << " per " << budgetPeriodUnit(rule.period)
+                     << " (alerts at " << formatThresholds(rule.thresholds, '/') << "%)" << endl;
+            }
+            cout << endl;
+        }
+
+        cout << "Enter category name (* for all expenses): ";
+        cin.ignore();
+        getline(cin, category);
+        if (category == "*") category.clear();
+
+        cout << "Enter period (weekly/monthly/yearly, Enter for monthly): ";
+        getline(cin, periodText);
+        BudgetPeriod period = BudgetPeriod::Monthly;
+        if (!periodText.empty() && !parseBudgetPeriod(periodText, period)) {
+            cout << "Invalid period! Please enter weekly, monthly or yearly." << endl;
+            return;
+        }
+
+        cout << "Enter budget limit: $";
+        limit = readAmount();
+
+        if (!isValidAmount(limit)) {
+            cout << "Invalid amount! Please enter a positive number up to 100000000000." << endl;
+            return;
+        }
+
+        cout << "Enter alert thresholds in % (Enter for 60,80,100): ";
+        cin.ignore();
+        getline(cin, thresholdText);
+        vector<int> thresholds = defaultBudgetThresholds();
+        if (!thresholdText.empty() && !parseThresholds(thresholdText, thresholds)) {
+            cout << "Invalid thresholds! Please enter ascending percentages such as 50,75,100." << endl;
+            return;
+        }
+
+        string label = budgetLabel(category, period);
+        Money previous;
+        if (setBudget(category, period, limit, thresholds, previous)) {
+            cout << "Budget limit for '" << label << "' updated from $"
+                 << fixed << setprecision(2) << previous
+                 << " to $" << limit << endl;
+        } else {
+            cout << "Budget limit set for '" << label << "': $"
+                 << fixed << setprecision(2) << limit << " per " << budgetPeriodUnit(period) << endl;
+        }
+        saveBudgetLimits();
+    }
+
+    // Set or replace a category's monthly limit with the default thresholds
+    bool setBudget(const string& category, Money limit, Money& previous) {
+        return setBudget(category, BudgetPeriod::Monthly, limit, defaultBudgetThresholds(), previous);
+    }
+
+    // Set or replace a budget rule ("" for all expenses); returns true (and
+    // the old limit in previous) when one already existed
+    bool setBudget(const string& category, BudgetPeriod period, Money limit, const vector<int>& thresholds,
+                   Money& previous) {
+        if (budgetRules.set(category, period, limit, thresholds, previous)) return true;
+        budgetRules.rebuild(transactions); // bring the new rule's running total up to date
+        return false;
+    }
+
+    void setIncomeAlertThresholds(const vector<int>& thresholds) { budgetRules.setIncomeAlertThresholds(thresholds); }
+    const BudgetRuleEngine& budgets() const { return budgetRules; }
+
+    // Alerts raised by expenses added since the last call
+    vector<BudgetAlert> takeBudgetAlerts() {
+        vector<BudgetAlert> alerts;
+        alerts.swap(budgetAlerts);
+        return alerts;
+    }
+
+    // Print the alerts raised by expenses added since the last call
+    void showBudgetAlerts(ostream& out = cout) {
+        for (const BudgetAlert& alert : takeBudgetAlerts()) {
+            const BudgetRule& rule = budgetRules.all()[alert.rule];
+            string label = budgetLabel(rule.category, rule.period);
+            if (alert.threshold >= 100) {
+                out << "🚨 WARNING: Budget exceeded for '" << label << "'! ($" << fixed << setprecision(2)
+                    << alert.spent << " of $" << rule.limit << ")" << endl;
+            } else {
+                out << "⚠️ Reached " << alert.threshold << "% of the budget for '" << label << "' ($" << fixed
+                    << setprecision(2) << alert.spent << " of $" << rule.limit << ")" << endl;
+            }
+        }
+    }
+
+    // Load budget limits from file. Two-column files ("Category,MonthlyLimit")
+    // hold monthly limits; four-column files add the period and thresholds,
+    // use "*" for rules over all expenses and "*income" for the income alerts.
+    void loadBudgetLimits() {
+        MappedFile file(budgetFile);
+        if (!file.isOpen()) {
+            return; // No budget file exists yet
+        }
+
+        CsvTokenizer tokenizer(file.view());
+        vector<string_view> fields;
+        bool header = true;
+
+        while (tokenizer.next(fields)) {
+            if (header) { // Skip header line
+                header = false;
+                continue;
+            }
+            if (fields.empty()) continue;
+            vector<int> thresholds = defaultBudgetThresholds();
+            if (fields.size() >= 4 && !fields[3].empty() && !parseThresholds(fields[3], thresholds)) continue;
+            if (fields[0] == "*income") {
+                if (thresholds.size() == 3) budgetRules.setIncomeAlertThresholds(thresholds);
+                continue;
+            }
+
+            Money limit, previous;
+            BudgetPeriod period = BudgetPeriod::Monthly;
+            if (fields.size() < 2 || !parseAmount(fields[1], limit)) continue;
+            if (fields.size() >= 3 && !fields[2].empty() && !parseBudgetPeriod(fields[2], period)) continue;
+            budgetRules.set(fields[0] == "*" ? string() : string(fields[0]), period, limit, thresholds, previous);
+        }
+    }
+
+    // Save budget limits to file, on the I/O thread when there is one
+    void saveBudgetLimits() {
+        if (!io) {
+            writeBudgetLimits(budgetRules, budgetFile);
+            return;
+        }
+        auto rules = make_shared<BudgetRuleEngine>(budgetRules);
+        string path = budgetFile;
+        io->submit([rules, path] { writeBudgetLimits(*rules, path); });
+    }
+
+    // Write budget rules to path; plain monthly category limits keep the
+    // original two-column format
+    static void writeBudgetLimits(const BudgetRuleEngine& budgetRules, const string& path) {
+        const vector<int> defaultIncomeThresholds = {70, 80, 90};
+        bool customIncome = budgetRules.incomeAlertThresholds() != defaultIncomeThresholds;
+        if (budgetRules.empty() && !customIncome) return;
+
+        bool extended = customIncome;
+        for (const auto& rule : budgetRules.all()) {
+            extended = extended || rule.isGlobal() || rule.period != BudgetPeriod::Monthly ||
+                       rule.thresholds != defaultBudgetThresholds();
+        }
+
+        CsvWriter file(path);
+        if (!file.isOpen()) return;
+
+        // Write header
+        file.raw(extended ? "Category,Limit,Period,Thresholds\n" : "Category,MonthlyLimit\n");
+
+        // Write budget limits
+        for (const auto& rule : budgetRules.all()) {
+            file.field(rule.isGlobal() ? "*" : rule.category);
+            file.separator();
+            file.amount(rule.limit);
+            if (extended) {
+                file.separator();
+                file.field(budgetPeriodName(rule.period));
+                file.separator();
+                file.field(formatThresholds(rule.thresholds, ';'));
+            }
+            file.endRow();
+        }
+        if (customIncome) {
+            file.raw("*income,,,");
+            file.field(formatThresholds(budgetRules.incomeAlertThresholds(), ';'));
+            file.endRow();
+        }
+
+        file.commit();
+    }
+
+    // Load categorization rules (Match,Pattern,Category), keeping their order
+    void loadCategoryRules() {
+        MappedFile file(rulesFile);
+        if (!file.isOpen()) return;
+        CsvTokenizer tokenizer(file.view());
+        vector<string_view> fields;
+        bool header = true;
+        string error;
+        while (tokenizer.next(fields)) {
+            if (header) {
+                header = false;
+                continue;
+            }
+            if (fields.size() == 1 && fields[0].empty()) continue;
+            MatchKind kind;
+            if (fields.size() < 3 || !parseMatchKind(fields[0], kind) ||
+                !categoryRules.add(kind, string(fields[1]), string(trimField(fields[2])), error)) {
+                log << "⚠️ Skipped categorization rule on line " << tokenizer.recordLine() << " of '" << rulesFile
+                    << "'" << (error.empty() ? "" : ": " + error) << endl;
+                error.clear();
+            }
+        }
+    }
+
+    bool saveCategoryRules() {
+        CsvWriter file(rulesFile);
+        if (!file.isOpen()) return false;
+        file.raw("Match,Pattern,Category\n");
+        for (const CategoryRule& rule : categoryRules.all()) {
+            file.field(matchKindName(rule.kind));
+            file.separator();
+            file.field(rule.pattern);
+            file.separator();
+            file.field(rule.category);
+            file.endRow();
+        }
+        return file.commit();
+    }
+
+    // Add a categorization rule after the existing ones and save the rules
+    bool addCategoryRule(MatchKind kind, const string& pattern, const string& category, string& error) {
+        if (!categoryRules.add(kind, pattern, category, error)) return false;
+        if (!saveCategoryRules()) {
+            error = "could not write '" + rulesFile + "'";
+            return false;
+        }
+        return true;
+    }
+
+    CategoryRuleEngine& categorizationRules() { return categoryRules; }
+
+    // Add manual transaction with enhanced feedback
+    void addTransaction() {
+        string type, description, category, dateInput;
+        Money amount;
+
+        cout << "\n=== ADD TRANSACTION ===" << endl;
+        cout << "Enter transaction type (income/expense): ";
+        cin >> type;
+        transform(type.begin(), type.end(), type.begin(), ::tolower);
+
+        if (type != "income" && type != "expense") {
+            cout << "Invalid transaction type! Please enter 'income' or 'expense'." << endl;
+            return;
+        }
+
+        cout << "Enter amount: $";
+        amount = readAmount();
+
+        if (!isValidAmount(amount)) {
+            cout << "Invalid amount! Please enter a positive number up to 100000000000." << endl;
+            return;
+        }
+
+        cin.ignore(); // Clear input buffer
+        cout << "Enter description: ";
+        getline(cin, description);
+
+        cout << "Enter category: ";
+        getline(cin, category);
+
+        cout << "Enter date (or press Enter for current date): ";
+        getline(cin, dateInput);
+
+        if (dateInput.empty()) {
+            dateInput = getCurrentDate();
+        }
+
+        // Add transaction and make it durable before reporting success
+        double durableSeconds = recordTransaction(dateInput, description, amount, category, parseType(type));
+
+        // Report result
+        if (type == "income") {
+            cout << "✅ Income of $" << fixed << setprecision(2) << amount << " added successfully!" << endl;
+        } else {
+            cout << "💸 Expense of $" << fixed << setprecision(2) << amount << " recorded successfully!" << endl;
+
+            // Budget rules for this expense's category and for all expenses
+            int32_t day = transactions.day(transactions.size() - 1);
+            for (const string& scope : {category, string()}) {
+                for (BudgetPeriod period : {BudgetPeriod::Weekly, BudgetPeriod::Monthly, BudgetPeriod::Yearly}) {
+                    int32_t index = budgetRules.indexOf(scope, period);
+                    if (index < 0 || day == kUnknownDay) continue;
+                    const BudgetRule& rule = budgetRules.all()[static_cast<size_t>(index)];
+                    const BudgetProgress& progress = budgetRules.progress(static_cast<size_t>(index));
+                    if (progress.periodKey != budgetPeriodKey(period, day)) continue;
+                    cout << "📊 " << (scope.empty() ? string("Total") : "Category '" + scope + "'")
+                         << " spending this " << budgetPeriodUnit(period) << ": $" << fixed << setprecision(2)
+                         << progress.spent << " / $" << rule.limit
+                         << " (" << fixed << setprecision(1) << progress.spent.percentOf(rule.limit) << "%)" << endl;
+                }
+            }
+            showBudgetAlerts();
+        }
+
+        string journalError;
+        if (io) {
+            cout << "💾 Saving to the journal in the background." << endl;
+        } else if (takeJournalError(journalError)) {
+            cout << "❌ " << journalError << "; the transaction is only in memory until a write succeeds." << endl;
+        } else {
+            cout << "💾 Saved to journal in " << fixed << setprecision(2) << durableSeconds * 1000 << " ms" << endl;
+        }
+
+        // Show quick financial summary
+        cout << "\n📈 Quick Summary:" << endl;
+        cout << "Total Income: $" << fixed << setprecision(2) << totalIncome << endl;
+        cout << "Total Expenses: $" << fixed << setprecision(2) << totalExpenses << endl;
+        cout << "Available Balance: $" << fixed << setprecision(2) << (totalIncome - totalExpenses) << endl;
+
+        checkAndShowAlerts();
+    }
+
+    // Add one transaction and journal it; returns the seconds spent waiting
+    // for it to become durable (none when the write is queued)
+    double recordTransaction(const string& date, const string& description, Money amount,
+                             const string& category, TransactionType type) {
+        ScopedTimer timer(TrackedOperation::Add);
+        timer.addRows(1);
+        appendTransaction(date, description, amount, category, type);
+        string record;
+        TransactionJournal::formatRecord(record, date, description, amount, category, type);
+        return journalRecords(move(record), 1);
+    }
+
+    // Append records made by TransactionJournal::formatRecord to the journal
+    // and sync it, on the I/O thread when there is one; returns the seconds
+    // spent waiting here. Records that cannot be written stay pending for the
+    // next commit; the error goes to takeJournalError(), or from the I/O
+    // thread to the menu.
+    double journalRecords(string records, size_t count) {
+        unsavedRows += count;
+        if (!io) {
+            journal.append(records, count);
+            if (journal.commit()) return journal.lastCommitSeconds();
+            journalFailure = journal.error();
+            return 0.0;
+        }
+        io->submit([this, records = move(records), count] {
+            journal.append(records, count);
+            if (!journal.commit()) {
+                notify("❌ " + journal.error() + "; recent transactions are only in memory until a write succeeds.");
+            }
+        });
+        return 0.0;
+    }
+
+    // The error of the last foreground journal write that failed, if any
+    // since the previous call; clears it
+    bool takeJournalError(string& error) {
+        if (journalFailure.empty()) return false;
+        error = move(journalFailure);
+        journalFailure.clear();
+        return true;
+    }
+
+    // Append one transaction to the ledger and update totals
+    void appendTransaction(string_view date, string_view description, Money amount,
+                           string_view category, TransactionType type, uint64_t fingerprint = 0) {
+        transactions.append(date, description, amount, category, type, fingerprint);
+        if (type == TransactionType::Income) {
+            totalIncome += amount;
+        } else {
+            totalExpenses += amount;
+            int32_t day = transactions.day(transactions.size() - 1);
+            budgetRules.observe(category, day, amount, &budgetAlerts);
+            trends.observe(transactions.categoryId(transactions.size() - 1), day, amount);
+        }
+    }
+
+    // Materialize ingested rows into the ledger; journaled rows are also logged for durability.
+    // With skipDuplicates, rows the ledger already holds are left out (see Ledger::findDuplicates).
+    size_t appendRows(const IngestResult& result, bool journaled, bool skipDuplicates = false,
+                      size_t* duplicates = nullptr) {
+        vector<uint64_t> fingerprints;
+        vector<uint8_t> duplicate;
+        size_t skipped = skipDuplicates ? transactions.findDuplicates(result.rows, fingerprints, duplicate) : 0;
+        if (duplicates) *duplicates = skipped;
+        transactions.reserve(transactions.size() + result.rows.size() - skipped);
+        Ledger::BulkAppend bulk(transactions);
+        // Journal records go out in blocks of a few MB, each synced once
+        const size_t blockBytes = 4 << 20;
+        string records;
+        size_t recordCount = 0;
+        for (size_t i = 0; i < result.rows.size(); i++) {
+            if (skipped > 0 && duplicate[i]) continue;
+            const RawRow& row = result.rows[i];
+            TransactionType type = parseType(row.type);
+            appendTransaction(row.date, row.description, row.amount, row.category, type,
+                              skipDuplicates ? fingerprints[i] : 0);
+            if (!journaled) continue;
+            TransactionJournal::formatRecord(records, row.date, row.description, row.amount, row.category, type);
+            recordCount++;
+            if (records.size() >= blockBytes) {
+                journalRecords(move(records), recordCount);
+                records = string();
+                recordCount = 0;
+            }
+        }
+        if (recordCount > 0) journalRecords(move(records), recordCount);
+        return result.rows.size() - skipped;
+    }
+
+    // Replay transactions journaled since the last compaction
+    void replayJournal() {
+        ScopedTimer timer(TrackedOperation::JournalReplay);
+        size_t replayed = 0;
+        bool stale = false;
+        bool damaged = false;
+        {
+            MappedFile file(journalFile);
+            string_view contents = file.view();
+            timer.addBytesRead(contents.size());
+
+            if (!contents.empty() && !TransactionJournal::appliesTo(contents, fileStamp(dataFile))) {
+                // Written against a different data file (e.g. compaction finished but the
+                // journal was not reset); keep it aside rather than applying it twice
+                stale = true;
+                contents = string_view();
+            }
+
+            CsvTokenizer tokenizer(contents);
+            vector<string_view> fields;
+            bool header = true;
+            Ledger::BulkAppend bulk(transactions);
+            while (tokenizer.next(fields)) {
+                if (header) {
+                    header = false;
+                    continue;
+                }
+                RawRow row;
+                if (!tokenizer.recordTerminated()) {
+                    damaged = true; // torn final record
+                    break;
+                }
+                if (tokenizer.recordMalformed() || !parseJournalRecord(tokenizer.recordText(), fields, row)) {
+                    log << "⚠️ Journal record " << replayed + 1 << " is corrupt; ignoring the rest." << endl;
+                    damaged = true;
+                    break;
+                }
+                appendTransaction(row.date, row.description, row.amount, row.category, parseType(row.type));
+                replayed++;
+            }
+        } // unmap before the journal is renamed or rewritten
+
+        if (stale) {
+            replaceFile(journalFile, journalFile + ".stale");
+            log << "⚠️ Journal does not match '" << dataFile << "'; moved to '"
+                 << journalFile << ".stale'" << endl;
+        }
+
+        journal.open(journalFile, replayed);
+        timer.addRows(replayed);
+        if (replayed > 0) {
+            log << "Replayed " << replayed << " journaled transactions." << endl;
+        }
+        if (damaged) {
+            compactJournal(); // drop the damaged tail so new records are not appended after it
+        } else if (replayed == 0) {
+            journal.reset(fileStamp(dataFile));
+        }
+    }
+
+    // Rewrite the data file and snapshot from ledger and start an empty
+    // journal on top of them; bytes receives the data file's size
+    bool writeDataFiles(const Ledger& ledger, uint64_t& bytes) {
+        ScopedTimer timer(TrackedOperation::Compact);
+        if (!saveData(ledger)) return false;
+        FileStamp saved = fileStamp(dataFile);
+        bytes = saved.size;
+        timer.addRows(ledger.size());
+        timer.addBytesWritten(bytes);
+        ledger.writeSnapshot(snapshotFile, saved);
+        journal.reset(saved);
+        return true;
+    }
+
+    // Rewrite the main data file with the whole ledger and truncate the journal
+    void compactJournal() {
+        size_t journaled = journal.recordCount();
+        auto start = chrono::steady_clock::now();
+        uint64_t bytes = 0;
+        if (!writeDataFiles(transactions, bytes)) {
+            log << "Error: Could not save data to file." << endl;
+            return;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        log << "💾 Compacted " << journaled << " journaled transactions into '" << dataFile << "' ("
+             << transactions.size() << " rows, " << fixed << setprecision(0)
+             << (seconds > 0 ? transactions.size() / seconds : 0.0) << " rows/sec, " << setprecision(1)
+             << (seconds > 0 ? bytes / seconds / 1e6 : 0.0) << " MB/s)" << endl;
+    }
+
+    // Report the memory footprint of the columnar ledger (with --stats or --metrics-file)
+    void showMemoryUsage() {
+        if (transactions.empty() || !metricsRegistry.enabled()) return;
+        log << "💾 Ledger memory: " << fixed << setprecision(1) << transactions.bytesPerRow()
+             << " bytes/row (vs " << transactions.rowObjectBytesPerRow() << " bytes/row as row objects)" << endl;
+    }
+
+    // Recompute income/expense totals from the ledger columns
+    void recomputeTotals() {
+        totalIncome = transactions.amountStats(TransactionType::Income).total();
+        totalExpenses = transactions.amountStats(TransactionType::Expense).total();
+    }
+
+    // Load the ledger from the binary snapshot if it mirrors the current data file
+    bool loadSnapshot() {
+        auto start = chrono::steady_clock::now();
+        string error;
+        {
+            MappedFile file(snapshotFile);
+            if (!file.isOpen()) return false;
+            if (!transactions.loadSnapshot(file.view(), fileStamp(dataFile), error)) {
+                log << "Snapshot '" << snapshotFile << "' ignored (" << error << "); reading CSV." << endl;
+                return false;
+            }
+        }
+        recomputeTotals();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        log << "Loaded " << transactions.size() << " transactions from snapshot in "
+             << fixed << setprecision(1) << seconds * 1000 << " ms." << endl;
+        showMemoryUsage();
+        return true;
+    }
+
+    // Load data from the snapshot, or from the CSV file if there is no usable snapshot
+    void loadData() {
+        ScopedTimer timer(TrackedOperation::Load);
+        if (loadSnapshot()) {
+            timer.addRows(transactions.size());
+            timer.addBytesRead(fileSizeOrZero(snapshotFile));
+            return;
+        }
+
+        MappedFile file(dataFile);
+        if (!file.isOpen()) {
+            log << "No existing data file found. Starting fresh." << endl;
+            return;
+        }
+
+        IngestResult result = ingestCsv(file.view(), IngestOptions());
+        appendRows(result, false);
+        timer.addRows(result.rows.size());
+        timer.addBytesRead(result.bytesScanned);
+
+        for (const auto& error : result.errors) {
+            log << "Skipped line " << error.first << ": " << error.second << endl;
+        }
+        log << "Loaded " << transactions.size() << " transactions from file ("
+             << fixed << setprecision(0) << result.rowsPerSecond() << " rows/sec)." << endl;
+        showMemoryUsage();
+
+        // Make the next start a snapshot load
+        if (!transactions.empty()) transactions.writeSnapshot(snapshotFile, fileStamp(dataFile));
+    }
+
+    // Save ledger to the CSV data file (written to a temporary file, then renamed into place)
+    bool saveData(const Ledger& ledger) {
+        ScopedTimer timer(TrackedOperation::Save);
+        CsvWriter file(dataFile);
+        if (!file.isOpen()) return false;
+
+        // Write header
+        file.raw("Date,Description,Amount,Category,Type\n");
+
+        // Write transactions
+        writeLedgerRows(file, ledger);
+        timer.addRows(ledger.size());
+        timer.addBytesWritten(file.bytesWritten());
+        return file.commit();
+    }
+
+    // Queue a save of everything entered so far. The I/O thread rewrites the
+    // data file and snapshot from a copy of the ledger's columns, so only
+    // making the copy holds up the caller; returns the seconds that took.
+    double queueAutosave() {
+        auto start = chrono::steady_clock::now();
+        auto copy = make_shared<Ledger>(transactions.storedCopy());
+        double copySeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        unsavedRows = 0;
+        lastAutosave = chrono::steady_clock::now();
+        runIo([this, copy, copySeconds] {
+            auto begin = chrono::steady_clock::now();
+            uint64_t bytes = 0;
+            if (!writeDataFiles(*copy, bytes)) {
+                notify("❌ Autosave could not write '" + dataFile + "'; new transactions are still in the journal.");
+                return;
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+            ostringstream message;
+            message << "💾 Autosaved " << copy->size() << " transactions to '" << dataFile << "' in " << fixed
+                    << setprecision(0) << seconds * 1000 << " ms (the menu waited " << setprecision(1)
+                    << copySeconds * 1000 << " ms for the copy)";
+            notify(message.str());
+        });
+        return copySeconds;
+    }
+
+    // Autosave if transactions were journaled since the last save and the
+    // autosave interval has passed
+    void autosaveIfDue() {
+        if (io && unsavedRows > 0 && chrono::steady_clock::now() - lastAutosave >= autosaveInterval) {
+            queueAutosave();
+        }
+    }
+
+    // Run task on the I/O thread if there is one, else right away
+    void runIo(function<void()> task) {
+        if (io) {
+            io->submit(move(task));
+        } else {
+            task();
+        }
+    }
+
+    // Leave a message from background work for the menu to show
+    void notify(string message) {
+        lock_guard<mutex> guard(noticeLock);
+        notices.push_back(move(message));
+    }
+
+    // Show messages from finished background work and the progress of
+    // imports, merging those that have been parsed
+    void showBackgroundNotices() {
+        vector<string> ready;
+        {
+            lock_guard<mutex> guard(noticeLock);
+            ready.swap(notices);
+        }
+        for (const string& message : ready) cout << message << endl;
+        finishBackgroundImports();
+        for (const auto& job : imports) {
+            uint64_t total = job->totalBytes.load(memory_order_relaxed);
+            cout << "⏳ Importing '" << job->filename << "': ";
+            if (total == 0) {
+                cout << "waiting for earlier disk work" << endl;
+            } else {
+                uint64_t parsed = min(job->bytesParsed.load(memory_order_relaxed), total);
+                cout << parsed * 100 / total << "% of " << fixed << setprecision(1) << total / 1e6 << " MB" << endl;
+            }
+        }
+    }
+
+    // Show queued disk work, running imports and the last autosave, then save now
+    void showBackgroundStatus() {
+        cout << "\n=== BACKGROUND TASKS ===" << endl;
+        if (!io) {
+            cout << "Disk writes happen in the foreground." << endl;
+            return;
+        }
+        cout << "🧵 Disk tasks queued: " << io->pending() << " (" << io->completed() << " done, "
+             << fixed << setprecision(0) << io->busyTime() * 1000 << " ms of disk work so far)" << endl;
+        for (const auto& job : imports) {
+            uint64_t total = job->totalBytes.load(memory_order_relaxed);
+            uint64_t parsed = min(job->bytesParsed.load(memory_order_relaxed), total);
+            cout << "📥 Importing '" << job->filename << "': " << (total ? parsed * 100 / total : 0) << "%" << endl;
+        }
+        cout << "💾 Autosave every " << autosaveInterval.count()
+             << "s while there are unsaved transactions (checked after each menu action)" << endl;
+        if (unsavedRows == 0) {
+            cout << "✅ Every transaction is in '" << dataFile << "' or queued to be." << endl;
+            return;
+        }
+        cout << "📝 " << unsavedRows << " transaction(s) are only in the journal so far." << endl;
+        double copySeconds = queueAutosave();
+        cout << "💾 Saving now in the background (the copy took " << fixed << setprecision(1)
+             << copySeconds * 1000 << " ms)." << endl;
+    }
+
+    // Load data from Excel/CSV file provided by user
+    void loadFromExcelFile() {
+        string filename;
+        cout << "\n=== LOAD FROM EXCEL/CSV FILE ===" << endl;
+        cout << "Enter the filename (with extension): ";
+        cin >> filename;
+
+        cout << "Expected CSV format: Date,Description,Amount,Category,Type" << endl;
+        cout << "Processing file..." << endl;
+
+        if (io) {
+            error_code error;
+            if (!filesystem::is_regular_file(filename, error)) {
+                cout << "Error: Could not open file '" << filename << "'" << endl;
+                return;
+            }
+            importInBackground(filename);
+            cout << "📥 Importing '" << filename << "' in the background; progress is shown above the menu." << endl;
+            return;
+        }
+        ImportReport result;
+        if (!importFile(filename, result)) {
+            cout << "Error: Could not open file '" << filename << "'" << endl;
+            return;
+        }
+        showImportReport(filename, result);
+    }
+
+    // Report the outcome of an interactive import
+    void showImportReport(const string& filename, ImportReport& result) {
+        string journalError;
+        if (takeJournalError(journalError)) {
+            cout << "❌ " << journalError << "; the imported transactions are only in memory until a write succeeds."
+                 << endl;
+        }
+        for (const auto& error : result.errors) {
+            cout << "Error processing line " << error.first << ": " << error.second << endl;
+        }
+        size_t addedCount = result.added;
+
+        cout << "Successfully loaded " << addedCount << " transactions from '" << filename << "'" << endl;
+        if (result.duplicates > 0) {
+            cout << "🔁 Skipped " << result.duplicates << " transactions already in the ledger." << endl;
+        }
+        if (result.categorized > 0) {
+            cout << "🏷️  Filled in the category of " << result.categorized << " transactions from '" << rulesFile
+                 << "'." << endl;
+        }
+        cout << "⚡ Parsed " << result.linesScanned << " lines in " << fixed << setprecision(3)
+             << result.seconds << "s on " << result.threadsUsed << " thread(s) ("
+             << setprecision(0) << result.rowsPerSecond() << " rows/sec)" << endl;
+        showMemoryUsage();
+        if (budgetAlerts.size() > 10) {
+            cout << "🔔 The imported expenses crossed " << budgetAlerts.size() << " budget thresholds." << endl;
+            budgetAlerts.clear();
+        }
+        showBudgetAlerts();
+        checkAndShowAlerts();
+    }
+
+    // Import a bank export into the ledger and journal, by default leaving out
+    // rows already in the ledger; false if it cannot be opened. Categorization
+    // rules fill in blank categories (or, with overwrite, every category they
+    // match) before duplicates are checked, so a re-import finds the same rows.
+    bool importFile(const string& filename, ImportReport& report, bool skipDuplicates = true,
+                    bool categorize = true, bool overwriteCategories = false) {
+        ScopedTimer timer(TrackedOperation::Import);
+        MappedFile file(filename);
+        if (!file.isOpen()) return false;
+        IngestResult result = ingestCsv(file.view(), IngestOptions(true, true));
+        if (categorize) report.categorized = categoryRules.categorize(result.rows, overwriteCategories);
+        addImportedRows(result, report, skipDuplicates);
+        timer.addRows(report.added);
+        timer.addBytesRead(result.bytesScanned);
+        return true;
+    }
+
+    // Add parsed import rows to the ledger and journal and fill in report
+    void addImportedRows(IngestResult& result, ImportReport& report, bool skipDuplicates) {
+        report.added = appendRows(result, true, skipDuplicates, &report.duplicates);
+        report.linesScanned = result.linesScanned;
+        report.seconds = result.seconds;
+        report.threadsUsed = result.threadsUsed;
+        report.errors = move(result.errors);
+    }
+
+    // Parse and categorize a bank export on the I/O thread, progress in
+    // bytes included; finishBackgroundImports() adds the rows afterwards
+    void importInBackground(const string& filename) {
+        auto job = make_shared<BackgroundImport>();
+        job->filename = filename;
+        job->started = chrono::steady_clock::now();
+        job->rules = make_unique<CategoryRuleEngine>(categoryRules);
+        imports.push_back(job);
+        io->submit([job] {
+            job->file = make_unique<MappedFile>(job->filename);
+            job->opened = job->file->isOpen();
+            if (job->opened) {
+                job->totalBytes.store(max<uint64_t>(1, job->file->view().size()), memory_order_relaxed);
+                IngestOptions options(true, true);
+                options.progress = &job->bytesParsed;
+                job->result = ingestCsv(job->file->view(), options);
+                job->categorized = job->rules->categorize(job->result.rows, false);
+            }
+            job->parsed.store(true, memory_order_release);
+        });
+    }
+
+    // Add the rows of background imports that have been parsed, in the
+    // order they were started, and report each one
+    void finishBackgroundImports() {
+        while (!imports.empty() && imports.front()->parsed.load(memory_order_acquire)) {
+            shared_ptr<BackgroundImport> job = imports.front();
+            imports.erase(imports.begin());
+            if (!job->opened) {
+                cout << "Error: Could not open file '" << job->filename << "'" << endl;
+                continue;
+            }
+            ImportReport report;
+            {
+                ScopedTimer timer(TrackedOperation::Import);
+                report.categorized = job->categorized;
+                addImportedRows(job->result, report, true);
+                timer.addRows(report.added);
+                timer.addBytesRead(job->result.bytesScanned);
+            }
+            job->file.reset();
+            job->rules.reset();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - job->started).count();
+            cout << "\n📥 Background import of '" << job->filename << "' finished after " << fixed << setprecision(1)
+                 << seconds << "s:" << endl;
+            showImportReport(job->filename, report);
+        }
+    }
+
+    // Display all transactions with enhanced formatting
+    void displayTransactions() {
+        if (transactions.empty()) {
+            cout << "\nNo transactions found." << endl;
+            return;
+        }
+
+        ReportOptions options;
+        options.alerts = true;
+        ReportRenderer renderer;
+        renderReport(renderer, options);
+    }
+
+    // Render the requested report sections; returns the number of transaction rows written
+    size_t renderReport(ReportRenderer& renderer, const ReportOptions& options) {
+        ScopedTimer timer(TrackedOperation::Render);
+        size_t rendered = 0;
+        if (options.rows) {
+            size_t begin = min(options.offset, transactions.size());
+            size_t end = begin + min(options.limit, transactions.size() - begin);
+            rendered = end - begin;
+            timer.addRows(rendered);
+            if (options.csv) {
+                renderCsvRows(renderer, transactions, begin, end);
+                renderer.flush();
+                return rendered;
+            }
+            ostream& out = renderer.stream();
+            out << "\n=== ALL TRANSACTIONS (" << transactions.size() << " total) ===" << endl;
+            if (begin > 0 || end < transactions.size()) {
+                out << "Showing rows " << begin + 1 << "-" << end << endl;
+            }
+            out << left << setw(20) << "Date" << setw(30) << "Description"
+                << setw(12) << "Amount" << setw(15) << "Category" << setw(10) << "Type" << endl;
+            out << string(87, '-') << endl;
+            renderTransactionRows(renderer, transactions, begin, end);
+        }
+        if (options.summary) {
+            ostream& out = renderer.stream();
+            out << "\n📈 Summary:" << endl;
+            out << "Total Income: $" << fixed << setprecision(2) << totalIncome << endl;
+            out << "Total Expenses: $" << fixed << setprecision(2) << totalExpenses << endl;
+            out << "Available Balance: $" << fixed << setprecision(2) << (totalIncome - totalExpenses) << endl;
+        }
+        if (options.categories) writeCategoryAnalysis(renderer.stream());
+        if (options.alerts) checkAndShowAlerts(renderer.stream());
+        renderer.flush();
+        return rendered;
+    }
+
+    // Display enhanced category summary with insights
+    void displayCategorySummary() {
+        if (transactions.empty()) {
+            cout << "\nNo transactions found." << endl;
+            return;
+        }
+
+        ReportOptions options;
+        options.rows = false;
+        options.categories = true;
+        options.alerts = true;
+        ReportRenderer renderer;
+        renderReport(renderer, options);
+    }
+
+    // Category breakdown of income and expenses
+    void writeCategoryAnalysis(ostream& out) {
+        if (transactions.empty()) {
+            out << "\nNo transactions found." << endl;
+            return;
+        }
+
+        // Group by (category, type) across all months, then resolve names once
+        const StringDictionary& categories = transactions.categoryDictionary();
+        map<string, Money> incomeByCategory;
+        map<string, Money> expensesByCategory;
+        for (const QueryRow& row : queries.groupBy(GroupQuery())) {
+            auto& byCategory = row.type == TransactionType::Income ? incomeByCategory : expensesByCategory;
+            byCategory[categories.name(row.categoryId)] = row.cell.sum;
+        }
+
+        out << "\n=== COMPREHENSIVE CATEGORY ANALYSIS ===" << endl;
+
+        if (!incomeByCategory.empty()) {
+            out << "\n💰 INCOME BY CATEGORY:" << endl;
+            out << left << setw(25) << "Category" << setw(15) << "Amount" << "Percentage" << endl;
+            out << string(50, '-') << endl;
+            for (const auto& pair : incomeByCategory) {
+                double percentage = pair.second.percentOf(totalIncome);
+                out << left << setw(25) << pair.first
+                     << "$" << right << setw(13) << fixed << setprecision(2) << pair.second
+                     << "  " << fixed << setprecision(1) << percentage << "%" << endl;
+            }
+        }
+
+        if (!expensesByCategory.empty()) {
+            out << "\n💸 EXPENSES BY CATEGORY:" << endl;
+            out << left << setw(25) << "Category" << setw(15) << "Amount" << "Percentage" << endl;
+            out << string(50, '-') << endl;
+
+            // Sort expenses by amount (highest first)
+            vector<pair<string, Money>> sortedExpenses(expensesByCategory.begin(), expensesByCategory.end());
+            sort(sortedExpenses.begin(), sortedExpenses.end(),
+                 [](const pair<string, Money>& a, const pair<string, Money>& b) {
+                     return a.second > b.second;
+                 });
+
+            for (const auto& pair : sortedExpenses) {
+                double percentage = pair.second.percentOf(totalExpenses);
+                out << left << setw(25) << pair.first
+                     << "$" << right << setw(13) << fixed << setprecision(2) << pair.second
+                     << "  " << fixed << setprecision(1) << percentage << "%";
+
+                // Highlight top spending categories
+                if (percentage >= 30) {
+                    out << " 🔥 HIGH";
+                } else if (percentage >= 15) {
+                    out << " ⚠️  MEDIUM";
+                }
+                out << endl;
+            }
+
+            // Show top spending insight
+            if (!sortedExpenses.empty()) {
+                out << "\n💡 INSIGHT: '" << sortedExpenses[0].first 
+                     << "' is your highest expense category ($" 
+                     << fixed << setprecision(2) << sortedExpenses[0].second << ")" << endl;
+
+                AmountStats expenses = transactions.amountStats(TransactionType::Expense);
+                out << "💡 Single expenses range from $" << expenses.smallest() << " to $" << expenses.largest()
+                     << " across " << expenses.count << " transactions." << endl;
+            }
+        }
+    }
+
+    // Index the loaded descriptions; later appends update the index as they go
+    void buildDescriptionIndex() {
+        auto start = chrono::steady_clock::now();
+        transactions.enableDescriptionIndex();
+        if (transactions.empty()) return;
+        const DescriptionIndex& index = transactions.descriptions();
+        log << "🔎 Indexed " << index.termCount() << " distinct words in " << fixed << setprecision(1)
+            << chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1000 << " ms ("
+            << index.bytesUsed() / 1024.0 / 1024.0 << " MB)." << endl;
+    }
+
+    // Find transactions whose description matches every word of query
+    SearchResult searchDescriptions(const string& query) {
+        ScopedTimer timer(TrackedOperation::Search);
+        auto start = chrono::steady_clock::now();
+        SearchResult result;
+        result.rows = transactions.descriptions().search(query);
+        timer.addRows(result.rows.size());
+        addMatchTotals(result, start);
+        return result;
+    }
+
+    // Find transactions by date range, amount range, categories and type
+    SearchResult findTransactions(const TransactionQuery& query) {
+        ScopedTimer timer(TrackedOperation::Query);
+        auto start = chrono::steady_clock::now();
+        SearchResult result;
+        result.rows = transactions.select(query);
+        timer.addRows(result.rows.size());
+        addMatchTotals(result, start);
+        return result;
+    }
+
+    // Fill in the income/expense totals of the matched rows and the time taken since start
+    void addMatchTotals(SearchResult& result, chrono::steady_clock::time_point start) {
+        for (uint32_t row : result.rows) {
+            (transactions.type(row) == TransactionType::Income ? result.income : result.expenses) +=
+                transactions.amount(row);
+        }
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    // Search transaction descriptions and show the matches with their totals
+    void searchTransactions() {
+        const size_t shown = 200;
+        string query;
+
+        cout << "\n=== SEARCH TRANSACTIONS ===" << endl;
+        cout << "Words match the start of description words; start a word with * to match inside words." << endl;
+        cout << "Enter search words: ";
+        cin.ignore();
+        getline(cin, query);
+
+        SearchResult result = searchDescriptions(query);
+        if (result.rows.empty()) {
+            cout << "No transactions match '" << query << "'." << endl;
+            return;
+        }
+
+        ReportRenderer renderer;
+        ostream& out = renderer.stream();
+        out << "\n=== " << result.rows.size() << " MATCHING TRANSACTIONS ===" << endl;
+        if (result.rows.size() > shown) out << "Showing the first " << shown << endl;
+        out << left << setw(20) << "Date" << setw(30) << "Description"
+            << setw(12) << "Amount" << setw(15) << "Category" << setw(10) << "Type" << endl;
+        out << string(87, '-') << endl;
+        for (size_t i = 0; i < result.rows.size() && i < shown; i++) {
+            renderTransactionRow(renderer, transactions, result.rows[i]);
+        }
+        out << "\nMatching Income: $" << fixed << setprecision(2) << result.income << endl;
+        out << "Matching Expenses: $" << fixed << setprecision(2) << result.expenses << endl;
+        out << "Search time: " << setprecision(3) << result.seconds * 1000 << " ms" << endl;
+        renderer.flush();
+    }
+
+    // Export data to CSV with enhanced options
+    void exportToCSV() {
+        string filename;
+        cout << "\nEnter filename for export (with .csv extension): ";
+        cin >> filename;
+
+        // Written from a copy on the I/O thread when there is one
+        if (io) {
+            auto copy = make_shared<Ledger>(transactions.storedCopy());
+            Money income = totalIncome, expenses = totalExpenses;
+            string generated = getCurrentDate(); // ctime() is not safe to call from two threads
+            io->submit([this, filename, copy, income, expenses, generated] {
+                notify(exportWithSummary(filename, *copy, income, expenses, generated));
+            });
+            cout << "📤 Exporting " << transactions.size() << " transactions to '" << filename
+                 << "' in the background." << endl;
+            return;
+        }
+        cout << exportWithSummary(filename, transactions, totalIncome, totalExpenses, getCurrentDate()) << endl;
+    }
+
+    // Export ledger to filename and describe the outcome for the user
+    static string exportWithSummary(const string& filename, const Ledger& ledger, Money income, Money expenses,
+                                    const string& generated) {
+        auto start = chrono::steady_clock::now();
+        uint64_t bytes = 0;
+        if (!writeExport(filename, ledger, income, expenses, generated, bytes)) {
+            return "Error: Could not write export file.";
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        ostringstream message;
+        message << "✅ Data exported successfully to '" << filename << "'\n";
+        message << "⚡ Wrote " << fixed << setprecision(1) << bytes / 1e6 << " MB in " << setprecision(1)
+                << seconds * 1000 << " ms (" << (seconds > 0 ? bytes / seconds / 1e6 : 0.0) << " MB/s)\n";
+        message << "📊 Export includes " << ledger.size() << " transactions and summary metadata.";
+        return message.str();
+    }
+
+    // Write the ledger with a summary header to filename; bytes receives the file size
+    bool exportTo(const string& filename, uint64_t& bytes) {
+        return writeExport(filename, transactions, totalIncome, totalExpenses, getCurrentDate(), bytes);
+    }
+
+    // Write ledger with a summary header of the given totals to filename
+    static bool writeExport(const string& filename, const Ledger& ledger, Money totalIncome, Money totalExpenses,
+                            const string& generated, uint64_t& bytes) {
+        ScopedTimer timer(TrackedOperation::Export);
+        CsvWriter file(filename);
+        if (!file.isOpen()) return false;
+
+        // Write header with additional metadata
+        file.raw("Date,Description,Amount,Category,Type\n");
+        file.raw("# Export generated on: ");
+        file.raw(generated);
+        file.raw("\n# Total transactions: ");
+        file.integer(ledger.size());
+        file.raw("\n# Total income: $");
+        file.amount(totalIncome);
+        file.raw("\n# Total expenses: $");
+        file.amount(totalExpenses);
+        file.raw("\n# Net balance: $");
+        file.amount(totalIncome - totalExpenses);
+        file.endRow();
+
+        // Write ledger
+        writeLedgerRows(file, ledger);
+
+        bytes = file.bytesWritten();
+        timer.addRows(ledger.size());
+        timer.addBytesWritten(bytes);
+        return file.commit();
+    }
+};
+
+// Directory holding one subdirectory per account
+const char* const kAccountsDirectory = "accounts";
+
+// Account names become directory names, so keep them to a safe character set
+inline bool isValidAccountName(string_view name) {
+    if (name.empty() || name.size() > 64 || name[0] == '.') return false;
+    for (char c : name) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') return false;
+    }
+    return true;
+}
+
+inline string accountDirectory(const string& name, const string& root = kAccountsDirectory) {
+    return root + "/" + name;
+}
+
+// A set of account ledgers ("shards"), each an ExpenseTracker over its own
+// directory. Shards load in parallel. Merged reports run the group-by on
+// every shard and combine the groups by category name, so rows are never
+// copied between shards.
+class LedgerSet {
+public:
+    struct Shard {
+        string name;
+        unique_ptr<ostringstream> log;  // load messages; outlives the tracker that writes to it
+        unique_ptr<ExpenseTracker> tracker;
+        double loadSeconds;
+        vector<uint32_t> mergedIds;      // shard category id -> id in the merged dictionary, grown as needed
+        unique_ptr<QueryEngine> queries; // with the shard's share of the threads; kept between reports
+    };
+
+private:
+    vector<Shard> shards;
+    StringDictionary categories;  // all shards' categories; the ids used in merged results
+    unsigned threads;
+    unique_ptr<WorkStealingPool> pool;
+    double lastLoadSeconds;
+
+    WorkStealingPool& workers() {
+        if (!pool) pool = make_unique<WorkStealingPool>(threads);
+        return *pool;
+    }
+
+public:
+    explicit LedgerSet(unsigned threadCount = 0)
+        : threads(threadCount ? threadCount : max(1u, thread::hardware_concurrency())), lastLoadSeconds(0.0) {}
+
+    // Accounts found under root, sorted by name
+    static vector<string> discover(const string& root = kAccountsDirectory) {
+        vector<string> names;
+        error_code error;
+        for (filesystem::directory_iterator it(root, error), end; !error && it != end; it.increment(error)) {
+            string name = it->path().filename().string();
+            if (it->is_directory(error) && isValidAccountName(name)) names.push_back(name);
+        }
+        sort(names.begin(), names.end());
+        return names;
+    }
+
+    // Load the named accounts, several at once
+    void open(const vector<string>& names, const string& root = kAccountsDirectory) {
+        auto start = chrono::steady_clock::now();
+        size_t first = shards.size();
+        for (const string& name : names) {
+            shards.emplace_back();
+            shards.back().name = name;
+            shards.back().log = make_unique<ostringstream>();
+            shards.back().loadSeconds = 0.0;
+        }
+        workers().parallelFor(names.size(), [&](size_t i) {
+            Shard& shard = shards[first + i];
+            auto shardStart = chrono::steady_clock::now();
+            shard.tracker = make_unique<ExpenseTracker>(*shard.log, accountDirectory(shard.name, root));
+            shard.loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - shardStart).count();
+        });
+        for (Shard& shard : shards) shard.queries.reset(); // the thread shares changed
+        lastLoadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    size_t size() const { return shards.size(); }
+    const Shard& shard(size_t i) const { return shards[i]; }
+    ExpenseTracker& tracker(size_t i) { return *shards[i].tracker; }
+    double loadSeconds() const { return lastLoadSeconds; }
+    const StringDictionary& categoryDictionary() const { return categories; }
+
+    size_t rows() const {
+        size_t total = 0;
+        for (const Shard& shard : shards) total += shard.tracker->ledger().size();
+        return total;
+    }
+
+    // Run the group-by on every shard and merge the groups; rows come back
+    // sorted like QueryEngine::groupBy, with ids from categoryDictionary().
+    // perShard, if given, receives each shard's own groups with the same ids.
+    vector<QueryRow> groupBy(const GroupQuery& query, vector<vector<QueryRow>>* perShard = nullptr) {
+        // Shard dictionaries grow independently; map the ids added since the last call onto the merged ones
+        for (Shard& shard : shards) {
+            const StringDictionary& own = shard.tracker->ledger().categoryDictionary();
+            for (uint32_t id = static_cast<uint32_t>(shard.mergedIds.size()); id < own.size(); id++) {
+                shard.mergedIds.push_back(categories.intern(own.name(id)));
+            }
+        }
+
+        // Each shard scans with its share of the threads, so large shards still run in parallel
+        unsigned shardThreads = max<unsigned>(1, threads / max<size_t>(shards.size(), 1));
+        for (Shard& shard : shards) {
+            if (!shard.queries) shard.queries = make_unique<QueryEngine>(shard.tracker->ledger(), shardThreads);
+        }
+        vector<vector<QueryRow>> results(shards.size());
+        workers().parallelFor(shards.size(), [&](size_t i) {
+            GroupQuery own = query;
+            if (query.categoryId != kAnyCategory) {
+                own.categoryId = shards[i].tracker->ledger().categoryDictionary().find(categories.name(query.categoryId));
+                if (own.categoryId == StringDictionary::npos) return; // category not used in this shard
+            }
+            results[i] = shards[i].queries->groupBy(own);
+            for (QueryRow& row : results[i]) {
+                if (row.categoryId != kAnyCategory) row.categoryId = shards[i].mergedIds[row.categoryId];
+            }
+        });
+
+        vector<QueryRow> merged;
+        for (const auto& result : results) merged.insert(merged.end(), result.begin(), result.end());
+        auto order = [](const QueryRow& a, const QueryRow& b) {
+            if (a.monthKey != b.monthKey) return a.monthKey < b.monthKey;
+            if (a.categoryId != b.categoryId) return a.categoryId < b.categoryId;
+            return a.type < b.type;
+        };
+        sort(merged.begin(), merged.end(), order);
+        size_t out = 0;
+        for (size_t i = 0; i < merged.size(); i++) {
+            if (out > 0 && !order(merged[out - 1], merged[i])) {
+                merged[out - 1].cell.sum += merged[i].cell.sum;
+                merged[out - 1].cell.count += merged[i].cell.count;
+            } else {
+                merged[out++] = merged[i];
+            }
+        }
+        merged.resize(out);
+        if (perShard) *perShard = move(results);
+        return merged;
+    }
+};
+
+// The row layout used before the columnar Ledger, kept for comparisons:
+// every row owns its own date, description, category and type strings
+struct LegacyTransaction {
+    string date;
+    string description;
+    Money amount;
+    string category;
+    string type;
+
+    LegacyTransaction(const string& d, const string& desc, Money amt, const string& cat, const string& t)
+        : date(d), description(desc), amount(amt), category(cat), type(t) {}
+};
+
+// Shape of a synthetic ledger. The defaults give the data every built-in
+// benchmark uses; changing a field only changes the matching property.
+struct SyntheticLedgerOptions {
+    size_t rows = 100000;
+    size_t categories = 10;        // expense categories (income always uses "Job")
+    int32_t firstDay = daysFromCivil(2022, 1, 1);
+    int32_t days = 3 * 365;        // rows are spread evenly over this many days
+    size_t descriptionWords = 2;
+    double malformedRate = 0.0;    // fraction of lines that cannot be imported
+    unsigned seed = 42;
+};
+
+// Name of the i-th synthetic expense category
+inline string syntheticCategory(size_t i) {
+    static const char* const names[] = {"Food", "Transportation", "Utilities", "Shopping", "Rent",
+                                        "Health", "Entertainment", "Travel", "Education", "Insurance"};
+    return i < 10 ? names[i] : "Category" + to_string(i + 1);
+}
+
+// Write a synthetic ledger CSV; returns false if the file cannot be written
+bool writeSyntheticLedger(const string& path, const SyntheticLedgerOptions& options) {
+    static const char* const words[] = {"Grocery", "Store", "Coffee", "Shop", "Online", "Order", "Monthly",
+                                        "Bill", "Restaurant", "Dinner", "Gas", "Station", "Pharmacy", "Ticket"};
+    // Each kind of bad line is one the importer reports and skips
+    static const char* const malformed[] = {"not a date,Refund,abc,Food,expense\n",
+                                            "2024-01-01,Truncated line\n",
+                                            "2024-01-01,Bad amount,12.3.4,Food,expense\n",
+                                            "2024-01-01,\"Broken \"quote,10.00,Food,expense\n"};
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    mt19937 rng(options.seed);
+    mt19937 malformedRng(options.seed ^ 0x9e3779b9u);
+    bernoulli_distribution isMalformed(min(max(options.malformedRate, 0.0), 1.0));
+    vector<string> categories;
+    for (size_t i = 0; i < max<size_t>(options.categories, 1); i++) categories.push_back(syntheticCategory(i));
+    string buffer = "Date,Description,Amount,Category,Type\n";
+    const size_t rows = options.rows;
+    for (size_t i = 0; i < rows; i++) {
+        if (options.malformedRate > 0 && isMalformed(malformedRng)) {
+            buffer.append(malformed[malformedRng() % 4]);
+            continue;
+        }
+        // Chronological like a real ledger
+        bool income = rng() % 20 == 0;
+        string date = formatDate(options.firstDay + static_cast<int32_t>(i * options.days / max<size_t>(rows, 1)));
+        char amount[32];
+        snprintf(amount, sizeof(amount), "%u.%02u", static_cast<unsigned>(income ? 1000 + rng() % 4000 : 1 + rng() % 300),
+                 static_cast<unsigned>(rng() % 100));
+
+        buffer.append(date).append(1, ',');
+        for (size_t word = 0; word < options.descriptionWords; word++) {
+            if (word > 0) buffer.append(1, ' ');
+            buffer.append(words[rng() % 14]);
+        }
+        buffer.append(1, ',');
+        buffer.append(amount).append(1, ',');
+        buffer.append(income ? "Job" : categories[rng() % categories.size()]).append(1, ',');
+        buffer.append(income ? "income" : "expense").append(1, '\n');
+
+        if (buffer.size() > (1 << 20)) {
+            fwrite(buffer.data(), 1, buffer.size(), file);
+            buffer.clear();
+        }
+    }
+    fwrite(buffer.data(), 1, buffer.size(), file);
+    return fclose(file) == 0;
+}
+
+// Write the default synthetic ledger with the given number of rows
+bool writeSyntheticLedger(const string& path, size_t rows, unsigned seed = 42) {
+    SyntheticLedgerOptions options;
+    options.rows = rows;
+    options.seed = seed;
+    return writeSyntheticLedger(path, options);
+}
+
+// Parse a CSV file into a fresh ledger; returns false if it cannot be read
+bool loadLedgerFromCsv(const string& path, Ledger& ledger) {
+    MappedFile file(path);
+    if (!file.isOpen()) return false;
+    IngestResult result = ingestCsv(file.view(), IngestOptions());
+    ledger.reserve(result.rows.size());
+    Ledger::BulkAppend bulk(ledger);
+    for (const auto& row : result.rows) {
+        ledger.append(row.date, row.description, row.amount, row.category, parseType(row.type));
+    }
+    return true;
+}
+
+// Fresh scratch directory for one benchmark, so benchmarks never delete or
+// reuse each other's files
+string benchDirectory(const string& name) {
+    string directory = (filesystem::temp_directory_path() / "expense_tracker_bench" / name).string();
+    error_code ignored;
+    filesystem::remove_all(directory, ignored);
+    filesystem::create_directories(directory);
+    return directory;
+}
+
+// Write a synthetic ledger to path and load it back, reporting which step failed
+bool makeBenchLedger(const string& path, const SyntheticLedgerOptions& options, Ledger& ledger) {
+    if (!writeSyntheticLedger(path, options)) {
+        cout << "Error: Could not write '" << path << "'" << endl;
+        return false;
+    }
+    if (!loadLedgerFromCsv(path, ledger)) {
+        cout << "Error: Could not load '" << path << "'" << endl;
+        return false;
+    }
+    return true;
+}
+
+// Same with the default synthetic ledger of the given number of rows
+bool makeBenchLedger(const string& path, size_t rows, Ledger& ledger) {
+    SyntheticLedgerOptions options;
+    options.rows = rows;
+    return makeBenchLedger(path, options, ledger);
+}
+
+// Sample at the given fraction (0.5 = median, 1.0 = max); sorts the samples
+double percentile(vector<double>& samples, double fraction) {
+    if (samples.empty()) return 0.0;
+    sort(samples.begin(), samples.end());
+    return samples[min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))];
+}
+
+// Convert a CSV ledger to a binary snapshot
+int convertToSnapshot(const string& csvPath, const string& snapshotPath) {
+    auto start = chrono::steady_clock::now();
+    Ledger ledger;
+    if (!loadLedgerFromCsv(csvPath, ledger)) {
+        cout << "Error: Could not open file '" << csvPath << "'" << endl;
+        return 1;
+    }
+    if (!ledger.writeSnapshot(snapshotPath, fileStamp(csvPath))) {
+        cout << "Error: Could not write snapshot '" << snapshotPath << "'" << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "✅ Converted " << ledger.size() << " transactions to '" << snapshotPath << "' in "
+         << fixed << setprecision(2) << seconds << "s (" << fileSizeOrZero(snapshotPath) << " bytes)" << endl;
+    return 0;
+}
+
+// Measure import throughput on a synthetic bank export for 1..N threads
+int runImportBenchmark(size_t rows) {
+    string directory = benchDirectory("import");
+    string csvPath = directory + "/export.csv";
+
+    cout << "Generating " << rows << " synthetic transactions..." << endl;
+    if (!writeSyntheticLedger(csvPath, rows)) {
+        cout << "Error: Could not write '" << csvPath << "'" << endl;
+        return 1;
+    }
+
+    MappedFile file(csvPath);
+    unsigned maxThreads = max(1u, thread::hardware_concurrency());
+    double baseline = 0.0;
+    cout << left << setw(10) << "Threads" << setw(12) << "Time (ms)" << setw(14) << "Rows/sec" << "Speedup" << endl;
+    cout << string(46, '-') << endl;
+    vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    for (unsigned threads : threadCounts) {
+        IngestResult result = ingestCsv(file.view(), IngestOptions(true, true), threads);
+        if (threads == 1) baseline = result.seconds;
+        cout << left << setw(10) << result.threadsUsed << setw(12) << fixed << setprecision(1)
+             << result.seconds * 1000 << setw(14) << setprecision(0) << result.rowsPerSecond()
+             << setprecision(2) << baseline / max(result.seconds, 1e-9) << "x" << endl;
+    }
+
+    filesystem::remove_all(directory);
+    return 0;
+}
+
+// Compare the RFC 4180 tokenizer with a naive comma split on synthetic data
+int runParserBenchmark(size_t rows) {
+    string directory = benchDirectory("parser");
+    string csvPath = directory + "/parser.csv";
+    if (!writeSyntheticLedger(csvPath, rows)) {
+        cout << "Error: Could not write '" << csvPath << "'" << endl;
+        return 1;
+    }
+
+    // Same rows with every description quoted and containing a comma and an escaped quote
+    string quoted;
+    {
+        MappedFile file(csvPath);
+        CsvTokenizer tokenizer(file.view());
+        vector<string_view> fields;
+        while (tokenizer.next(fields)) {
+            for (size_t i = 0; i < fields.size(); i++) {
+                if (i > 0) quoted.push_back(',');
+                if (i == 1) {
+                    appendCsvField(quoted, string(fields[i]) + ", \"tip\" included");
+                } else {
+                    quoted.append(fields[i].data(), fields[i].size());
+                }
+            }
+            quoted.push_back('\n');
+        }
+    }
+
+    MappedFile file(csvPath);
+    string_view plain = file.view();
+    size_t checksum = 0;
+
+    auto timeIt = [](auto&& body) {
+        auto start = chrono::steady_clock::now();
+        body();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    // The previous loader: split each line on every comma, yielding field views
+    auto naiveSplit = [&](string_view buffer) {
+        vector<string_view> fields;
+        const char* cursor = buffer.data();
+        const char* end = cursor + buffer.size();
+        while (cursor < end) {
+            const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+            string_view line(cursor, (newline ? newline : end) - cursor);
+            cursor = newline ? newline + 1 : end;
+            fields.clear();
+            while (true) {
+                const char* comma = static_cast<const char*>(memchr(line.data(), ',', line.size()));
+                fields.push_back(line.substr(0, comma ? comma - line.data() : line.size()));
+                if (!comma) break;
+                line.remove_prefix(comma - line.data() + 1);
+            }
+            for (string_view field : fields) checksum += field.size();
+        }
+    };
+    auto tokenize = [&](string_view buffer) {
+        CsvTokenizer tokenizer(buffer);
+        vector<string_view> fields;
+        while (tokenizer.next(fields)) {
+            for (string_view field : fields) checksum += field.size();
+        }
+    };
+
+    naiveSplit(plain); // fault the mapping in before timing
+    double naivePlain = timeIt([&] { naiveSplit(plain); });
+    double tokenizerPlain = timeIt([&] { tokenize(plain); });
+    double naiveQuoted = timeIt([&] { naiveSplit(quoted); });
+    double tokenizerQuoted = timeIt([&] { tokenize(quoted); });
+
+    auto report = [&](const char* name, size_t bytes, double seconds, const char* note) {
+        cout << left << setw(28) << name << setw(12) << fixed << setprecision(1) << seconds * 1000
+             << setw(10) << setprecision(0) << bytes / max(seconds, 1e-9) / 1e6 << note << endl;
+    };
+    cout << left << setw(28) << "Parser" << setw(12) << "Time (ms)" << setw(10) << "MB/s" << endl;
+    cout << string(60, '-') << endl;
+    report("naive split (plain)", plain.size(), naivePlain, "");
+    report("RFC 4180 tokenizer (plain)", plain.size(), tokenizerPlain, "");
+    report("naive split (quoted)", quoted.size(), naiveQuoted, "  (splits quoted commas wrongly)");
+    report("RFC 4180 tokenizer (quoted)", quoted.size(), tokenizerQuoted, "");
+    if (checksum == 0) cout << endl; // keep the work observable
+
+    filesystem::remove_all(directory);
+    return 0;
+}
+
+// Compare cold-start time of CSV parsing against snapshot loading
+int runStartupBenchmark(size_t rows) {
+    string directory = benchDirectory("startup");
+    string csvPath = directory + "/ledger.csv";
+    string snapshotPath = directory + "/ledger.snap";
+
+    cout << "Generating " << rows << " synthetic transactions..." << endl;
+    if (!writeSyntheticLedger(csvPath, rows)) {
+        cout << "Error: Could not write '" << csvPath << "'" << endl;
+        return 1;
+    }
+    FileStamp csvStamp = fileStamp(csvPath);
+    uint64_t csvSize = csvStamp.size;
+
+    auto start = chrono::steady_clock::now();
+    Ledger fromCsv;
+    loadLedgerFromCsv(csvPath, fromCsv);
+    double csvSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fromCsv.writeSnapshot(snapshotPath, csvStamp);
+
+    start = chrono::steady_clock::now();
+    Ledger fromSnapshot;
+    string error;
+    bool loaded;
+    {
+        MappedFile file(snapshotPath);
+        loaded = fromSnapshot.loadSnapshot(file.view(), csvStamp, error);
+    }
+    double snapshotSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!loaded) {
+        cout << "Error: Snapshot load failed (" << error << ")" << endl;
+        return 1;
+    }
+
+    cout << left << setw(12) << "Format" << setw(14) << "Bytes" << setw(12) << "Load (ms)" << "Rows/sec" << endl;
+    cout << string(50, '-') << endl;
+    cout << left << setw(12) << "CSV" << setw(14) << csvSize << setw(12) << fixed << setprecision(1)
+         << csvSeconds * 1000 << setprecision(0) << rows / max(csvSeconds, 1e-9) << endl;
+    cout << left << setw(12) << "Snapshot" << setw(14) << fileSizeOrZero(snapshotPath) << setw(12)
+         << setprecision(1) << snapshotSeconds * 1000 << setprecision(0) << rows / max(snapshotSeconds, 1e-9) << endl;
+
+    filesystem::remove_all(directory);
+    return 0;
+}
+
+// Compare the aggregation kernels with the previous map-based summary loop
+int runAggregateBenchmark(size_t rows) {
+    string directory = benchDirectory("aggregate");
+    string csvPath = directory + "/aggregate.csv";
+
+    cout << "Generating " << rows << " synthetic transactions..." << endl;
+    Ledger ledger;
+    if (!makeBenchLedger(csvPath, rows, ledger)) return 1;
+    filesystem::remove_all(directory);
+
+    const uint8_t* types = reinterpret_cast<const uint8_t*>(ledger.typeColumn().data());
+    const uint32_t* categoryIds = ledger.categoryColumn().data();
+    const int64_t* amounts = ledger.amountColumn().data();
+    size_t cellCount = ledger.categoryDictionary().size() * 2;
+    uint32_t probeCategory = ledger.categoryDictionary().find("Food");
+
+    auto timeIt = [](int repeats, auto&& body) {
+        double best = 1e9;
+        for (int r = 0; r < repeats; r++) {
+            auto start = chrono::steady_clock::now();
+            body();
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    };
+
+    // The previous summary: row objects, string type compare, two maps keyed by name
+    vector<LegacyTransaction> rowObjects;
+    rowObjects.reserve(ledger.size());
+    for (size_t i = 0; i < ledger.size(); i++) {
+        Transaction row = ledger.row(i);
+        rowObjects.emplace_back(row.dateText(), string(row.description), row.amount, string(row.category),
+                                typeName(row.type));
+    }
+    double mapChecksum = 0.0;
+    double mapSeconds = timeIt(3, [&] {
+        map<string, double> incomeByCategory, expensesByCategory;
+        for (const auto& transaction : rowObjects) {
+            if (transaction.type == "income") {
+                incomeByCategory[transaction.category] += transaction.amount.toDouble();
+            } else {
+                expensesByCategory[transaction.category] += transaction.amount.toDouble();
+            }
+        }
+        for (const auto& entry : expensesByCategory) mapChecksum += entry.second;
+    });
+
+    cout << left << setw(30) << "Kernel" << setw(12) << "Time (ms)" << setw(16) << "Rows/sec" << "Speedup" << endl;
+    cout << string(66, '-') << endl;
+    auto report = [&](const string& name, double seconds) {
+        cout << left << setw(30) << name << setw(12) << fixed << setprecision(2) << seconds * 1000
+             << setw(16) << setprecision(0) << ledger.size() / max(seconds, 1e-9)
+             << setprecision(1) << mapSeconds / max(seconds, 1e-9) << "x" << endl;
+    };
+    report("map loop (category summary)", mapSeconds);
+
+    vector<AggregationKernels> kernels = supportedAggregationKernels();
+    vector<int64_t> referenceSums;
+    AmountStats referenceStats;
+    bool consistent = true;
+    for (const auto& kernel : kernels) {
+        vector<int64_t> sums(cellCount);
+        vector<uint64_t> counts(cellCount);
+        AmountStats income, expenses, filtered;
+        double summary = timeIt(5, [&] {
+            fill(sums.begin(), sums.end(), 0);
+            fill(counts.begin(), counts.end(), 0);
+            groupByCategoryType(types, categoryIds, amounts, ledger.size(), sums.data(), counts.data());
+            income = kernel.filteredStats(types, categoryIds, amounts, ledger.size(), 0, kAnyCategory);
+            expenses = kernel.filteredStats(types, categoryIds, amounts, ledger.size(), 1, kAnyCategory);
+        });
+        double filter = timeIt(5, [&] {
+            filtered = kernel.filteredStats(types, categoryIds, amounts, ledger.size(), 1, probeCategory);
+        });
+
+        string name = kernel.name;
+        report(name + " (category summary)", summary);
+        report(name + " (filtered min/max)", filter);
+
+        if (referenceSums.empty()) {
+            referenceSums = sums;
+            referenceStats = filtered;
+        } else if (sums != referenceSums || filtered.sum != referenceStats.sum ||
+                   filtered.count != referenceStats.count || filtered.minimum != referenceStats.minimum ||
+                   filtered.maximum != referenceStats.maximum) {
+            consistent = false;
+        }
+        if (income.count + expenses.count != ledger.size()) consistent = false;
+    }
+    cout << "Selected kernels: " << aggregationKernels().name << endl;
+    if (!consistent) {
+        cout << "❌ Kernel results differ!" << endl;
+        return 1;
+    }
+    if (mapChecksum < 0) cout << endl; // keep the work observable
+    return 0;
+}
+
+// Measure query engine scaling for 1..N threads
+int runQueryBenchmark(size_t rows) {
+    string directory = benchDirectory("query");
+    string csvPath = directory + "/query.csv";
+
+    cout << "Generating " << rows << " synthetic transactions..." << endl;
+    Ledger ledger;
+    if (!makeBenchLedger(csvPath, rows, ledger)) return 1;
+    filesystem::remove_all(directory);
+
+    GroupQuery byMonth;
+    byMonth.byMonth = true;
+    GroupQuery byCategory;
+    GroupQuery oneMonth;
+    oneMonth.monthKey = monthKeyFromDay(ledger.day(ledger.size() / 2));
+
+    auto bestOf = [](int repeats, QueryEngine& engine, const GroupQuery& query, bool forceScan,
+                     vector<QueryRow>& result) {
+        double best = 1e9;
+        for (int r = 0; r < repeats; r++) {
+            result = engine.groupBy(query, forceScan);
+            best = min(best, engine.lastQuerySeconds());
+        }
+        return best;
+    };
+    auto sameRows = [](const vector<QueryRow>& a, const vector<QueryRow>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].monthKey != b[i].monthKey || a[i].categoryId != b[i].categoryId || a[i].type != b[i].type ||
+                a[i].cell.sum != b[i].cell.sum || a[i].cell.count != b[i].cell.count) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    unsigned maxThreads = max(1u, thread::hardware_concurrency());
+    vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    cout << left << setw(10) << "Threads" << setw(24) << "Month x cat x type (ms)" << setw(10) << "Speedup"
+         << setw(24) << "Category x type (ms)" << "Speedup" << endl;
+    cout << string(76, '-') << endl;
+    vector<QueryRow> monthReference, categoryReference;
+    double monthBaseline = 0.0, categoryBaseline = 0.0;
+    bool consistent = true;
+    for (unsigned threads : threadCounts) {
+        QueryEngine engine(ledger, threads);
+        vector<QueryRow> monthRows, categoryRows;
+        double monthSeconds = bestOf(5, engine, byMonth, true, monthRows);
+        double categorySeconds = bestOf(5, engine, byCategory, true, categoryRows);
+        if (threads == 1) {
+            monthReference = monthRows;
+            categoryReference = categoryRows;
+            monthBaseline = monthSeconds;
+            categoryBaseline = categorySeconds;
+        } else if (!sameRows(monthRows, monthReference) || !sameRows(categoryRows, categoryReference)) {
+            consistent = false;
+        }
+        cout << left << setw(10) << threads << setw(24) << fixed << setprecision(2) << monthSeconds * 1000
+             << setw(10) << setprecision(2) << monthBaseline / max(monthSeconds, 1e-9)
+             << setw(24) << categorySeconds * 1000 << categoryBaseline / max(categorySeconds, 1e-9) << endl;
+    }
+
+    QueryEngine engine(ledger);
+    vector<QueryRow> scanned, materialized;
+    double scanSeconds = bestOf(5, engine, oneMonth, true, scanned);
+    double aggregateSeconds = bestOf(5, engine, oneMonth, false, materialized);
+    if (!sameRows(scanned, materialized)) consistent = false;
+    cout << "\nSingle month by category: scan " << fixed << setprecision(2) << scanSeconds * 1000
+         << " ms, materialized totals " << setprecision(4) << aggregateSeconds * 1000 << " ms" << endl;
+
+    if (!consistent) {
+        cout << "❌ Query results differ between runs!" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Compare table rendering with the previous setw/endl console loop
+int runRenderBenchmark(size_t rows) {
+    string directory = benchDirectory("render");
+    string csvPath = directory + "/render.csv";
+    string outputPath = directory + "/render.txt";
+
+    cout << "Generating " << rows << " synthetic transactions..." << endl;
+    Ledger ledger;
+    if (!makeBenchLedger(csvPath, rows, ledger)) return 1;
+
+    // The previous displayTransactions loop: manipulators and endl on every row
+    auto start = chrono::steady_clock::now();
+    {
+        ofstream out(outputPath);
+        for (size_t i = 0; i < ledger.size(); i++) {
+            out << left << setw(20) << ledger.dateText(i).substr(0, 19)
+                << setw(30) << ledger.description(i).substr(0, 29)
+                << "$" << right << setw(10) << fixed << setprecision(2) << ledger.amount(i)
+                << left << setw(15) << ledger.category(i).substr(0, 14)
+                << setw(10) << typeName(ledger.type(i)) << endl;
+        }
+    }
+    double streamSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    uint64_t streamBytes = fileSizeOrZero(outputPath);
+
+    start = chrono::steady_clock::now();
+    uint64_t rendererBytes;
+    {
+        ReportRenderer renderer(outputPath);
+        renderTransactionRows(renderer, ledger, 0, ledger.size());
+        renderer.flush();
+        rendererBytes = renderer.bytesRendered();
+    }
+    double rendererSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << left << setw(24) << "Renderer" << setw(12) << "Time (ms)" << setw(14) << "Rows/sec" << "MB/s" << endl;
+    cout << string(58, '-') << endl;
+    auto report = [&](const char* name, double seconds, uint64_t bytes) {
+        cout << left << setw(24) << name << setw(12) << fixed << setprecision(1) << seconds * 1000
+             << setw(14) << setprecision(0) << rows / max(seconds, 1e-9)
+             << setprecision(1) << bytes / max(seconds, 1e-9) / 1e6 << endl;
+    };
+    report("setw + endl per row", streamSeconds, streamBytes);
+    report("buffered renderer", rendererSeconds, rendererBytes);
+    if (streamBytes != rendererBytes) {
+        cout << "❌ Output sizes differ (" << streamBytes << " vs " << rendererBytes << " bytes)" << endl;
+    }
+
+    filesystem::remove_all(directory);
+    return streamBytes == rendererBytes ? 0 : 1;
+}
+
+// Measure description index build time, size and query latency on a
+// synthetic ledger with a realistic number of distinct merchant names
+int runSearchBenchmark(size_t rows) {
+    static const char* const words[] = {"Grocery", "Store", "Coffee", "Shop", "Online", "Order", "Monthly",
+                                        "Bill", "Restaurant", "Dinner", "Gas", "Station", "Pharmacy", "Ticket"};
+    static const char* const syllables[] = {"ka", "lo", "mi", "ra", "ne", "to", "su", "vi",
+                                            "da", "pe", "zo", "ba", "chi", "fu", "ge", "ho"};
+    const size_t merchantCount = 20000;
+
+    cout << "Generating " << rows << " synthetic transactions..." << endl;
+    mt19937 rng(42);
+    vector<string> merchants(merchantCount);
+    for (string& merchant : merchants) {
+        size_t length = 3 + rng() % 2;
+        for (size_t i = 0; i < length; i++) merchant += syllables[rng() % 16];
+        merchant[0] = static_cast<char>(merchant[0] - 'a' + 'A');
+    }
+    Ledger ledger;
+    ledger.reserve(rows);
+    string description;
+    for (size_t i = 0; i < rows; i++) {
+        description.assign(words[rng() % 14]).append(1, ' ').append(merchants[rng() % merchantCount]);
+        description.append(" #").append(to_string(rng() % 1000));
+        ledger.append("2024-01-15", description, Money::fromUnits(100 + rng() % 10000), "Food",
+                      TransactionType::Expense);
+    }
+
+    auto start = chrono::steady_clock::now();
+    ledger.enableDescriptionIndex();
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const DescriptionIndex& index = ledger.descriptions();
+    cout << "Index build: " << fixed << setprecision(1) << buildSeconds * 1000 << " ms ("
+         << setprecision(0) << rows / max(buildSeconds, 1e-9) << " rows/sec), " << index.termCount()
+         << " distinct words" << endl;
+    cout << "Index memory: " << setprecision(1) << index.bytesUsed() / 1024.0 / 1024.0 << " MB ("
+         << index.bytesUsed() / static_cast<double>(max<size_t>(rows, 1)) << " bytes/row; ledger itself "
+         << ledger.bytesPerRow() << " bytes/row)" << endl;
+
+    // Queries built from merchant names so that most of them match something
+    auto lowered = [](string text) {
+        for (char& c : text) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return text;
+    };
+    struct QueryKind {
+        const char* name;
+        function<string(const string&)> make;
+    };
+    vector<QueryKind> kinds = {
+        {"whole word", [&](const string& m) { return lowered(m); }},
+        {"prefix (3 chars)", [&](const string& m) { return lowered(m.substr(0, 3)); }},
+        {"substring (*4 chars)", [&](const string& m) { return "*" + lowered(m.substr(2, 4)); }},
+        {"two words", [&](const string& m) { return string(words[m.size() % 14]) + " " + lowered(m.substr(0, 4)); }},
+    };
+
+    // Brute force: every description word checked against every query word
+    auto scan = [&](const string& query) {
+        vector<string> wanted;
+        vector<bool> inside;
+        string buffer;
+        stringstream tokens(query);
+        string token;
+        while (tokens >> token) {
+            bool substring = token[0] == '*';
+            DescriptionIndex::forEachWord(token, buffer, [&](const string& word) {
+                wanted.push_back(word);
+                inside.push_back(substring);
+            });
+        }
+        vector<uint32_t> matches;
+        for (size_t row = 0; row < ledger.size(); row++) {
+            vector<bool> found(wanted.size(), false);
+            DescriptionIndex::forEachWord(ledger.description(row), buffer, [&](const string& word) {
+                for (size_t w = 0; w < wanted.size(); w++) {
+                    if (inside[w] ? word.find(wanted[w]) != string::npos : word.compare(0, wanted[w].size(), wanted[w]) == 0) {
+                        found[w] = true;
+                    }
+                }
+            });
+            if (!wanted.empty() && all_of(found.begin(), found.end(), [](bool f) { return f; })) {
+                matches.push_back(static_cast<uint32_t>(row));
+            }
+        }
+        return matches;
+    };
+
+    cout << left << setw(24) << "Query" << setw(14) << "Avg matches" << setw(12) << "p50 (us)"
+         << setw(12) << "p99 (us)" << "Scan p50 (us)" << endl;
+    cout << string(74, '-') << endl;
+    bool consistent = true;
+    for (const auto& kind : kinds) {
+        vector<double> latencies, scanLatencies;
+        size_t totalMatches = 0;
+        for (size_t q = 0; q < 1000; q++) {
+            string query = kind.make(merchants[rng() % merchantCount]);
+            start = chrono::steady_clock::now();
+            vector<uint32_t> found = index.search(query);
+            latencies.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6);
+            totalMatches += found.size();
+
+            if (q < 3) { // a few full scans, both as a baseline and to check the index
+                start = chrono::steady_clock::now();
+                vector<uint32_t> expected = scan(query);
+                scanLatencies.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6);
+                if (expected != found) {
+                    cout << "❌ Index and scan disagree for '" << query << "' (" << found.size() << " vs "
+                         << expected.size() << " rows)" << endl;
+                    consistent = false;
+                }
+            }
+        }
+        cout << left << setw(24) << kind.name << setw(14) << setprecision(1) << totalMatches / 1000.0
+             << setw(12) << percentile(latencies, 0.50) << setw(12) << percentile(latencies, 0.99)
+             << setprecision(0) << percentile(scanLatencies, 0.50) << endl;
+    }
+    return consistent ? 0 : 1;
+}
+
+// Latency of date/amount/category queries through the date-ordered index
+// and zone maps, compared with a full scan of the columns
+int runRangeBenchmark(size_t rows) {
+    string directory = benchDirectory("range");
+    string csvPath = directory + "/range.csv";
+
+    cout << "Generating " << rows << " synthetic transactions..." << endl;
+    Ledger ledger;
+    if (!makeBenchLedger(csvPath, rows, ledger)) return 1;
+    filesystem::remove_all(directory);
+
+    auto start = chrono::steady_clock::now();
+    ledger.rebuildIndexes();
+    cout << "Rebuilding indexes, day order and zone maps included: " << fixed << setprecision(1)
+         << chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1000 << " ms" << endl;
+
+    const int32_t firstDay = daysFromCivil(2022, 1, 1);
+    const int32_t spanDays = 3 * 365;
+    const uint32_t food = ledger.categoryDictionary().find("Food");
+    mt19937 rng(7);
+    struct QueryKind {
+        const char* name;
+        function<TransactionQuery()> make;
+    };
+    auto range = [&](int32_t length) {
+        TransactionQuery query;
+        query.firstDay = firstDay + static_cast<int32_t>(rng() % static_cast<uint32_t>(spanDays - length + 1));
+        query.lastDay = query.firstDay + length - 1;
+        return query;
+    };
+    vector<QueryKind> kinds = {
+        {"1 day", [&] { return range(1); }},
+        {"1 week", [&] { return range(7); }},
+        {"1 month", [&] { return range(30); }},
+        {"1 month, Food", [&] {
+             TransactionQuery query = range(30);
+             query.categoryIds.push_back(food);
+             return query;
+         }},
+        {"1 year, income", [&] {
+             TransactionQuery query = range(365);
+             query.anyType = false;
+             query.type = TransactionType::Income;
+             return query;
+         }},
+        {"all, amount >= 4900", [&] {
+             TransactionQuery query;
+             query.minAmount = Money::fromUnits(490000);
+             return query;
+         }},
+        {"all, expenses", [&] {
+             TransactionQuery query;
+             query.anyType = false;
+             return query;
+         }},
+    };
+
+    // The same filter applied to every row in storage order
+    auto scan = [&](const TransactionQuery& query) {
+        vector<uint32_t> matches;
+        bool anyCategory = query.categoryIds.empty();
+        for (size_t row = 0; row < ledger.size(); row++) {
+            int32_t day = ledger.day(row);
+            if (query.hasDateRange() && (day == kUnknownDay || day < query.firstDay || day > query.lastDay)) continue;
+            if (!query.anyType && ledger.type(row) != query.type) continue;
+            if (ledger.amount(row) < query.minAmount || ledger.amount(row) > query.maxAmount) continue;
+            if (!anyCategory && find(query.categoryIds.begin(), query.categoryIds.end(), ledger.categoryId(row)) ==
+                                    query.categoryIds.end()) {
+                continue;
+            }
+            matches.push_back(static_cast<uint32_t>(row));
+        }
+        return matches;
+    };
+
+    cout << left << setw(22) << "Query" << setw(13) << "Avg matches" << setw(12) << "Examined"
+         << setw(11) << "p50 (us)" << setw(11) << "p99 (us)" << "Scan p50 (us)" << endl;
+    cout << string(83, '-') << endl;
+    bool consistent = true;
+    for (const auto& kind : kinds) {
+        const size_t repeats = 200;
+        vector<double> latencies, scanLatencies;
+        size_t totalMatches = 0, totalExamined = 0;
+        for (size_t q = 0; q < repeats; q++) {
+            TransactionQuery query = kind.make();
+            SelectStats stats;
+            start = chrono::steady_clock::now();
+            vector<uint32_t> found = ledger.select(query, &stats);
+            latencies.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6);
+            totalMatches += found.size();
+            totalExamined += stats.rowsExamined;
+
+            if (q < 3) { // a few full scans, both as a baseline and to check the index
+                start = chrono::steady_clock::now();
+                vector<uint32_t> expected = scan(query);
+                scanLatencies.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e6);
+                sort(found.begin(), found.end());
+                if (expected != found) {
+                    cout << "❌ Index and scan disagree for '" << kind.name << "' (" << found.size() << " vs "
+                         << expected.size() << " rows)" << endl;
+                    consistent = false;
+                }
+            }
+        }
+        cout << left << setw(22) << kind.name << setw(13) << setprecision(0)
+             << static_cast<double>(totalMatches) / repeats << setw(12)
+             << static_cast<double>(totalExamined) / repeats << setprecision(1) << setw(11)
+             << percentile(latencies, 0.50) << setw(11) << percentile(latencies, 0.99)
+             << setprecision(0) << percentile(scanLatencies, 0.50) << endl;
+    }
+    return consistent ? 0 : 1;
+}
+
+// Insert latency of the budget rule engine for growing rule counts,
+// compared with the previous linear find_if over the budget list
+int runBudgetBenchmark(size_t inserts) {
+    const int32_t firstDay = daysFromCivil(2022, 1, 1);
+    const int32_t spanDays = 3 * 365;
+
+    cout << "Replaying " << inserts << " expenses against each rule set..." << endl;
+    cout << left << setw(10) << "Rules" << setw(12) << "Alerts" << setw(12) << "p50 (ns)" << setw(12) << "p99 (ns)"
+         << setw(16) << "Inserts/sec" << "find_if p50 (ns)" << endl;
+    cout << string(78, '-') << endl;
+    bool consistent = true;
+    for (size_t ruleCount : {0, 10, 1000, 10000}) {
+        // Half the categories get a monthly and a weekly rule; one global monthly rule on top
+        size_t ruled = ruleCount / 2;
+        vector<string> categories;
+        for (size_t i = 0; i < ruled + 100; i++) categories.push_back("Category " + to_string(i));
+        BudgetRuleEngine engine;
+        vector<pair<string, Money>> oldLimits;
+        Money previous;
+        for (size_t i = 0; i < ruled; i++) {
+            engine.set(categories[i], BudgetPeriod::Monthly, Money::fromUnits(50000), defaultBudgetThresholds(), previous);
+            engine.set(categories[i], BudgetPeriod::Weekly, Money::fromUnits(15000), defaultBudgetThresholds(), previous);
+            oldLimits.emplace_back(categories[i], Money::fromUnits(50000));
+        }
+        if (ruleCount > 0) {
+            engine.set("", BudgetPeriod::Monthly, Money::fromUnits(5000000), defaultBudgetThresholds(), previous);
+        }
+
+        mt19937 rng(11);
+        vector<uint32_t> categoryOf(inserts);
+        vector<int32_t> dayOf(inserts);
+        vector<Money> amountOf(inserts);
+        for (size_t i = 0; i < inserts; i++) {
+            categoryOf[i] = static_cast<uint32_t>(rng() % categories.size());
+            dayOf[i] = firstDay + static_cast<int32_t>(i * spanDays / max<size_t>(inserts, 1));
+            amountOf[i] = Money::fromUnits(100 + rng() % 20000);
+        }
+
+        vector<BudgetAlert> alerts;
+        vector<double> latencies(inserts);
+        auto total = chrono::steady_clock::now();
+        for (size_t i = 0; i < inserts; i++) {
+            auto start = chrono::steady_clock::now();
+            engine.observe(categories[categoryOf[i]], dayOf[i], amountOf[i], &alerts);
+            latencies[i] = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e9;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - total).count();
+
+        // The previous per-insert lookup: a linear search of the budget list by name
+        size_t oldSamples = min<size_t>(inserts, 20000);
+        vector<double> oldLatencies(oldSamples);
+        volatile size_t found = 0; // keeps the search from being optimized away
+        for (size_t i = 0; i < oldSamples; i++) {
+            const string& category = categories[categoryOf[i]];
+            auto start = chrono::steady_clock::now();
+            auto it = find_if(oldLimits.begin(), oldLimits.end(),
+                              [&](const pair<string, Money>& limit) { return limit.first == category; });
+            found = found + (it != oldLimits.end());
+            oldLatencies[i] = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e9;
+        }
+
+        // Check a sample of running totals against a recomputation of their latest period
+        for (size_t r = 0; r < engine.size(); r += max<size_t>(1, engine.size() / 50)) {
+            const BudgetRule& rule = engine.all()[r];
+            const BudgetProgress& progress = engine.progress(r);
+            Money expected;
+            for (size_t i = 0; i < inserts; i++) {
+                if ((rule.isGlobal() || categories[categoryOf[i]] == rule.category) &&
+                    budgetPeriodKey(rule.period, dayOf[i]) == progress.periodKey) {
+                    expected += amountOf[i];
+                }
+            }
+            if (expected != progress.spent) {
+                cout << "❌ Running total mismatch for " << rule.label() << " (" << budgetPeriodName(rule.period)
+                     << "): " << progress.spent << " vs " << expected << endl;
+                consistent = false;
+            }
+        }
+
+        cout << left << setw(10) << engine.size() << setw(12) << alerts.size() << setw(12) << fixed
+             << setprecision(0) << percentile(latencies, 0.50) << setw(12) << percentile(latencies, 0.99)
+             << setw(16) << inserts / max(seconds, 1e-9) << percentile(oldLatencies, 0.50) << endl;
+    }
+    cout << "(per-insert times include ~20-30 ns of clock overhead)" << endl;
+    return consistent ? 0 : 1;
+}
+
+// Time-series analytics over ten years of history: the one-pass build,
+// appends, and forecast/series latency against rescanning the ledger
+int runTrendsBenchmark(size_t rows) {
+    string directory = benchDirectory("trends");
+    string csvPath = directory + "/trends.csv";
+    SyntheticLedgerOptions options;
+    options.rows = rows;
+    options.categories = 20;
+    options.days = 3650;
+    Ledger ledger;
+    cout << "Generating " << rows << " synthetic transactions over " << options.days << " days..." << endl;
+    if (!makeBenchLedger(csvPath, options, ledger)) return 1;
+    filesystem::remove_all(directory);
+    const int32_t day = options.firstDay + options.days - 1;
+    const uint32_t categories = static_cast<uint32_t>(ledger.categoryDictionary().size());
+
+    // Mean time of body in microseconds over enough calls to fill about 50 ms
+    auto micros = [](auto&& body) {
+        size_t calls = 0;
+        auto start = chrono::steady_clock::now();
+        double elapsed = 0.0;
+        do {
+            body();
+            calls++;
+            elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        } while (elapsed < 0.05);
+        return elapsed / calls * 1e6;
+    };
+
+    SpendingTrends trends;
+    double build = micros([&] { trends.rebuild(ledger); });
+
+    // What answering the forecasts costs without the series: one scan of the ledger
+    volatile int64_t sink = 0;
+    double scan = micros([&] {
+        vector<int64_t> sums(categories * 4, 0);
+        int32_t monthFirst, monthLast;
+        seriesBucketDays(SeriesBucket::Monthly, day, monthFirst, monthLast);
+        for (size_t row = 0; row < ledger.size(); row++) {
+            int32_t rowDay = ledger.day(row);
+            if (ledger.type(row) != TransactionType::Expense || rowDay > day || rowDay < day - 59) continue;
+            int64_t* cell = &sums[ledger.categoryId(row) * 4];
+            int64_t units = ledger.amount(row).toUnits();
+            if (rowDay >= monthFirst) cell[0] += units;
+            if (rowDay > day - 7) cell[1] += units;
+            if (rowDay > day - 30) cell[2] += units;
+            else cell[3] += units;
+        }
+        sink = sink + sums[0];
+    });
+    double forecasts = micros([&] {
+        for (uint32_t id = 0; id < categories; id++) sink = sink + trends.forecast(id, day).projectedMonthEnd.toUnits();
+        sink = sink + trends.forecast(kAnyCategory, day).projectedMonthEnd.toUnits();
+    });
+    struct SeriesCase {
+        const char* name;
+        SeriesBucket bucket;
+        size_t periods;
+        size_t window;
+    };
+    const SeriesCase seriesCases[] = {{"365 days, 7-day average", SeriesBucket::Daily, 365, 7},
+                                      {"520 weeks, 4-week average", SeriesBucket::Weekly, 520, 4},
+                                      {"120 months, 3-month average", SeriesBucket::Monthly, 120, 3}};
+
+    // Grow a second copy one expense at a time, as appends would
+    SpendingTrends incremental;
+    incremental.rebuild(Ledger());
+    size_t appends = 0;
+    auto start = chrono::steady_clock::now();
+    for (size_t row = 0; row < ledger.size(); row++) {
+        if (ledger.type(row) != TransactionType::Expense) continue;
+        incremental.observe(ledger.categoryId(row), ledger.day(row), ledger.amount(row));
+        appends++;
+    }
+    double observe = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / max<size_t>(appends, 1);
+
+    cout << left << setw(34) << "Operation" << "Time" << endl;
+    cout << string(56, '-') << endl;
+    cout << left << setw(34) << "Build from ledger (one pass)" << fixed << setprecision(1) << build / 1000
+         << " ms (" << setprecision(0) << rows / (build / 1e6) << " rows/sec)" << endl;
+    cout << left << setw(34) << "Append one expense" << setprecision(1) << observe << " ns" << endl;
+    cout << left << setw(34) << ("Forecast " + to_string(categories) + " categories + total") << setprecision(1)
+         << forecasts << " us (ledger scan: " << scan / 1000 << " ms)" << endl;
+    for (const SeriesCase& test : seriesCases) {
+        double seriesMicros = micros([&] {
+            sink = sink + trends.series(kAnyCategory, test.bucket, day, test.periods, test.window).size();
+        });
+        cout << left << setw(34) << test.name << setprecision(1) << seriesMicros << " us" << endl;
+    }
+    cout << "Series memory: " << setprecision(1) << trends.bytesUsed() / 1024.0 << " KB for " << categories
+         << " categories" << endl;
+
+    // The incrementally grown series must match the one-pass build
+    bool consistent = true;
+    for (uint32_t id = 0; id < categories; id++) {
+        for (int32_t first = options.firstDay; first <= day; first += 97) {
+            consistent = consistent && incremental.spent(id, first, first + 400) == trends.spent(id, first, first + 400);
+        }
+    }
+    if (!consistent) {
+        cout << "❌ Incremental series do not match the rebuilt ones!" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Categorize bank-style descriptions against 10, 1k and 10k rules, and
+// compare (for speed and results) with trying every rule in turn
+int runCategorizeBenchmark(size_t rows) {
+    cout << "Categorizing " << rows << " descriptions..." << endl;
+    cout << left << setw(8) << "Rules" << setw(10) << "States" << setw(12) << "Memory" << setw(14) << "Compile (ms)" << setw(14)
+         << "Rows/sec" << setw(10) << "Matched" << "Rule-by-rule rows/sec" << endl;
+    cout << string(92, '-') << endl;
+    bool consistent = true;
+    for (size_t ruleCount : {10, 1000, 10000}) {
+        // Merchants with a rule each, and as many again without one
+        mt19937 rng(5);
+        auto word = [&](size_t length) {
+            string text;
+            for (size_t i = 0; i < length; i++) text.push_back(static_cast<char>('A' + rng() % 26));
+            return text;
+        };
+        size_t merchants = ruleCount * 2;
+        vector<string> merchant(merchants);
+        for (auto& name : merchant) name = word(5 + rng() % 6);
+
+        // Kinds by share: 45% substring, 30% prefix, 20% exact, 5% regex
+        auto kindOf = [](size_t rule) {
+            size_t slot = rule % 20;
+            return slot < 9 ? MatchKind::Substring : slot < 15 ? MatchKind::Prefix
+                 : slot < 19 ? MatchKind::Exact : MatchKind::Regex;
+        };
+        CategoryRuleEngine engine;
+        string error;
+        for (size_t i = 0; i < ruleCount; i++) {
+            MatchKind kind = kindOf(i);
+            string pattern = kind == MatchKind::Regex ? "^ach " + merchant[i] + " [0-9]+$" : merchant[i];
+            engine.add(kind, pattern, "Category " + to_string(i % 50), error);
+        }
+
+        // Descriptions in the shape each kind of rule is written for
+        vector<string> descriptions(rows);
+        for (size_t i = 0; i < rows; i++) {
+            size_t m = rng() % merchants;
+            MatchKind shape = m < ruleCount ? kindOf(m) : kindOf(rng() % 20);
+            string digits = to_string(1000 + rng() % 9000);
+            switch (shape) {
+                case MatchKind::Substring: descriptions[i] = "POS PURCHASE " + merchant[m] + " SEATTLE WA #" + digits; break;
+                case MatchKind::Prefix: descriptions[i] = merchant[m] + "*" + word(5); break;
+                case MatchKind::Exact: descriptions[i] = merchant[m]; break;
+                default: descriptions[i] = "ACH " + merchant[m] + " " + digits; break;
+            }
+        }
+        vector<RawRow> batch(rows);
+        for (size_t i = 0; i < rows; i++) batch[i].description = descriptions[i];
+
+        auto start = chrono::steady_clock::now();
+        size_t states = engine.stateCount();  // compiles
+        double compileSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        size_t matched = engine.categorize(batch, true);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        // Every rule in turn, on a sample, must give the same categories
+        vector<string> patterns;
+        vector<regex> expressions(ruleCount);
+        for (size_t i = 0; i < ruleCount; i++) {
+            const CategoryRule& rule = engine.all()[i];
+            string lowered = rule.pattern;
+            transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+            patterns.push_back(lowered);
+            if (rule.kind == MatchKind::Regex) expressions[i] = regex(rule.pattern, regex::ECMAScript | regex::icase);
+        }
+        size_t sample = min(rows, max<size_t>(100, 2000000 / ruleCount));
+        string text;
+        start = chrono::steady_clock::now();
+        for (size_t row = 0; row < sample; row++) {
+            text = descriptions[row];
+            transform(text.begin(), text.end(), text.begin(), ::tolower);
+            const string* category = nullptr;
+            for (size_t i = 0; i < ruleCount && !category; i++) {
+                const string& pattern = patterns[i];
+                bool hit = false;
+                switch (engine.all()[i].kind) {
+                    case MatchKind::Exact: hit = text == pattern; break;
+                    case MatchKind::Prefix: hit = text.compare(0, pattern.size(), pattern) == 0; break;
+                    case MatchKind::Substring: hit = text.find(pattern) != string::npos; break;
+                    default: hit = regex_search(text, expressions[i]); break;
+                }
+                if (hit) category = &engine.all()[i].category;
+            }
+            string_view expected = category ? string_view(*category) : string_view();
+            if (batch[row].category != expected) consistent = false;
+        }
+        double naiveSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << left << setw(8) << ruleCount << setw(10) << states << setw(12)
+             << (to_string(engine.bytesUsed() / 1024) + " KB") << fixed << setprecision(1) << setw(14)
+             << compileSeconds * 1000 << setprecision(0) << setw(14) << rows / max(seconds, 1e-9) << setw(10)
+             << (to_string(matched * 100 / max<size_t>(rows, 1)) + "%") << sample / max(naiveSeconds, 1e-9) << endl;
+    }
+    if (!consistent) {
+        cout << "❌ The compiled rules disagree with trying every rule in turn!" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// How long the menu waits while a large ledger is saved: in the foreground
+// for the whole save, with background I/O only for the ledger copy, while
+// transactions added during the save have their journal writes queued
+int runAutosaveBenchmark(size_t rows) {
+    string directory = benchDirectory("autosave");
+    cout << "Generating " << rows << " synthetic transactions..." << endl;
+    if (!writeSyntheticLedger(directory + "/financial_data.csv", rows)) {
+        cout << "Error: Could not write '" << directory << "/financial_data.csv'" << endl;
+        return 1;
+    }
+    ostringstream quiet;
+    ExpenseTracker tracker(quiet, directory);
+    double megabytes = fileSizeOrZero(directory + "/financial_data.csv") / 1e6;
+
+    auto elapsedMs = [](chrono::steady_clock::time_point since) {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+    };
+    auto timedAdd = [&] {
+        auto start = chrono::steady_clock::now();
+        tracker.recordTransaction("2024-05-01", "Coffee", Money::fromUnits(450), "Food", TransactionType::Expense);
+        return elapsedMs(start);
+    };
+
+    // Foreground: each add waits for its journal sync, a save for everything
+    vector<double> foregroundAdds;
+    for (int i = 0; i < 20; i++) foregroundAdds.push_back(timedAdd());
+    auto start = chrono::steady_clock::now();
+    tracker.compactJournal();
+    double foregroundSave = elapsedMs(start);
+
+    // Background: adds only queue their journal write, a save waits for the copy
+    tracker.startBackgroundIo(chrono::seconds(3600));
+    vector<double> queuedAdds;
+    for (int i = 0; i < 20; i++) queuedAdds.push_back(timedAdd());
+    tracker.waitForBackgroundIo();
+
+    start = chrono::steady_clock::now();
+    double copyMs = tracker.queueAutosave() * 1000;
+    vector<double> duringSave;
+    while (elapsedMs(start) < foregroundSave) {
+        duringSave.push_back(timedAdd());
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    tracker.waitForBackgroundIo();
+    double backgroundSave = elapsedMs(start);
+    tracker.finishBackgroundIo();
+    filesystem::remove_all(directory);
+
+    cout << "Ledger: " << rows << " rows, " << fixed << setprecision(1) << megabytes << " MB of CSV" << endl;
+    cout << "\nForeground (menu waits for the disk):" << endl;
+    cout << "  save of the whole ledger:      " << setprecision(1) << foregroundSave << " ms" << endl;
+    cout << "  add, p50 / max:                " << setprecision(3) << percentile(foregroundAdds, 0.5) << " / "
+         << percentile(foregroundAdds, 1.0) << " ms (journal sync)" << endl;
+    cout << "  add arriving during a save:    up to " << setprecision(1) << foregroundSave << " ms" << endl;
+    cout << "\nBackground I/O thread:" << endl;
+    cout << "  menu wait for the ledger copy: " << setprecision(1) << copyMs << " ms" << endl;
+    cout << "  save finished after:           " << backgroundSave << " ms (with the adds below queued behind it)"
+         << endl;
+    cout << "  add, p50 / max:                " << setprecision(3) << percentile(queuedAdds, 0.5) << " / "
+         << percentile(queuedAdds, 1.0) << " ms (journal write queued)" << endl;
+    cout << "  " << duringSave.size() << " adds during the save, p50 / p99 / max: " << percentile(duringSave, 0.5)
+         << " / " << percentile(duringSave, 0.99) << " / " << percentile(duringSave, 1.0) << " ms" << endl;
+    return 0;
+}
+
+// Import throughput with and without duplicate detection: new rows into a
+// ledger of the same size, and a re-import of rows it already holds
+int runDedupBenchmark(size_t rows) {
+    string directory = benchDirectory("dedup");
+    string existingPath = directory + "/existing.csv";
+    string freshPath = directory + "/fresh.csv";
+
+    cout << "Generating 2 x " << rows << " synthetic transactions..." << endl;
+    // The new rows follow the existing ones in time, so none of them is a duplicate
+    SyntheticLedgerOptions later;
+    later.rows = rows;
+    later.firstDay += later.days;
+    if (!writeSyntheticLedger(freshPath, later)) {
+        cout << "Error: Could not write '" << freshPath << "'" << endl;
+        return 1;
+    }
+    Ledger base;
+    if (!makeBenchLedger(existingPath, rows, base)) return 1;
+
+    // The import path of ExpenseTracker::appendRows, without the journal
+    auto import = [](Ledger& ledger, const string& path, bool skipDuplicates, size_t& added) {
+        MappedFile file(path);
+        IngestResult result = ingestCsv(file.view(), IngestOptions(true, true));
+        vector<uint64_t> fingerprints;
+        vector<uint8_t> duplicate;
+        size_t skipped = skipDuplicates ? ledger.findDuplicates(result.rows, fingerprints, duplicate) : 0;
+        ledger.reserve(ledger.size() + result.rows.size() - skipped);
+        Ledger::BulkAppend bulk(ledger);
+        for (size_t i = 0; i < result.rows.size(); i++) {
+            if (skipped > 0 && duplicate[i]) continue;
+            const RawRow& row = result.rows[i];
+            ledger.append(row.date, row.description, row.amount, row.category, parseType(row.type),
+                          skipDuplicates ? fingerprints[i] : 0);
+        }
+        added = result.rows.size() - skipped;
+    };
+
+    // Paid once per ledger on its first import, then kept and saved with it
+    auto buildStart = chrono::steady_clock::now();
+    base.buildFingerprints();
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - buildStart).count();
+
+    cout << left << setw(34) << "Import" << setw(12) << "Time (ms)" << setw(14) << "Rows/sec" << "Added" << endl;
+    cout << string(70, '-') << endl;
+    double freshOff = 0.0;
+    bool correct = true;
+    struct Case {
+        const char* name;
+        const string* path;
+        bool skipDuplicates;
+        size_t expectedAdded;
+    };
+    const Case cases[] = {{"new rows, dedup off", &freshPath, false, rows},
+                          {"new rows, dedup on", &freshPath, true, rows},
+                          {"re-import, dedup off", &existingPath, false, rows},
+                          {"re-import, dedup on", &existingPath, true, 0}};
+    for (const Case& test : cases) {
+        double best = 1e9;
+        size_t added = 0;
+        for (int repeat = 0; repeat < 3; repeat++) {
+            Ledger ledger = base;
+            auto start = chrono::steady_clock::now();
+            import(ledger, *test.path, test.skipDuplicates, added);
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        if (test.path == &freshPath && !test.skipDuplicates) freshOff = best;
+        if (added != test.expectedAdded) correct = false;
+        cout << left << setw(34) << test.name << setw(12) << fixed << setprecision(1) << best * 1000
+             << setw(14) << setprecision(0) << rows / max(best, 1e-9) << added;
+        if (test.path == &freshPath && test.skipDuplicates) {
+            cout << "  (" << showpos << setprecision(1) << (best / max(freshOff, 1e-9) - 1) * 100 << noshowpos
+                 << "% vs off)";
+        }
+        cout << endl;
+    }
+    cout << "Fingerprint table: " << fixed << setprecision(1)
+         << static_cast<double>(base.fingerprintSet().bytesUsed()) / max<size_t>(base.size(), 1) << " bytes/row ("
+         << base.fingerprintSet().size() << " distinct of " << base.size() << " rows)" << endl;
+    cout << "Built from " << base.size() << " loaded rows in " << setprecision(1) << buildSeconds * 1000 << " ms"
+         << endl;
+    filesystem::remove_all(directory);
+    if (!correct) {
+        cout << "❌ Unexpected number of added rows!" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Spread the same number of rows over 1..100 account shards and time
+// loading them one at a time and in parallel, and a merged report
+int runShardBenchmark(size_t rows) {
+    string root = (filesystem::temp_directory_path() / "expense_tracker_shards").string();
+    const size_t shardCounts[] = {1, 2, 5, 10, 20, 50, 100};
+    unsigned threads = max(1u, thread::hardware_concurrency());
+
+    cout << "Spreading " << rows << " synthetic transactions over 1 to 100 accounts (" << threads << " threads)"
+         << endl;
+    cout << left << setw(8) << "Shards" << setw(14) << "CSV par (ms)" << setw(14) << "Snap seq (ms)" << setw(14)
+         << "Snap par (ms)" << setw(10) << "Speedup" << setw(14) << "Report (ms)" << "Rows" << endl;
+    cout << string(80, '-') << endl;
+    for (size_t shards : shardCounts) {
+        filesystem::remove_all(root);
+        vector<string> names;
+        for (size_t i = 0; i < shards; i++) {
+            char name[32];
+            snprintf(name, sizeof(name), "shard%03zu", i);
+            names.push_back(name);
+            SyntheticLedgerOptions options;
+            options.rows = rows / shards + (i < rows % shards ? 1 : 0);
+            options.seed = static_cast<unsigned>(42 + i);
+            filesystem::create_directories(accountDirectory(name, root));
+            if (!writeSyntheticLedger(accountDirectory(name, root) + "/financial_data.csv", options)) {
+                cout << "Error: Could not write '" << root << "'" << endl;
+                return 1;
+            }
+        }
+
+        // The first load parses the CSV files and leaves a snapshot next to each
+        auto loadSeconds = [&](unsigned loadThreads) {
+            LedgerSet accounts(loadThreads);
+            accounts.open(names, root);
+            return accounts.loadSeconds();
+        };
+        double csvParallel = loadSeconds(threads);
+        double sequential = 1e9, parallel = 1e9;
+        for (int repeat = 0; repeat < 3; repeat++) {
+            sequential = min(sequential, loadSeconds(1));
+            parallel = min(parallel, loadSeconds(threads));
+        }
+
+        LedgerSet accounts(threads);
+        accounts.open(names, root);
+        GroupQuery query;
+        query.byMonth = true;
+        double report = 1e9;
+        size_t groups = 0;
+        for (int repeat = 0; repeat < 5; repeat++) {
+            auto start = chrono::steady_clock::now();
+            groups = accounts.groupBy(query).size();
+            report = min(report, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+        char speedup[16];
+        snprintf(speedup, sizeof(speedup), "%.1fx", sequential / max(parallel, 1e-9));
+        cout << left << setw(8) << shards << fixed << setprecision(1) << setw(14) << csvParallel * 1000 << setw(14)
+             << sequential * 1000 << setw(14) << parallel * 1000 << setw(10) << speedup << setw(14) << setprecision(2) << report * 1000 << accounts.rows() << " (" << groups << " groups)"
+             << endl;
+    }
+    filesystem::remove_all(root);
+    return 0;
+}
+
+// Load the given ledger one way and print one row of the memory table.
+// Runs in its own process so the peak resident size belongs to this mode.
+int runMemoryBenchmarkMode(const string& mode, const string& csvPath, const string& snapshotPath) {
+    uint64_t baseResident = peakResidentBytes();
+    auto start = chrono::steady_clock::now();
+    vector<LegacyTransaction> legacyRows;
+    Ledger ledger;
+    size_t rows = 0;
+    if (mode == "rows") {
+        // The original loader: getline per field into row objects that own every string
+        ifstream file(csvPath);
+        string line;
+        getline(file, line);
+        while (getline(file, line)) {
+            stringstream ss(line);
+            string date, description, category, type, amountText;
+            getline(ss, date, ',');
+            getline(ss, description, ',');
+            getline(ss, amountText, ',');
+            getline(ss, category, ',');
+            getline(ss, type, ',');
+            Money amount;
+            if (parseAmount(amountText, amount)) {
+                legacyRows.push_back(LegacyTransaction(date, description, amount, category, type));
+            }
+        }
+        rows = legacyRows.size();
+    } else if (mode == "ledger") {
+        if (!loadLedgerFromCsv(csvPath, ledger)) return 1;
+        rows = ledger.size();
+    } else if (mode == "snapshot") {
+        MappedFile file(snapshotPath);
+        string error;
+        if (!ledger.loadSnapshot(file.view(), fileStamp(csvPath), error)) {
+            cout << "Error: Snapshot load failed (" << error << ")" << endl;
+            return 1;
+        }
+        rows = ledger.size();
+    } else {
+        cout << "Error: unknown memory benchmark mode '" << mode << "'" << endl;
+        return 2;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    auto megabytes = [](double bytes) {
+        ostringstream text;
+        text << fixed << setprecision(1) << bytes / (1 << 20);
+        return text.str();
+    };
+    string allocations = "n/a", allocated = "n/a", live = "n/a", peak = "n/a";
+    if (kCountingAllocations) {
+        allocations = to_string(allocationCounters.allocations.load());
+        allocated = megabytes(allocationCounters.bytesAllocated.load());
+        live = megabytes(allocationCounters.liveBytes.load());
+        peak = megabytes(allocationCounters.peakLiveBytes.load());
+    }
+    cout << left << setw(10) << mode << setw(10) << rows << setw(14) << allocations << setw(14) << allocated
+         << setw(12) << live << setw(12) << peak << setw(12) << megabytes(peakResidentBytes() - baseResident)
+         << fixed << setprecision(1) << seconds * 1000 << endl;
+    return 0;
+}
+
+// Heap allocations and peak memory of loading the same ledger as string-owning
+// row objects, into the columnar Ledger from CSV, and from a snapshot. Each
+// mode runs in a fresh copy of this program.
+int runMemoryBenchmark(const string& program, size_t rows) {
+    string directory = benchDirectory("memory");
+    string csvPath = directory + "/memory.csv";
+    string snapshotPath = directory + "/memory.snap";
+
+    cout << "Generating " << rows << " synthetic transactions..." << endl;
+    if (!writeSyntheticLedger(csvPath, rows)) {
+        cout << "Error: Could not write '" << csvPath << "'" << endl;
+        return 1;
+    }
+    auto runSelf = [&](const string& arguments) {
+        string command = "\"" + program + "\" " + arguments;
+#ifdef _WIN32
+        command = "\"" + command + "\"";  // cmd strips the outer quotes
+#endif
+        return system(command.c_str());
+    };
+    string paths = "\"" + csvPath + "\" \"" + snapshotPath + "\"";
+#ifdef _WIN32
+    const char* discard = " > NUL";
+#else
+    const char* discard = " > /dev/null";
+#endif
+    if (runSelf("--convert " + paths + discard) != 0) {
+        cout << "Error: Could not write '" << snapshotPath << "'" << endl;
+        return 1;
+    }
+    cout.flush();
+
+    cout << left << setw(10) << "Mode" << setw(10) << "Rows" << setw(14) << "Allocations" << setw(14)
+         << "Alloc (MB)" << setw(12) << "Live (MB)" << setw(12) << "Peak heap" << setw(12) << "Peak RSS" << "Load (ms)"
+         << endl;
+    cout << string(93, '-') << endl;
+    cout.flush();
+    int status = 0;
+    for (const char* mode : {"rows", "ledger", "snapshot"}) {
+        if (runSelf("--memory-bench-mode " + string(mode) + " " + paths) != 0) status = 1;
+    }
+    if (!kCountingAllocations) {
+        cout << "(build with -DEXPENSE_TRACKER_COUNT_ALLOCATIONS to count heap allocations)" << endl;
+    }
+    filesystem::remove_all(directory);
+    return status;
+}
+
+// Quote text as a JSON string
+inline string jsonString(string_view text) {
+    string out = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                    out += escaped;
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    out.push_back('"');
+    return out;
+}
+
+// Date of a ledger row as YYYY-MM-DD, or its original text if it was not parsed
+inline string ledgerDateText(const Ledger& ledger, size_t row) {
+    if (ledger.day(row) == kUnknownDay) return string(ledger.rawDateText(row));
+    char digits[16];
+    return string(digits, formatIsoDate(digits, ledger.day(row)) - digits);
+}
+
+// Format a month key as YYYY-MM ("undated" for rows without a date)
+inline string formatMonthKey(int32_t monthKey) {
+    if (monthKey == kUnknownDay) return "undated";
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%04d-%02d", monthKey / 12, monthKey % 12 + 1);
+    return string(buffer);
+}
+
+// One subcommand of the batch CLI with its arguments
+struct BatchCommand {
+    string name;
+    vector<string> arguments;                    // positional arguments
+    map<string, string> options;                 // --name value
+    vector<pair<string, string>> budgetUpdates;  // budget --set CATEGORY AMOUNT
+    vector<array<string, 3>> ruleAdditions;      // rules --add MATCH PATTERN CATEGORY
+
+    string option(const string& key, const string& fallback = "") const {
+        auto it = options.find(key);
+        return it == options.end() ? fallback : it->second;
+    }
+    bool csvOutput() const { return option("format") == "csv"; }
+};
+
+// Options each batch command accepts (all take one value)
+inline const vector<string>& batchOptions(const string& command) {
+    static const map<string, vector<string>> options = {
+        {"import", {"format", "duplicates", "categorize"}},
+        {"add", {"format", "type", "amount", "description", "category", "date"}},
+        {"report", {"format", "month", "from", "to", "by", "type"}},
+        {"budget", {"format", "month", "period", "thresholds", "income-thresholds"}},
+        {"export", {"format"}},
+        {"list", {"format", "offset", "limit", "output", "sections"}},
+        {"search", {"format", "limit"}},
+        {"query", {"format", "limit", "from", "to", "min", "max", "category", "type"}},
+        {"trends", {"format", "as-of", "by", "periods", "window", "category"}},
+        {"rules", {"format"}},
+    };
+    static const vector<string> none;
+    auto it = options.find(command);
+    return it == options.end() ? none : it->second;
+}
+
+inline bool isBatchCommand(const string& word) {
+    return word == "import" || word == "add" || word == "report" || word == "budget" || word == "export" ||
+           word == "list" || word == "search" || word == "query" || word == "trends" ||
+           word == "rules";
+}
+
+void printBatchUsage(ostream& out) {
+    out << "Usage: expense_tracker <command> [options] [<command> [options] ...]\n"
+        << "Commands run in order in one process; each prints one result (JSON by default).\n"
+        << "search and rules read every following word as text, command names included; put -- before\n"
+        << "a command that should run after them (search coffee -- list).\n\n"
+        << "  import <file.csv> [--duplicates skip|keep] Import a bank export; rows already in the\n"
+        << "         [--categorize blank|all|off]       ledger are skipped unless --duplicates keep, and\n"
+        << "                                            rules fill in blank categories (all: any match)\n"
+        << "  add --type income|expense --amount N --description TEXT --category NAME [--date DATE]\n"
+        << "  report [--month YYYY-MM] [--from YYYY-MM-DD] [--to YYYY-MM-DD]\n"
+        << "         [--by category|month|month-category] [--type income|expense]\n"
+        << "  budget [--set CATEGORY AMOUNT]... [--period weekly|monthly|yearly] [--thresholds 60,80,100]\n"
+        << "         [--income-thresholds 70,80,90] [--month YYYY-MM]   CATEGORY * limits all expenses\n"
+        << "  export <file.csv>\n"
+        << "  list [--offset N] [--limit N] [--output FILE] [--sections rows,summary,categories,alerts]\n"
+        << "  search WORD... [--limit N]                Transactions whose description has every word\n"
+        << "                                            (word prefix; *word matches inside words)\n"
+        << "  query [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--min N] [--max N] [--category A,B]\n"
+        << "        [--type income|expense] [--limit N]   Transactions matching every filter\n"
+        << "  trends [--as-of YYYY-MM-DD] [--by day|week|month] [--periods N] [--window N] [--category NAME]\n"
+        << "                                            Burn rates and month-end projections per category,\n"
+        << "                                            and a spending series with its moving average\n"
+        << "  rules [--add exact|prefix|substring|regex PATTERN CATEGORY]... [DESCRIPTION...]\n"
+        << "                                            Add and list categorization rules (first match\n"
+        << "                                            wins); try them on the given descriptions\n\n"
+        << "Commands accept --format json|csv (list: text|csv). Status messages and wall times go to stderr.\n\n"
+        << "Before the command, --account NAME uses the ledger in accounts/NAME/ instead of the working\n"
+        << "directory, and --accounts A,B,... (or all) runs report over several accounts, merged.\n";
+}
+
+// Split argv into batch commands; returns false with a message on bad usage
+bool parseBatchCommands(int argc, char* argv[], vector<BatchCommand>& commands, string& error) {
+    bool freeText = false;        // search and rules take any words until --
+    bool afterSeparator = false;
+    for (int i = 1; i < argc; i++) {
+        string word = argv[i];
+        if (word == "--" && !commands.empty()) {
+            afterSeparator = true;
+            continue;
+        }
+        if (isBatchCommand(word) && (!freeText || afterSeparator)) {
+            commands.emplace_back();
+            commands.back().name = word;
+            freeText = word == "search" || word == "rules";
+            afterSeparator = false;
+            continue;
+        }
+        if (afterSeparator) {
+            error = "-- must be followed by a command, not '" + word + "'";
+            return false;
+        }
+        if (commands.empty()) {
+            error = "unknown command '" + word + "'";
+            return false;
+        }
+        BatchCommand& command = commands.back();
+        if (word.compare(0, 2, "--") != 0) {
+            command.arguments.push_back(word);
+            continue;
+        }
+
+        string key = word.substr(2);
+        if (command.name == "budget" && key == "set") {
+            if (i + 2 >= argc) {
+                error = "--set needs a category and an amount";
+                return false;
+            }
+            command.budgetUpdates.emplace_back(argv[i + 1], argv[i + 2]);
+            i += 2;
+            continue;
+        }
+        if (command.name == "rules" && key == "add") {
+            if (i + 3 >= argc) {
+                error = "--add needs a match type, a pattern and a category";
+                return false;
+            }
+            command.ruleAdditions.push_back({argv[i + 1], argv[i + 2], argv[i + 3]});
+            i += 3;
+            continue;
+        }
+        const vector<string>& allowed = batchOptions(command.name);
+        if (find(allowed.begin(), allowed.end(), key) == allowed.end()) {
+            error = "'" + command.name + "' does not accept " + word;
+            return false;
+        }
+        if (i + 1 >= argc) {
+            error = word + " needs a value";
+            return false;
+        }
+        command.options[key] = argv[++i];
+    }
+    if (commands.empty()) {
+        error = "no command given";
+        return false;
+    }
+    return true;
+}
+
+// Build a TransactionQuery from the query command's options
+bool parseTransactionQuery(const BatchCommand& command, const Ledger& ledger, TransactionQuery& query,
+                           string& error) {
+    for (const char* key : {"from", "to"}) {
+        string value = command.option(key);
+        if (value.empty()) continue;
+        int32_t day = parseDate(value);
+        if (day == kUnknownDay) {
+            error = string("--") + key + " must be YYYY-MM-DD";
+            return false;
+        }
+        (string(key) == "from" ? query.firstDay : query.lastDay) = day;
+    }
+    for (const char* key : {"min", "max"}) {
+        string value = command.option(key);
+        if (value.empty()) continue;
+        Money amount;
+        if (!parseAmount(value, amount)) {
+            error = string("--") + key + " must be an amount";
+            return false;
+        }
+        (string(key) == "min" ? query.minAmount : query.maxAmount) = amount;
+    }
+    string categories = command.option("category");
+    if (!categories.empty()) {
+        stringstream list(categories);
+        string category;
+        while (getline(list, category, ',')) {
+            query.categoryIds.push_back(ledger.categoryDictionary().find(category));
+        }
+    }
+    string type = command.option("type");
+    if (!type.empty()) {
+        if (type != "income" && type != "expense") {
+            error = "--type must be 'income' or 'expense'";
+            return false;
+        }
+        query.anyType = false;
+        query.type = parseType(type);
+    }
+    return true;
+}
+
+// Build the report command's group-by from its options
+bool parseReportQuery(const BatchCommand& command, GroupQuery& query, string& error) {
+    string by = command.option("by", "category");
+    if (by == "month") {
+        query.byMonth = true;
+        query.byCategory = false;
+    } else if (by == "month-category") {
+        query.byMonth = true;
+    } else if (by != "category") {
+        error = "--by must be category, month or month-category";
+        return false;
+    }
+    string month = command.option("month");
+    if (!month.empty()) {
+        query.monthKey = parseMonthKey(month);
+        if (query.monthKey == kUnknownDay) {
+            error = "--month must be YYYY-MM";
+            return false;
+        }
+    }
+    for (const char* key : {"from", "to"}) {
+        string value = command.option(key);
+        if (value.empty()) continue;
+        int32_t day = parseDate(value);
+        if (day == kUnknownDay) {
+            error = string("--") + key + " must be YYYY-MM-DD";
+            return false;
+        }
+        (string(key) == "from" ? query.firstDay : query.lastDay) = day;
+    }
+    string type = command.option("type");
+    if (!type.empty()) {
+        if (type != "income" && type != "expense") {
+            error = "--type must be 'income' or 'expense'";
+            return false;
+        }
+        query.anyType = false;
+        query.type = parseType(type);
+    }
+    return true;
+}
+
+// Write the report command's groups as CSV or JSON. accountsJson, if not
+// empty, is added to the JSON object as the "accounts" member.
+void writeReport(ostream& out, const BatchCommand& command, const vector<QueryRow>& groups,
+                 const StringDictionary& categories, double ms, const string& accountsJson = "") {
+    string by = command.option("by", "category");
+    string month = command.option("month");
+    Money income, expenses;
+    for (const QueryRow& group : groups) {
+        (group.type == TransactionType::Income ? income : expenses) += group.cell.sum;
+    }
+    if (command.csvOutput()) {
+        out << "month,category,type,total,count\n";
+        string row;
+        for (const QueryRow& group : groups) {
+            row.clear();
+            if (group.monthKey != kAnyMonth) row = formatMonthKey(group.monthKey);
+            row.push_back(',');
+            if (group.categoryId != kAnyCategory) appendCsvField(row, categories.name(group.categoryId));
+            out << row << ',' << typeName(group.type) << ',' << group.cell.sum << ',' << group.cell.count << '\n';
+        }
+        out << flush;
+        return;
+    }
+    out << "{\"command\":\"report\",\"ok\":true,\"by\":" << jsonString(by)
+        << ",\"month\":" << (month.empty() ? "null" : jsonString(month))
+        << ",\"income\":" << income << ",\"expenses\":" << expenses << ",\"balance\":" << income - expenses;
+    if (!accountsJson.empty()) out << ",\"accounts\":" << accountsJson;
+    out << ",\"groups\":[";
+    for (size_t i = 0; i < groups.size(); i++) {
+        out << (i ? "," : "") << "{";
+        if (groups[i].monthKey != kAnyMonth) out << "\"month\":" << jsonString(formatMonthKey(groups[i].monthKey)) << ",";
+        if (groups[i].categoryId != kAnyCategory) {
+            out << "\"category\":" << jsonString(categories.name(groups[i].categoryId)) << ",";
+        }
+        out << "\"type\":\"" << typeName(groups[i].type) << "\",\"total\":" << groups[i].cell.sum
+            << ",\"count\":" << groups[i].cell.count << "}";
+    }
+    out << "],\"elapsed_ms\":" << fixed << setprecision(3) << ms << "}" << endl;
+}
+
+// Run one batch command against the tracker, writing its result to out.
+// Returns 0 on success, 1 if the command failed.
+int runBatchCommand(ExpenseTracker& tracker, const BatchCommand& command, ostream& out, double& seconds) {
+    auto start = chrono::steady_clock::now();
+    auto elapsedMs = [&] {
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return seconds * 1000;
+    };
+    string format = command.option("format", command.name == "list" ? "text" : "json");
+    auto fail = [&](const string& message) {
+        elapsedMs();
+        if (format != "json") {
+            cerr << "Error: " << message << endl;
+        } else {
+            out << "{\"command\":" << jsonString(command.name) << ",\"ok\":false,\"error\":" << jsonString(message)
+                << ",\"elapsed_ms\":" << fixed << setprecision(3) << seconds * 1000 << "}" << endl;
+        }
+        return 1;
+    };
+    if (format != (command.name == "list" ? "text" : "json") && format != "csv") {
+        return fail("unknown format '" + format + "'");
+    }
+
+    if (command.name == "import") {
+        if (command.arguments.size() != 1) return fail("import needs exactly one file");
+        string duplicates = command.option("duplicates", "skip");
+        if (duplicates != "skip" && duplicates != "keep") return fail("--duplicates must be skip or keep");
+        string categorize = command.option("categorize", "blank");
+        if (categorize != "blank" && categorize != "all" && categorize != "off") {
+            return fail("--categorize must be blank, all or off");
+        }
+        ImportReport report;
+        if (!tracker.importFile(command.arguments[0], report, duplicates == "skip", categorize != "off",
+                                categorize == "all")) {
+            return fail("could not open file '" + command.arguments[0] + "'");
+        }
+        string journalError;
+        if (tracker.takeJournalError(journalError)) {
+            return fail(journalError + " (" + to_string(report.added) + " imported rows are not durable)");
+        }
+        size_t alerts = tracker.takeBudgetAlerts().size();
+        double ms = elapsedMs();
+        if (command.csvOutput()) {
+            string row;
+            appendCsvField(row, command.arguments[0]);
+            out << "file,added,duplicates,categorized,lines,errors,threads,budget_alerts,rows_per_sec,elapsed_ms\n"
+                << row << ',' << report.added << ',' << report.duplicates << ',' << report.categorized << ','
+                << report.linesScanned << ',' << report.errors.size() << ','
+                << report.threadsUsed << ',' << alerts << ','
+                << fixed << setprecision(0) << report.rowsPerSecond() << ',' << setprecision(3) << ms << endl;
+            for (const auto& error : report.errors) {
+                cerr << "Line " << error.first << ": " << error.second << endl;
+            }
+        } else {
+            out << "{\"command\":\"import\",\"ok\":true,\"file\":" << jsonString(command.arguments[0])
+                << ",\"added\":" << report.added << ",\"duplicates\":" << report.duplicates
+                << ",\"categorized\":" << report.categorized << ",\"lines\":" << report.linesScanned
+                << ",\"threads\":" << report.threadsUsed << ",\"budget_alerts\":" << alerts << ",\"rows_per_sec\":" << fixed << setprecision(0)
+                << report.rowsPerSecond() << ",\"errors\":[";
+            for (size_t i = 0; i < report.errors.size(); i++) {
+                out << (i ? "," : "") << "{\"line\":" << report.errors[i].first
+                    << ",\"message\":" << jsonString(report.errors[i].second) << "}";
+            }
+            out << "],\"elapsed_ms\":" << setprecision(3) << ms << "}" << endl;
+        }
+        return 0;
+    }
+
+    if (command.name == "rules") {
+        for (const auto& addition : command.ruleAdditions) {
+            MatchKind kind;
+            if (!parseMatchKind(addition[0], kind)) {
+                return fail("match type must be exact, prefix, substring or regex, not '" + addition[0] + "'");
+            }
+            string error;
+            if (!tracker.addCategoryRule(kind, addition[1], addition[2], error)) return fail(error);
+        }
+        CategoryRuleEngine& rules = tracker.categorizationRules();
+        CategoryRuleEngine::MatchScratch scratch;
+        vector<const CategoryRule*> matches;
+        for (const string& description : command.arguments) matches.push_back(rules.match(description, scratch));
+        double ms = elapsedMs();
+        if (command.csvOutput()) {
+            string row;
+            if (command.arguments.empty()) {
+                out << "match,pattern,category\n";
+                for (const CategoryRule& rule : rules.all()) {
+                    row.clear();
+                    appendCsvField(row, rule.pattern);
+                    row.push_back(',');
+                    appendCsvField(row, rule.category);
+                    out << matchKindName(rule.kind) << ',' << row << '\n';
+                }
+            } else {
+                out << "description,category\n";
+                for (size_t i = 0; i < matches.size(); i++) {
+                    row.clear();
+                    appendCsvField(row, command.arguments[i]);
+                    row.push_back(',');
+                    if (matches[i]) appendCsvField(row, matches[i]->category);
+                    out << row << '\n';
+                }
+            }
+            out << flush;
+            return 0;
+        }
+        out << "{\"command\":\"rules\",\"ok\":true,\"added\":" << command.ruleAdditions.size() << ",\"rules\":[";
+        for (size_t i = 0; i < rules.all().size(); i++) {
+            const CategoryRule& rule = rules.all()[i];
+            out << (i ? "," : "") << "{\"match\":\"" << matchKindName(rule.kind) << "\",\"pattern\":"
+                << jsonString(rule.pattern) << ",\"category\":" << jsonString(rule.category) << "}";
+        }
+        out << "],\"matches\":[";
+        for (size_t i = 0; i < matches.size(); i++) {
+            out << (i ? "," : "") << "{\"description\":" << jsonString(command.arguments[i]) << ",\"category\":"
+                << (matches[i] ? jsonString(matches[i]->category) : "null") << "}";
+        }
+        out << "],\"elapsed_ms\":" << fixed << setprecision(3) << ms << "}" << endl;
+        return 0;
+    }
+
+    if (command.name == "add") {
+        string type = command.option("type");
+        transform(type.begin(), type.end(), type.begin(), ::tolower);
+        if (type != "income" && type != "expense") return fail("--type must be 'income' or 'expense'");
+        Money amount;
+        if (!parseAmount(command.option("amount"), amount) || !tracker.isValidAmount(amount)) {
+            return fail("--amount must be a positive number up to 100000000000");
+        }
+        string date = command.option("date", tracker.getCurrentDate());
+        if (parseDate(date) == kUnknownDay) return fail("--date must be YYYY-MM-DD");
+        string description = command.option("description");
+        if (description.empty()) return fail("--description must not be empty");
+        string category = command.option("category");
+        if (category.empty()) return fail("--category must not be empty");
+        double durableSeconds = tracker.recordTransaction(date, description, amount, category, parseType(type));
+        string journalError;
+        if (tracker.takeJournalError(journalError)) return fail(journalError + " (the transaction is not durable)");
+        vector<BudgetAlert> alerts = tracker.takeBudgetAlerts();
+        double ms = elapsedMs();
+        if (command.csvOutput()) {
+            string row;
+            appendCsvField(row, date);
+            row.push_back(',');
+            appendCsvField(row, description);
+            out << "date,description,amount,category,type,journal_ms,elapsed_ms\n" << row << ',' << amount << ',';
+            row.clear();
+            appendCsvField(row, category);
+            out << row << ',' << type << ',' << fixed << setprecision(3) << durableSeconds * 1000 << ',' << ms << endl;
+            for (const BudgetAlert& alert : alerts) {
+                const BudgetRule& rule = tracker.budgets().all()[alert.rule];
+                cerr << "Budget alert: " << rule.label() << " (" << budgetPeriodName(rule.period) << ") reached "
+                     << alert.threshold << "% (" << alert.spent << " of " << rule.limit << ")" << endl;
+            }
+        } else {
+            out << "{\"command\":\"add\",\"ok\":true,\"date\":" << jsonString(date)
+                << ",\"description\":" << jsonString(description) << ",\"amount\":" << amount
+                << ",\"category\":" << jsonString(category) << ",\"type\":" << jsonString(type)
+                << ",\"alerts\":[";
+            for (size_t i = 0; i < alerts.size(); i++) {
+                const BudgetRule& rule = tracker.budgets().all()[alerts[i].rule];
+                out << (i ? "," : "") << "{\"category\":" << (rule.isGlobal() ? "null" : jsonString(rule.category))
+                    << ",\"period\":\"" << budgetPeriodName(rule.period) << "\",\"threshold\":" << alerts[i].threshold
+                    << ",\"spent\":" << alerts[i].spent << ",\"limit\":" << rule.limit << "}";
+            }
+            out << "],\"journal_ms\":" << fixed << setprecision(3) << durableSeconds * 1000
+                << ",\"elapsed_ms\":" << ms << "}" << endl;
+        }
+        return 0;
+    }
+
+    if (command.name == "report") {
+        GroupQuery query;
+        string error;
+        if (!parseReportQuery(command, query, error)) return fail(error);
+        vector<QueryRow> groups = tracker.runQuery(query);
+        writeReport(out, command, groups, tracker.ledger().categoryDictionary(), elapsedMs());
+        return 0;
+    }
+
+    if (command.name == "trends") {
+        int32_t day = parseDate(command.option("as-of", tracker.getCurrentDate()));
+        if (day == kUnknownDay) return fail("--as-of must be YYYY-MM-DD");
+        SeriesBucket bucket = SeriesBucket::Weekly;
+        if (!command.option("by").empty() && !parseSeriesBucket(command.option("by"), bucket)) {
+            return fail("--by must be day, week or month");
+        }
+        auto parseCount = [](const string& value, size_t& count) {
+            auto parsed = from_chars(value.data(), value.data() + value.size(), count);
+            return parsed.ec == errc() && parsed.ptr == value.data() + value.size();
+        };
+        size_t periods = 0, window = 0;
+        if (!parseCount(command.option("periods", "12"), periods) || periods == 0 || periods > 100000) {
+            return fail("--periods must be between 1 and 100000");
+        }
+        if (!parseCount(command.option("window", "4"), window) || window == 0 || window > 1000) {
+            return fail("--window must be between 1 and 1000");
+        }
+        const StringDictionary& categories = tracker.ledger().categoryDictionary();
+        string category = command.option("category");
+        uint32_t categoryId = kAnyCategory;
+        if (!category.empty()) {
+            categoryId = categories.find(category);
+            if (categoryId == StringDictionary::npos) return fail("unknown category '" + category + "'");
+        }
+
+        vector<SpendingForecast> forecasts = tracker.getSpendingForecasts(day);
+        vector<SeriesPoint> points = tracker.getSpendingSeries(categoryId, bucket, day, periods, window);
+        double ms = elapsedMs();
+        auto categoryName = [&](const SpendingForecast& forecast) {
+            return forecast.categoryId == kAnyCategory ? string("*") : categories.name(forecast.categoryId);
+        };
+        if (command.csvOutput()) {
+            out << "category,month_to_date,avg_7d,avg_30d,change_30d_pct,projected,budget,status\n";
+            string row;
+            for (const SpendingForecast& forecast : forecasts) {
+                row.clear();
+                appendCsvField(row, categoryName(forecast));
+                out << row << ',' << forecast.monthToDate << ',' << forecast.dailyAverage7 << ','
+                    << forecast.dailyAverage30 << ',';
+                double change;
+                if (forecast.velocityChange(change)) out << fixed << setprecision(1) << change;
+                out << ',' << forecast.projectedMonthEnd << ',';
+                if (const BudgetRule* budget = tracker.monthlyBudgetFor(forecast)) {
+                    out << budget->limit << ','
+                        << budgetLevelName(budgetLevel(forecast.projectedMonthEnd, budget->limit, budget->thresholds));
+                } else {
+                    out << ',';
+                }
+                out << '\n';
+            }
+            out << flush;
+            return 0;
+        }
+
+        auto writeForecast = [&](const SpendingForecast& forecast) {
+            out << "{\"category\":"
+                << (forecast.categoryId == kAnyCategory ? "null" : jsonString(categories.name(forecast.categoryId)))
+                << ",\"month_to_date\":" << forecast.monthToDate << ",\"avg_7d\":" << forecast.dailyAverage7
+                << ",\"avg_30d\":" << forecast.dailyAverage30 << ",\"change_30d_pct\":";
+            double change;
+            if (forecast.velocityChange(change)) out << fixed << setprecision(1) << change;
+            else out << "null";
+            out << ",\"projected\":" << forecast.projectedMonthEnd;
+            if (const BudgetRule* budget = tracker.monthlyBudgetFor(forecast)) {
+                out << ",\"budget\":" << budget->limit << ",\"status\":\""
+                    << budgetLevelName(budgetLevel(forecast.projectedMonthEnd, budget->limit, budget->thresholds))
+                    << "\"";
+            } else {
+                out << ",\"budget\":null,\"status\":null";
+            }
+            out << "}";
+        };
+        out << "{\"command\":\"trends\",\"ok\":true,\"as_of\":" << jsonString(formatDate(day))
+            << ",\"days_left\":" << forecasts.back().daysLeft << ",\"categories\":[";
+        for (size_t i = 0; i + 1 < forecasts.size(); i++) {
+            if (i) out << ",";
+            writeForecast(forecasts[i]);
+        }
+        out << "],\"all\":";
+        writeForecast(forecasts.back());
+        out << ",\"series\":{\"category\":" << (category.empty() ? "null" : jsonString(category))
+            << ",\"by\":\"" << seriesBucketName(bucket) << "\",\"window\":" << window << ",\"points\":[";
+        for (size_t i = 0; i < points.size(); i++) {
+            out << (i ? "," : "") << "{\"start\":" << jsonString(formatDate(points[i].firstDay))
+                << ",\"end\":" << jsonString(formatDate(points[i].lastDay)) << ",\"spent\":" << points[i].spent
+                << ",\"moving_avg\":" << points[i].movingAverage << "}";
+        }
+        out << "]},\"elapsed_ms\":" << fixed << setprecision(3) << ms << "}" << endl;
+        return 0;
+    }
+
+    if (command.name == "budget") {
+        BudgetPeriod period = BudgetPeriod::Monthly;
+        if (!command.option("period").empty() && !parseBudgetPeriod(command.option("period"), period)) {
+            return fail("--period must be weekly, monthly or yearly");
+        }
+        vector<int> thresholds = defaultBudgetThresholds();
+        if (!command.option("thresholds").empty() && !parseThresholds(command.option("thresholds"), thresholds)) {
+            return fail("--thresholds must be ascending percentages such as 60,80,100");
+        }
+        string incomeThresholds = command.option("income-thresholds");
+        if (!incomeThresholds.empty()) {
+            vector<int> levels;
+            if (!parseThresholds(incomeThresholds, levels) || levels.size() != 3) {
+                return fail("--income-thresholds must be three ascending percentages such as 70,80,90");
+            }
+            tracker.setIncomeAlertThresholds(levels);
+        }
+        for (const auto& update : command.budgetUpdates) {
+            Money limit, previous;
+            if (!parseAmount(update.second, limit) || !tracker.isValidAmount(limit)) {
+                return fail("budget for '" + update.first + "' must be a positive number up to 100000000000");
+            }
+            tracker.setBudget(update.first == "*" ? string() : update.first, period, limit, thresholds, previous);
         }
+        string month = command.option("month", tracker.getCurrentMonthYear());
+        if (parseMonthKey(month) == kUnknownDay) return fail("--month must be YYYY-MM");
 
-        cout << "Enter amount: $";
-        cin >> amount;
-
-        if (!isValidAmount(amount)) {
-            cout << "Invalid amount! Please enter a positive number." << endl;
-            return;
+        vector<BudgetStatus> statuses = tracker.getBudgetStatus(month);
+        double ms = elapsedMs();
+        if (command.csvOutput()) {
+            out << "category,period,limit,spent,remaining,status\n";
+            string row;
+            for (const auto& status : statuses) {
+                row.clear();
+                appendCsvField(row, status.category.empty() ? "*" : status.category);
+                out << row << ',' << budgetPeriodName(status.period) << ',' << status.limit << ',' << status.spent << ',' << status.remaining << ','
+                    << budgetLevelName(status.level) << '\n';
+            }
+            out << flush;
+        } else {
+            out << "{\"command\":\"budget\",\"ok\":true,\"month\":" << jsonString(month) << ",\"budgets\":[";
+            for (size_t i = 0; i < statuses.size(); i++) {
+                out << (i ? "," : "") << "{\"category\":"
+                    << (statuses[i].category.empty() ? "null" : jsonString(statuses[i].category))
+                    << ",\"period\":\"" << budgetPeriodName(statuses[i].period) << "\",\"limit\":" << statuses[i].limit << ",\"spent\":" << statuses[i].spent
+                    << ",\"remaining\":" << statuses[i].remaining << ",\"status\":\""
+                    << budgetLevelName(statuses[i].level) << "\"}";
+            }
+            out << "],\"elapsed_ms\":" << fixed << setprecision(3) << ms << "}" << endl;
         }
+        return 0;
+    }
 
-        cin.ignore(); // Clear input buffer
-        cout << "Enter description: ";
-        getline(cin, description);
+    if (command.name == "search" || command.name == "query") {
+        size_t limit = SIZE_MAX;
+        string limitText = command.option("limit");
+        if (!limitText.empty()) {
+            auto parsed = from_chars(limitText.data(), limitText.data() + limitText.size(), limit);
+            if (parsed.ec != errc() || parsed.ptr != limitText.data() + limitText.size()) {
+                return fail("--limit must be a whole number");
+            }
+        }
 
-        cout << "Enter category: ";
-        getline(cin, category);
+        string query;
+        SearchResult result;
+        if (command.name == "search") {
+            if (command.arguments.empty()) return fail("search needs at least one word");
+            for (const string& word : command.arguments) query += (query.empty() ? "" : " ") + word;
+            result = tracker.searchDescriptions(query);
+        } else {
+            if (!command.arguments.empty()) return fail("query takes only options");
+            TransactionQuery filter;
+            string error;
+            if (!parseTransactionQuery(command, tracker.ledger(), filter, error)) return fail(error);
+            result = tracker.findTransactions(filter);
+        }
 
-        cout << "Enter date (or press Enter for current date): ";
-        getline(cin, dateInput);
+        const Ledger& ledger = tracker.ledger();
+        size_t shown = min(limit, result.rows.size());
+        double ms = elapsedMs();
+        if (command.csvOutput()) {
+            out << "date,description,amount,category,type\n";
+            string row;
+            for (size_t i = 0; i < shown; i++) {
+                uint32_t r = result.rows[i];
+                row.clear();
+                appendCsvField(row, ledgerDateText(ledger, r));
+                row.push_back(',');
+                appendCsvField(row, ledger.description(r));
+                out << row << ',' << ledger.amount(r) << ',';
+                row.clear();
+                appendCsvField(row, ledger.category(r));
+                out << row << ',' << typeName(ledger.type(r)) << '\n';
+            }
+            out << flush;
+            cerr << result.rows.size() << " matches, income " << result.income << ", expenses "
+                 << result.expenses << endl;
+        } else {
+            out << "{\"command\":" << jsonString(command.name) << ",\"ok\":true";
+            if (command.name == "search") out << ",\"query\":" << jsonString(query);
+            out << ",\"matches\":" << result.rows.size() << ",\"income\":" << result.income
+                << ",\"expenses\":" << result.expenses << ",\"rows\":[";
+            for (size_t i = 0; i < shown; i++) {
+                uint32_t r = result.rows[i];
+                out << (i ? "," : "") << "{\"date\":" << jsonString(ledgerDateText(ledger, r))
+                    << ",\"description\":" << jsonString(ledger.description(r)) << ",\"amount\":" << ledger.amount(r)
+                    << ",\"category\":" << jsonString(ledger.category(r)) << ",\"type\":\""
+                    << typeName(ledger.type(r)) << "\"}";
+            }
+            out << "],\"search_ms\":" << fixed << setprecision(3) << result.seconds * 1000
+                << ",\"elapsed_ms\":" << ms << "}" << endl;
+        }
+        return 0;
+    }
 
-        if (dateInput.empty()) {
-            dateInput = getCurrentDate();
+    if (command.name == "list") {
+        ReportOptions options;
+        options.csv = command.csvOutput();
+        for (const char* key : {"offset", "limit"}) {
+            string value = command.option(key);
+            if (value.empty()) continue;
+            size_t count = 0;
+            auto parsed = from_chars(value.data(), value.data() + value.size(), count);
+            if (parsed.ec != errc() || parsed.ptr != value.data() + value.size()) {
+                return fail(string("--") + key + " must be a whole number");
+            }
+            (string(key) == "offset" ? options.offset : options.limit) = count;
+        }
+        string sections = command.option("sections");
+        if (!sections.empty()) {
+            options.rows = false;
+            stringstream list(sections);
+            string section;
+            while (getline(list, section, ',')) {
+                if (section == "rows") options.rows = true;
+                else if (section == "summary") options.summary = true;
+                else if (section == "categories") options.categories = true;
+                else if (section == "alerts") options.alerts = true;
+                else return fail("unknown section '" + section + "'");
+            }
+            if (options.csv && (options.summary || options.categories || options.alerts)) {
+                return fail("--format csv only renders the rows section");
+            }
         }
 
-        // Add transaction
-        transactions.push_back(Transaction(dateInput, description, amount, category, type));
+        string output = command.option("output");
+        unique_ptr<ReportRenderer> renderer =
+            output.empty() ? make_unique<ReportRenderer>(stdout) : make_unique<ReportRenderer>(output);
+        if (!renderer->isOpen()) return fail("could not write '" + output + "'");
+        size_t rendered = tracker.renderReport(*renderer, options);
+        if (!renderer->flush()) return fail("could not write report output");
+        double ms = elapsedMs();
+        cerr << "Rendered " << rendered << " rows, " << fixed << setprecision(1)
+             << renderer->bytesRendered() / 1e6 << " MB (" << setprecision(0)
+             << (seconds > 0 ? rendered / seconds : 0.0) << " rows/sec) in " << setprecision(3) << ms << " ms" << endl;
+        return 0;
+    }
 
-        // Update totals
-        if (type == "income") {
-            totalIncome += amount;
-            cout << "✅ Income of $" << fixed << setprecision(2) << amount << " added successfully!" << endl;
-        } else {
-            totalExpenses += amount;
-            cout << "💸 Expense of $" << fixed << setprecision(2) << amount << " recorded successfully!" << endl;
+    // export
+    if (command.arguments.size() != 1) return fail("export needs exactly one file");
+    uint64_t bytes = 0;
+    if (!tracker.exportTo(command.arguments[0], bytes)) {
+        return fail("could not write '" + command.arguments[0] + "'");
+    }
+    double ms = elapsedMs();
+    if (command.csvOutput()) {
+        string row;
+        appendCsvField(row, command.arguments[0]);
+        out << "file,rows,bytes,elapsed_ms\n" << row << ',' << tracker.ledger().size() << ',' << bytes << ','
+            << fixed << setprecision(3) << ms << endl;
+    } else {
+        out << "{\"command\":\"export\",\"ok\":true,\"file\":" << jsonString(command.arguments[0])
+            << ",\"rows\":" << tracker.ledger().size() << ",\"bytes\":" << bytes
+            << ",\"elapsed_ms\":" << fixed << setprecision(3) << ms << "}" << endl;
+    }
+    return 0;
+}
 
-            // Check if this expense affects any budget limits
-            if (!budgetLimits.empty()) {
-                string currentMonth = getCurrentMonthYear();
-                map<string, double> monthlyExpenses = getMonthlyExpensesByCategory(currentMonth);
-                double categorySpent = monthlyExpenses[category];
-
-                auto budgetIt = find_if(budgetLimits.begin(), budgetLimits.end(),
-                                      [&category](const BudgetLimit& budget) {
-                                          return budget.category == category;
-                                      });
-
-                if (budgetIt != budgetLimits.end()) {
-                    double percentage = (categorySpent / budgetIt->monthlyLimit) * 100;
-                    cout << "📊 Category '" << category << "' spending: $" << fixed << setprecision(2) 
-                         << categorySpent << " / $" << budgetIt->monthlyLimit 
-                         << " (" << fixed << setprecision(1) << percentage << "%)" << endl;
-
-                    if (percentage >= 100) {
-                        cout << "🚨 WARNING: Budget exceeded for '" << category << "'!" << endl;
-                    } else if (percentage >= 80) {
-                        cout << "⚠️ Approaching budget limit for '" << category << "'!" << endl;
-                    }
-                }
+// Run a report command over several accounts, merged, with per-account totals
+int runAccountsReport(LedgerSet& accounts, const BatchCommand& command, ostream& out, double& seconds) {
+    auto start = chrono::steady_clock::now();
+    auto elapsedMs = [&] {
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return seconds * 1000;
+    };
+    GroupQuery query;
+    string error;
+    string format = command.option("format", "json");
+    if (format != "json" && format != "csv") error = "unknown format '" + format + "'";
+    if (error.empty() && parseReportQuery(command, query, error)) {
+        vector<vector<QueryRow>> perAccount;
+        vector<QueryRow> groups = accounts.groupBy(query, &perAccount);
+        string accountsJson = "[";
+        for (size_t i = 0; i < accounts.size(); i++) {
+            Money income, expenses;
+            for (const QueryRow& group : perAccount[i]) {
+                (group.type == TransactionType::Income ? income : expenses) += group.cell.sum;
             }
+            stringstream entry;
+            entry << (i ? "," : "") << "{\"account\":" << jsonString(accounts.shard(i).name)
+                  << ",\"rows\":" << accounts.shard(i).tracker->ledger().size() << ",\"income\":" << income
+                  << ",\"expenses\":" << expenses << ",\"balance\":" << income - expenses << "}";
+            accountsJson += entry.str();
         }
+        writeReport(out, command, groups, accounts.categoryDictionary(), elapsedMs(), accountsJson + "]");
+        return 0;
+    }
 
-        // Show quick financial summary
-        cout << "\n📈 Quick Summary:" << endl;
-        cout << "Total Income: $" << fixed << setprecision(2) << totalIncome << endl;
-        cout << "Total Expenses: $" << fixed << setprecision(2) << totalExpenses << endl;
-        cout << "Available Balance: $" << fixed << setprecision(2) << (totalIncome - totalExpenses) << endl;
-
-        checkAndShowAlerts();
+    elapsedMs();
+    if (format != "json") {
+        cerr << "Error: " << error << endl;
+    } else {
+        out << "{\"command\":\"report\",\"ok\":false,\"error\":" << jsonString(error)
+            << ",\"elapsed_ms\":" << fixed << setprecision(3) << seconds * 1000 << "}" << endl;
     }
+    return 1;
+}
 
-    // Load data from CSV file
-    void loadData() {
-        ifstream file(dataFile);
-        if (!file.is_open()) {
-            cout << "No existing data file found. Starting fresh." << endl;
-            return;
+// Batch mode over several accounts (names separated by commas, or "all"):
+// only reports, which are merged across the accounts
+int runAccountsBatch(const vector<BatchCommand>& commands, const string& accountList) {
+    for (const auto& command : commands) {
+        if (command.name != "report") {
+            cerr << "Error: --accounts only works with report; use --account NAME for '" << command.name << "'\n\n";
+            printBatchUsage(cerr);
+            return 2;
+        }
+    }
+    vector<string> names;
+    if (accountList == "all") {
+        names = LedgerSet::discover();
+    } else {
+        stringstream list(accountList);
+        string name;
+        while (getline(list, name, ',')) {
+            if (!isValidAccountName(name)) {
+                cerr << "Error: invalid account name '" << name << "'" << endl;
+                return 2;
+            }
+            if (!filesystem::is_directory(accountDirectory(name))) {
+                cerr << "Error: no account '" << name << "' in '" << kAccountsDirectory << "'" << endl;
+                return 1;
+            }
+            names.push_back(name);
         }
+    }
+    if (names.empty()) {
+        cerr << "Error: no accounts found in '" << kAccountsDirectory << "'" << endl;
+        return 1;
+    }
 
+    LedgerSet accounts;
+    accounts.open(names);
+    for (size_t i = 0; i < accounts.size(); i++) {
+        stringstream messages(accounts.shard(i).log->str());
         string line;
-        // Skip header line
-        getline(file, line);
+        while (getline(messages, line)) cerr << "[" << accounts.shard(i).name << "] " << line << endl;
+    }
+    cerr << "[load] " << fixed << setprecision(3) << accounts.loadSeconds() * 1000 << " ms (" << accounts.size()
+         << " accounts, " << accounts.rows() << " rows)" << endl;
 
-        while (getline(file, line)) {
-            stringstream ss(line);
-            string date, description, category, type, amountStr;
+    for (const auto& command : commands) {
+        double seconds = 0.0;
+        int result = runAccountsReport(accounts, command, cout, seconds);
+        cerr << "[" << command.name << "] " << fixed << setprecision(3) << seconds * 1000 << " ms" << endl;
+        if (result != 0) return result;
+    }
+    return 0;
+}
 
-            getline(ss, date, ',');
-            getline(ss, description, ',');
-            getline(ss, amountStr, ',');
-            getline(ss, category, ',');
-            getline(ss, type, ',');
+// Headless entry point: run the commands on argv in order without any prompts.
+// Results go to stdout; status messages and per-command wall times to stderr.
+// account selects one account's ledger; accountList merges reports over several.
+int runBatch(int argc, char* argv[], const string& account = "", const string& accountList = "") {
+    vector<BatchCommand> commands;
+    string error;
+    if (!parseBatchCommands(argc, argv, commands, error)) {
+        cerr << "Error: " << error << "\n\n";
+        printBatchUsage(cerr);
+        return 2;
+    }
+    if (!accountList.empty()) return runAccountsBatch(commands, accountList);
 
-            if (!amountStr.empty()) {
-                double amount = stod(amountStr);
-                transactions.push_back(Transaction(date, description, amount, category, type));
+    auto start = chrono::steady_clock::now();
+    ExpenseTracker tracker(cerr, account.empty() ? "" : accountDirectory(account));
+    cerr << "[load] " << fixed << setprecision(3)
+         << chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1000 << " ms" << endl;
 
-                if (type == "income") {
-                    totalIncome += amount;
-                } else {
-                    totalExpenses += amount;
-                }
-            }
+    int status = 0;
+    for (const auto& command : commands) {
+        double seconds = 0.0;
+        int result = runBatchCommand(tracker, command, cout, seconds);
+        cerr << "[" << command.name << "] " << fixed << setprecision(3) << seconds * 1000 << " ms" << endl;
+        if (result != 0) {
+            status = result;
+            break; // later commands may depend on this one
         }
-
-        file.close();
-        cout << "Loaded " << transactions.size() << " transactions from file." << endl;
     }
+    return status;
+}
 
-    // Save data to CSV file
-    void saveData() {
-        ofstream file(dataFile);
-        if (!file.is_open()) {
-            cout << "Error: Could not save data to file." << endl;
-            return;
+// Collect "--name value" pairs from argv[first..]; only names in allowed are accepted
+bool parseFlagOptions(int argc, char* argv[], int first, const vector<string>& allowed,
+                      map<string, string>& options, string& error) {
+    for (int i = first; i < argc; i++) {
+        string word = argv[i];
+        string name = word.rfind("--", 0) == 0 ? word.substr(2) : "";
+        if (find(allowed.begin(), allowed.end(), name) == allowed.end()) {
+            error = "unknown option '" + word + "'";
+            return false;
+        }
+        if (i + 1 >= argc) {
+            error = word + " needs a value";
+            return false;
         }
+        options[name] = argv[++i];
+    }
+    return true;
+}
 
-        // Write header
-        file << "Date,Description,Amount,Category,Type\n";
+// Options shared by --generate and --bench that shape the synthetic ledger
+const vector<string> kSyntheticLedgerFlags = {"rows", "categories", "days", "description-words", "malformed",
+                                              "seed", "start"};
 
-        // Write transactions
-        for (const auto& transaction : transactions) {
-            file << transaction.date << ","
-                 << transaction.description << ","
-                 << fixed << setprecision(2) << transaction.amount << ","
-                 << transaction.category << ","
-                 << transaction.type << "\n";
+// Fill options from parsed flags; --malformed is a percentage of lines
+bool parseSyntheticLedgerOptions(const map<string, string>& flags, SyntheticLedgerOptions& options, string& error) {
+    for (const auto& flag : flags) {
+        const string& value = flag.second;
+        const char* end = value.data() + value.size();
+        if (flag.first == "start") {
+            options.firstDay = parseDate(value);
+            if (options.firstDay == kUnknownDay) {
+                error = "--start must be a date (YYYY-MM-DD)";
+                return false;
+            }
+        } else if (flag.first == "malformed") {
+            char* parsedEnd = nullptr;
+            double percent = strtod(value.c_str(), &parsedEnd);
+            if (value.empty() || parsedEnd != value.c_str() + value.size() || !(percent >= 0 && percent <= 100)) {
+                error = "--malformed must be a percentage between 0 and 100";
+                return false;
+            }
+            options.malformedRate = percent / 100;
+        } else if (find(kSyntheticLedgerFlags.begin(), kSyntheticLedgerFlags.end(), flag.first) !=
+                   kSyntheticLedgerFlags.end()) {
+            uint64_t number = 0;
+            auto parsed = from_chars(value.data(), end, number);
+            bool zeroAllowed = flag.first == "rows" || flag.first == "seed";
+            if (parsed.ec != errc() || parsed.ptr != end || (number == 0 && !zeroAllowed)) {
+                error = "--" + flag.first + " must be a " + (zeroAllowed ? "whole" : "positive") + " number";
+                return false;
+            }
+            if (flag.first == "rows") options.rows = static_cast<size_t>(number);
+            if (flag.first == "categories") options.categories = static_cast<size_t>(number);
+            if (flag.first == "days") options.days = static_cast<int32_t>(min<uint64_t>(number, INT32_MAX / 2));
+            if (flag.first == "description-words") options.descriptionWords = static_cast<size_t>(number);
+            if (flag.first == "seed") options.seed = static_cast<unsigned>(number);
         }
+    }
+    return true;
+}
+
+void printGenerateUsage(ostream& out) {
+    out << "Usage: expense_tracker --generate FILE [--rows N] [--categories N] [--days N]\n"
+           "                       [--description-words N] [--malformed PERCENT] [--seed N] [--start YYYY-MM-DD]\n"
+           "       expense_tracker --bench [generator options] [--repetitions N] [--filter TEXT]\n"
+           "                       [--format console|json] [--output FILE]\n";
+}
 
-        file.close();
+// Write a synthetic ledger CSV as described by the command-line options
+int runGenerate(int argc, char* argv[]) {
+    map<string, string> flags;
+    SyntheticLedgerOptions options;
+    string error;
+    if (argc < 3 || !parseFlagOptions(argc, argv, 3, kSyntheticLedgerFlags, flags, error) ||
+        !parseSyntheticLedgerOptions(flags, options, error)) {
+        cerr << "Error: " << (error.empty() ? "--generate needs a file name" : error) << "\n\n";
+        printGenerateUsage(cerr);
+        return 2;
     }
 
-    // Load data from Excel/CSV file provided by user
-    void loadFromExcelFile() {
-        string filename;
-        cout << "\n=== LOAD FROM EXCEL/CSV FILE ===" << endl;
-        cout << "Enter the filename (with extension): ";
-        cin >> filename;
+    string path = argv[2];
+    auto start = chrono::steady_clock::now();
+    if (!writeSyntheticLedger(path, options)) {
+        cout << "Error: Could not write '" << path << "'" << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "✅ Wrote " << options.rows << " synthetic transactions to '" << path << "' ("
+         << fixed << setprecision(1) << fileSizeOrZero(path) / 1e6 << " MB) in " << setprecision(2) << seconds
+         << "s" << endl;
+    return 0;
+}
 
-        ifstream file(filename);
-        if (!file.is_open()) {
-            cout << "Error: Could not open file '" << filename << "'" << endl;
-            return;
-        }
+// Sends stdout, both cout and C stdio, to the null device while alive so the
+// console methods of the tracker can be timed without flooding the terminal
+class SilencedStdout {
+private:
+    int savedDescriptor;
 
-        string line;
-        int lineCount = 0;
-        int addedCount = 0;
+public:
+    SilencedStdout() {
+        cout.flush();
+        fflush(stdout);
+#ifdef _WIN32
+        savedDescriptor = _dup(_fileno(stdout));
+        int null = _open("NUL", _O_WRONLY);
+        _dup2(null, _fileno(stdout));
+        _close(null);
+#else
+        savedDescriptor = dup(STDOUT_FILENO);
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+#endif
+    }
 
-        cout << "Expected CSV format: Date,Description,Amount,Category,Type" << endl;
-        cout << "Processing file..." << endl;
+    ~SilencedStdout() {
+        cout.flush();
+        fflush(stdout);
+#ifdef _WIN32
+        _dup2(savedDescriptor, _fileno(stdout));
+        _close(savedDescriptor);
+#else
+        dup2(savedDescriptor, STDOUT_FILENO);
+        close(savedDescriptor);
+#endif
+    }
 
-        // Skip header line
-        getline(file, line);
-        lineCount++;
+    SilencedStdout(const SilencedStdout&) = delete;
+    SilencedStdout& operator=(const SilencedStdout&) = delete;
+};
 
-        while (getline(file, line)) {
-            lineCount++;
-            stringstream ss(line);
-            string date, description, category, type, amountStr;
+// Answers the tracker's cin prompts with fixed text while alive
+class TypedInput {
+private:
+    istringstream input;
+    streambuf* saved;
 
-            try {
-                getline(ss, date, ',');
-                getline(ss, description, ',');
-                getline(ss, amountStr, ',');
-                getline(ss, category, ',');
-                getline(ss, type, ',');
-
-                // Clean up the strings (remove quotes if present)
-                date.erase(remove(date.begin(), date.end(), '"'), date.end());
-                description.erase(remove(description.begin(), description.end(), '"'), description.end());
-                category.erase(remove(category.begin(), category.end(), '"'), category.end());
-                type.erase(remove(type.begin(), type.end(), '"'), type.end());
-
-                transform(type.begin(), type.end(), type.begin(), ::tolower);
-
-                if (!amountStr.empty() && (type == "income" || type == "expense")) {
-                    double amount = stod(amountStr);
-                    if (amount > 0) {
-                        transactions.push_back(Transaction(date, description, amount, category, type));
-
-                        if (type == "income") {
-                            totalIncome += amount;
-                        } else {
-                            totalExpenses += amount;
-                        }
-                        addedCount++;
-                    }
+public:
+    explicit TypedInput(const string& text) : input(text), saved(cin.rdbuf(input.rdbuf())) {}
+    ~TypedInput() { cin.rdbuf(saved); }
+};
+
+// One case of the benchmark suite. setup runs untimed before every
+// repetition; run is timed, and repeated within a repetition when repeatable.
+struct BenchmarkCase {
+    string name;
+    function<void()> setup;
+    function<void()> run;
+    bool repeatable;
+    size_t items;       // rows handled per run, 0 if not meaningful
+};
+
+// Per-iteration timings of one case across its repetitions
+struct BenchmarkResult {
+    string name;
+    size_t iterations = 0;  // per repetition
+    size_t repetitions = 0;
+    double medianSeconds = 0.0;
+    double minSeconds = 0.0;
+    double maxSeconds = 0.0;
+    double cpuSeconds = 0.0;   // median process CPU time
+    size_t items = 0;
+};
+
+// Time one case: repeatable cases run enough iterations per repetition to
+// last about 50 ms, the others once per repetition after a fresh setup
+BenchmarkResult runBenchmarkCase(const BenchmarkCase& benchmark, size_t repetitions) {
+    BenchmarkResult result;
+    result.name = benchmark.name;
+    result.repetitions = repetitions;
+    result.items = benchmark.items;
+    result.iterations = 1;
+    vector<double> wall, cpu;
+    for (size_t repetition = 0; repetition < repetitions; repetition++) {
+        SilencedStdout silenced;
+        if (benchmark.setup) benchmark.setup();
+        if (benchmark.repeatable && repetition == 0) {
+            // Warm up with growing batches until one takes 10 ms, then size the batch for 50 ms
+            for (size_t batch = 1;; batch *= 10) {
+                auto start = chrono::steady_clock::now();
+                for (size_t i = 0; i < batch; i++) benchmark.run();
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                if (seconds >= 0.01 || batch >= 1000000) {
+                    result.iterations = static_cast<size_t>(max(0.05 * batch / max(seconds, 1e-9), 1.0));
+                    break;
                 }
-            } catch (const exception& e) {
-                cout << "Error processing line " << lineCount << ": " << e.what() << endl;
             }
         }
-
-        file.close();
-        cout << "Successfully loaded " << addedCount << " transactions from '" << filename << "'" << endl;
-        checkAndShowAlerts();
+        clock_t cpuStart = clock();
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < result.iterations; i++) benchmark.run();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        wall.push_back(seconds / result.iterations);
+        cpu.push_back(static_cast<double>(clock() - cpuStart) / CLOCKS_PER_SEC / result.iterations);
     }
+    auto median = [](vector<double> values) {
+        sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+    };
+    result.medianSeconds = median(wall);
+    result.cpuSeconds = median(cpu);
+    result.minSeconds = *min_element(wall.begin(), wall.end());
+    result.maxSeconds = *max_element(wall.begin(), wall.end());
+    return result;
+}
 
-    // Display all transactions with enhanced formatting
-    void displayTransactions() {
-        if (transactions.empty()) {
-            cout << "\nNo transactions found." << endl;
-            return;
+// Benchmark suite over the tracker's load, import, save, export and report
+// paths on a generated ledger. The tracker keeps its files in the current
+// directory, so the suite runs inside a scratch directory.
+int runBenchmarkSuite(int argc, char* argv[]) {
+    vector<string> allowed = kSyntheticLedgerFlags;
+    allowed.insert(allowed.end(), {"repetitions", "filter", "format", "output"});
+    map<string, string> flags;
+    SyntheticLedgerOptions options;
+    string error;
+    bool parsed = parseFlagOptions(argc, argv, 2, allowed, flags, error) &&
+                  parseSyntheticLedgerOptions(flags, options, error);
+    // Unless --start is given the ledger ends today, so current-month reports have data
+    if (parsed && !flags.count("start")) {
+        time_t now = time(0);
+        string today = ctime(&now);
+        options.firstDay = parseDate(today.substr(0, today.size() - 1)) - options.days + 1;
+    }
+    size_t repetitions = 5;
+    if (parsed && flags.count("repetitions")) {
+        const string& value = flags["repetitions"];
+        auto result = from_chars(value.data(), value.data() + value.size(), repetitions);
+        if (result.ec != errc() || result.ptr != value.data() + value.size() || repetitions == 0) {
+            error = "--repetitions must be a positive number";
+            parsed = false;
         }
+    }
+    string format = parsed && flags.count("format") ? flags["format"] : "console";
+    if (parsed && format != "console" && format != "json") {
+        error = "--format must be console or json";
+        parsed = false;
+    }
+    if (!parsed) {
+        cerr << "Error: " << error << "\n\n";
+        printGenerateUsage(cerr);
+        return 2;
+    }
+    string outputPath = flags.count("output") ? flags["output"] : "";
+    if (!outputPath.empty()) outputPath = filesystem::absolute(outputPath).string();
 
-        cout << "\n=== ALL TRANSACTIONS (" << transactions.size() << " total) ===" << endl;
-        cout << left << setw(20) << "Date" << setw(30) << "Description" 
-             << setw(12) << "Amount" << setw(15) << "Category" << setw(10) << "Type" << endl;
-        cout << string(87, '-') << endl;
-
-        for (const auto& transaction : transactions) {
-            cout << left << setw(20) << transaction.date.substr(0, 19)
-                 << setw(30) << transaction.description.substr(0, 29)
-                 << "$" << right << setw(10) << fixed << setprecision(2) << transaction.amount
-                 << left << setw(15) << transaction.category.substr(0, 14)
-                 << setw(10) << transaction.type << endl;
-        }
+    filesystem::path previousDirectory = filesystem::current_path();
+    filesystem::path directory = filesystem::temp_directory_path() / "expense_tracker_suite";
+    filesystem::remove_all(directory);
+    filesystem::create_directories(directory);
+    filesystem::current_path(directory);
 
-        checkAndShowAlerts();
+    cerr << "Generating " << options.rows << " synthetic transactions..." << endl;
+    if (!writeSyntheticLedger("ledger.csv", options)) {
+        filesystem::current_path(previousDirectory);
+        cerr << "Error: Could not write the synthetic ledger" << endl;
+        return 1;
     }
+    const string dataFiles[] = {"financial_data.csv", "financial_data.journal", "financial_data.snap",
+                                "budget_limits.csv"};
+    auto clearDataFiles = [&] {
+        for (const auto& file : dataFiles) filesystem::remove(file);
+    };
 
-    // Display enhanced category summary with insights
-    void displayCategorySummary() {
-        if (transactions.empty()) {
-            cout << "\nNo transactions found." << endl;
-            return;
+    // A tracker started from the ledger with a budget on every category,
+    // shared by the cases that do not change it
+    unique_ptr<ExpenseTracker> loaded;
+    unique_ptr<ExpenseTracker> scratch;
+    string busiestMonth;
+    auto loadShared = [&] {
+        if (loaded) return;
+        scratch.reset();
+        clearDataFiles();
+        filesystem::copy_file("ledger.csv", "financial_data.csv");
+        loaded.reset(new ExpenseTracker());
+        Money previous;
+        for (size_t i = 0; i < max<size_t>(options.categories, 1); i++) {
+            loaded->setBudget(syntheticCategory(i), Money::fromUnits(50000), previous);
         }
+        loaded->setBudget("", BudgetPeriod::Weekly, Money::fromUnits(200000), defaultBudgetThresholds(), previous);
+        const Ledger& ledger = loaded->ledger();
+        int32_t lastDay = ledger.latestDay();
+        busiestMonth = formatMonthKey(lastDay == kUnknownDay ? kUnknownDay : monthKeyFromDay(lastDay));
+    };
+    // A fresh tracker with the ledger as its data file (and a snapshot if wanted)
+    auto startFrom = [&](bool withSnapshot) {
+        return [&, withSnapshot] {
+            loaded.reset();
+            scratch.reset();
+            clearDataFiles();
+            filesystem::copy_file("ledger.csv", "financial_data.csv");
+            if (withSnapshot) {
+                Ledger ledger;
+                loadLedgerFromCsv("financial_data.csv", ledger);
+                ledger.writeSnapshot("financial_data.snap", fileStamp("financial_data.csv"));
+            }
+        };
+    };
 
-        map<string, double> incomeByCategory;
-        map<string, double> expensesByCategory;
+    vector<BenchmarkCase> cases = {
+        // Start-up runs loadData, then indexes descriptions and loads the budgets
+        {"loadData/csv", startFrom(false), [&] { scratch.reset(new ExpenseTracker()); }, false, options.rows},
+        {"loadData/snapshot", startFrom(true), [&] { scratch.reset(new ExpenseTracker()); }, false, options.rows},
+        {"loadFromExcelFile",
+         [&] {
+             loaded.reset();
+             scratch.reset();
+             clearDataFiles();
+             scratch.reset(new ExpenseTracker());
+         },
+         [&] {
+             TypedInput typed("ledger.csv\n");
+             scratch->loadFromExcelFile();
+         },
+         false, options.rows},
+        {"saveData", loadShared, [&] { loaded->saveData(loaded->ledger()); }, true, options.rows},
+        {"exportToCSV", loadShared,
+         [&] {
+             TypedInput typed("export.csv\n");
+             loaded->exportToCSV();
+         },
+         true, options.rows},
+        {"getMonthlyExpensesByCategory", loadShared,
+         [&] {
+             volatile size_t categories = loaded->getMonthlyExpensesByCategory(busiestMonth).size();
+             (void)categories;
+         },
+         true, 0},
+        {"displayCategorySummary", loadShared, [&] { loaded->displayCategorySummary(); }, true, 0},
+        {"checkBudgetLimits", loadShared, [&] { loaded->checkBudgetLimits(); }, true, 0},
+    };
 
-        for (const auto& transaction : transactions) {
-            if (transaction.type == "income") {
-                incomeByCategory[transaction.category] += transaction.amount;
-            } else {
-                expensesByCategory[transaction.category] += transaction.amount;
+    string filter = flags.count("filter") ? flags["filter"] : "";
+    vector<BenchmarkResult> results;
+    for (const auto& benchmark : cases) {
+        if (benchmark.name.find(filter) == string::npos) continue;
+        cerr << "Running " << benchmark.name << "..." << endl;
+        results.push_back(runBenchmarkCase(benchmark, repetitions));
+    }
+    // Destructors write files, so they run before leaving the scratch directory
+    {
+        SilencedStdout silenced;
+        loaded.reset();
+        scratch.reset();
+    }
+    filesystem::current_path(previousDirectory);
+    filesystem::remove_all(directory);
+
+    ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        if (!file) {
+            cerr << "Error: Could not write '" << outputPath << "'" << endl;
+            return 1;
+        }
+    }
+    ostream& out = outputPath.empty() ? cout : file;
+    if (format == "json") {
+        // Same layout as Google Benchmark's JSON reporter, times in milliseconds
+        time_t now = time(0);
+        char date[32];
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+        out << "{\n  \"context\": {\n"
+            << "    \"date\": " << jsonString(date) << ",\n"
+            << "    \"executable\": " << jsonString(argv[0]) << ",\n"
+            << "    \"num_cpus\": " << max(1u, thread::hardware_concurrency()) << ",\n"
+#ifdef NDEBUG
+            << "    \"library_build_type\": \"release\",\n"
+#else
+            << "    \"library_build_type\": \"debug\",\n"
+#endif
+            << "    \"aggregation_kernels\": " << jsonString(aggregationKernels().name) << ",\n"
+            << "    \"rows\": " << options.rows << ",\n"
+            << "    \"categories\": " << options.categories << ",\n"
+            << "    \"first_day\": " << jsonString(formatDate(options.firstDay)) << ",\n"
+            << "    \"days\": " << options.days << ",\n"
+            << "    \"description_words\": " << options.descriptionWords << ",\n"
+            << "    \"malformed_rate\": " << options.malformedRate << ",\n"
+            << "    \"seed\": " << options.seed << ",\n"
+            << "    \"repetitions\": " << repetitions << "\n  },\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchmarkResult& result = results[i];
+            out << (i ? "," : "") << "\n    {\n"
+                << "      \"name\": " << jsonString(result.name) << ",\n"
+                << "      \"run_name\": " << jsonString(result.name) << ",\n"
+                << "      \"run_type\": \"aggregate\",\n"
+                << "      \"aggregate_name\": \"median\",\n"
+                << "      \"repetitions\": " << result.repetitions << ",\n"
+                << "      \"iterations\": " << result.iterations << ",\n"
+                << setprecision(6) << scientific
+                << "      \"real_time\": " << result.medianSeconds * 1000 << ",\n"
+                << "      \"cpu_time\": " << result.cpuSeconds * 1000 << ",\n"
+                << "      \"min_time\": " << result.minSeconds * 1000 << ",\n"
+                << "      \"max_time\": " << result.maxSeconds * 1000 << ",\n"
+                << "      \"time_unit\": \"ms\"";
+            if (result.items > 0) {
+                out << ",\n      \"items_per_second\": " << result.items / max(result.medianSeconds, 1e-12);
             }
+            out << defaultfloat << "\n    }";
+        }
+        out << "\n  ]\n}" << endl;
+    } else {
+        out << left << setw(32) << "Benchmark" << setw(12) << "Iterations" << setw(14) << "Median (ms)"
+            << setw(12) << "Min (ms)" << setw(12) << "Max (ms)" << setw(12) << "CPU (ms)" << "Rows/sec" << endl;
+        out << string(106, '-') << endl;
+        for (const auto& result : results) {
+            out << left << setw(32) << result.name << setw(12) << result.iterations << fixed << setprecision(4)
+                << setw(14) << result.medianSeconds * 1000 << setw(12) << result.minSeconds * 1000 << setw(12)
+                << result.maxSeconds * 1000 << setw(12) << result.cpuSeconds * 1000;
+            if (result.items > 0) out << setprecision(0) << result.items / max(result.medianSeconds, 1e-12);
+            out << endl;
         }
+    }
+    return 0;
+}
 
-        cout << "\n=== COMPREHENSIVE CATEGORY ANALYSIS ===" << endl;
+// Writes the collected metrics when the program finishes: the --stats table
+// to stderr and the --metrics-file in Prometheus text format
+class MetricsReport {
+private:
+    bool summary;
+    string prometheusPath;
 
-        if (!incomeByCategory.empty()) {
-            cout << "\n💰 INCOME BY CATEGORY:" << endl;
-            cout << left << setw(25) << "Category" << setw(15) << "Amount" << "Percentage" << endl;
-            cout << string(50, '-') << endl;
-            for (const auto& pair : incomeByCategory) {
-                double percentage = (pair.second / totalIncome) * 100;
-                cout << left << setw(25) << pair.first
-                     << "$" << right << setw(13) << fixed << setprecision(2) << pair.second
-                     << "  " << fixed << setprecision(1) << percentage << "%" << endl;
-            }
+public:
+    MetricsReport(bool showSummary, const string& path) : summary(showSummary), prometheusPath(path) {
+        if (summary || !prometheusPath.empty()) metricsRegistry.enable();
+    }
+
+    ~MetricsReport() {
+        if (summary) metricsRegistry.writeSummary(cerr);
+        if (prometheusPath.empty()) return;
+        // Written aside and renamed so a scraper never reads a partial file
+        string temp = prometheusPath + ".tmp";
+        {
+            ofstream file(temp);
+            metricsRegistry.writePrometheus(file);
         }
+        if (!replaceFile(temp, prometheusPath)) cerr << "Error: Could not write '" << prometheusPath << "'" << endl;
+    }
 
-        if (!expensesByCategory.empty()) {
-            cout << "\n💸 EXPENSES BY CATEGORY:" << endl;
-            cout << left << setw(25) << "Category" << setw(15) << "Amount" << "Percentage" << endl;
-            cout << string(50, '-') << endl;
+    MetricsReport(const MetricsReport&) = delete;
+    MetricsReport& operator=(const MetricsReport&) = delete;
+};
 
-            // Sort expenses by amount (highest first)
-            vector<pair<string, double>> sortedExpenses(expensesByCategory.begin(), expensesByCategory.end());
-            sort(sortedExpenses.begin(), sortedExpenses.end(),
-                 [](const pair<string, double>& a, const pair<string, double>& b) {
-                     return a.second > b.second;
-                 });
+// Cost of a ScopedTimer with metrics off and on, against an empty loop
+int runMetricsBenchmark(size_t iterations) {
+    auto perCall = [&](auto&& body) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) body(i);
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / max<size_t>(iterations, 1);
+    };
+    volatile uint64_t sink = 0;
+    double baseline = perCall([&](size_t i) { sink = sink + i; });
+    double disabled = perCall([&](size_t i) {
+        ScopedTimer timer(TrackedOperation::Add);
+        timer.addRows(1);
+        sink = sink + i;
+    });
+    metricsRegistry.enable();
+    double enabled = perCall([&](size_t i) {
+        ScopedTimer timer(TrackedOperation::Add);
+        timer.addRows(1);
+        sink = sink + i;
+    });
 
-            for (const auto& pair : sortedExpenses) {
-                double percentage = (pair.second / totalExpenses) * 100;
-                cout << left << setw(25) << pair.first
-                     << "$" << right << setw(13) << fixed << setprecision(2) << pair.second
-                     << "  " << fixed << setprecision(1) << percentage << "%";
+    cout << left << setw(24) << "Timer" << "ns/call" << endl;
+    cout << string(34, '-') << endl;
+    cout << left << setw(24) << "none" << fixed << setprecision(2) << baseline << endl;
+    cout << left << setw(24) << (kMetricsCompiled ? "metrics off" : "compiled out") << disabled << endl;
+    cout << left << setw(24) << (kMetricsCompiled ? "metrics on" : "compiled out") << enabled << endl;
+    return 0;
+}
 
-                // Highlight top spending categories
-                if (percentage >= 30) {
-                    cout << " 🔥 HIGH";
-                } else if (percentage >= 15) {
-                    cout << " ⚠️  MEDIUM";
-                }
-                cout << endl;
-            }
+// Fixed-input checks of the CSV tokenizer, journal replay and snapshot
+// round trip; prints one line per check and returns 1 if any fails
+int runSelfTest() {
+    int failures = 0;
+    auto check = [&](const string& name, bool passed) {
+        cout << (passed ? "  ✅ " : "  ❌ ") << name << endl;
+        if (!passed) failures++;
+    };
 
-            // Show top spending insight
-            if (!sortedExpenses.empty()) {
-                cout << "\n💡 INSIGHT: '" << sortedExpenses[0].first 
-                     << "' is your highest expense category ($" 
-                     << fixed << setprecision(2) << sortedExpenses[0].second << ")" << endl;
+    cout << "CSV tokenizer" << endl;
+    typedef vector<vector<string>> Records;
+    auto tokenize = [](string_view text) {
+        Records records;
+        CsvTokenizer tokenizer(text);
+        vector<string_view> fields;
+        while (tokenizer.next(fields)) records.emplace_back(fields.begin(), fields.end());
+        return records;
+    };
+    check("delimiter inside quotes", tokenize("a,\"b,c\",d\n") == Records{{"a", "b,c", "d"}});
+    check("doubled quotes", tokenize("\"say \"\"hi\"\"\",x\n") == Records{{"say \"hi\"", "x"}});
+    check("CRLF line endings", tokenize("a,b\r\nc,d\r\n") == Records{{"a", "b"}, {"c", "d"}});
+    check("CRLF after a quoted field", tokenize("\"a\",b\r\n\"c\"\r\n") == Records{{"a", "b"}, {"c"}});
+    check("UTF-8 byte order mark", tokenize("\xEF\xBB\xBF" "Date,Amount\n") == Records{{"Date", "Amount"}});
+    check("line break inside quotes", tokenize("\"two\nlines\",x\ny,z\n") == Records{{"two\nlines", "x"}, {"y", "z"}});
+    check("last line without a line break", tokenize("a,b\nc,d") == Records{{"a", "b"}, {"c", "d"}});
+    {
+        CsvTokenizer tokenizer("\"open,x\n");
+        vector<string_view> fields;
+        check("unterminated quote is malformed", tokenizer.next(fields) && tokenizer.recordMalformed());
+    }
+    check("chunk boundary skips line breaks inside quotes",
+          nextRecordBoundary("\"a\nb\",c\nd\n", 0, 2, CsvDialect()) == 8);
+    check("quote inside an unquoted field is literal",
+          nextRecordBoundary("12\" pizza,x\n\"a\nb\",c\nd\n", 0, 14, CsvDialect()) == 20);
+    {
+        // Multi-line quoted descriptions, so parallel chunk boundaries fall inside quotes,
+        // after a literal quote in an unquoted field that must not flip the quote state
+        string csv = "Date,Description,Amount,Category,Type\n2024-01-01,12\" pizza,5.00,Food,expense\n";
+        for (int i = 0; i < 500; i++) {
+            csv += "2024-01-" + to_string(10 + i % 20) + ",\"Line " + to_string(i) +
+                   "\nsecond, \"\"quoted\"\" line\"," + to_string(i) + ".25,Food,expense\r\n";
+        }
+        IngestResult serial = ingestCsv(csv, IngestOptions(), 1);
+        bool same = serial.rows.size() == 501 && serial.errors.empty();
+        for (unsigned threads : {2u, 3u, 7u}) {
+            IngestResult parallel = ingestCsv(csv, IngestOptions(), threads);
+            same = same && parallel.errors.empty() && parallel.rows.size() == serial.rows.size();
+            for (size_t i = 0; same && i < serial.rows.size(); i++) {
+                const RawRow& a = serial.rows[i];
+                const RawRow& b = parallel.rows[i];
+                same = a.date == b.date && a.description == b.description && a.amount == b.amount &&
+                       a.category == b.category && a.type == b.type;
             }
         }
-
-        checkAndShowAlerts();
+        check("parallel ingest matches a single chunk",
+              same && serial.rows[0].description == "12\" pizza" &&
+                  serial.rows[8].description == "Line 7\nsecond, \"quoted\" line");
     }
 
-    // Export data to CSV with enhanced options
-    void exportToCSV() {
-        string filename;
-        cout << "\nEnter filename for export (with .csv extension): ";
-        cin >> filename;
+    cout << "Money parsing" << endl;
+    {
+        Money amount;
+        check("largest amount is accepted", Money::parse("100000000000", amount) &&
+                                                amount == Money::fromUnits(kMaxMoneyUnits) &&
+                                                Money::parse("-100000000000.00", amount));
+        check("amounts beyond the limit are rejected",
+              !Money::parse("100000000000.01", amount) && !Money::parse("-100000000001", amount) &&
+                  !Money::parse("90000000000000000", amount) && !Money::parse("99999999999999999999", amount));
+        IngestResult oversized = ingestCsv("Date,Description,Amount,Category,Type\n"
+                                           "2024-01-01,Huge,90000000000000000,Food,expense\n"
+                                           "2024-01-02,Lunch,12.50,Food,expense\n",
+                                           IngestOptions(), 1);
+        check("import reports an oversized amount", oversized.rows.size() == 1 && oversized.errors.size() == 1);
+    }
 
-        ofstream file(filename);
-        if (!file.is_open()) {
-            cout << "Error: Could not create export file." << endl;
-            return;
+    cout << "Date index" << endl;
+    {
+        // Newest-first and shuffled rows, appended one by one and in bulk, across several zones
+        mt19937 rng(11);
+        int32_t start = daysFromCivil(2024, 1, 1);
+        vector<int32_t> rowDays;
+        for (int i = 0; i < 3000; i++) rowDays.push_back(start + (i < 1500 ? 1500 - i : static_cast<int>(rng() % 900)));
+        Ledger single, bulk;
+        for (size_t i = 0; i < rowDays.size(); i++) {
+            Money amount = Money::fromUnits(static_cast<int64_t>(i % 997) * 100);
+            single.append(formatDate(rowDays[i]), "Row", amount, "Food", TransactionType::Expense);
+            if (i < 1000) bulk.append(formatDate(rowDays[i]), "Row", amount, "Food", TransactionType::Expense);
         }
+        {
+            Ledger::BulkAppend batch(bulk);
+            for (size_t i = 1000; i < rowDays.size(); i++) {
+                bulk.append(formatDate(rowDays[i]), "Row", Money::fromUnits(static_cast<int64_t>(i % 997) * 100),
+                            "Food", TransactionType::Expense);
+            }
+        }
+        TransactionQuery query;
+        query.firstDay = start + 300;
+        query.lastDay = start + 1200;
+        query.minAmount = Money::fromUnits(50000);
+        vector<uint32_t> expected;
+        for (uint32_t row = 0; row < rowDays.size(); row++) {
+            if (rowDays[row] >= query.firstDay && rowDays[row] <= query.lastDay && (row % 997) * 100 >= 50000) {
+                expected.push_back(row);
+            }
+        }
+        stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return rowDays[a] < rowDays[b]; });
+        check("out-of-order appends keep the day order", single.select(query) == expected);
+        check("bulk appends are merged into the day order",
+              bulk.select(query) == expected && bulk.latestDay() == start + 1500);
+    }
 
-        // Write header with additional metadata
-        file << "Date,Description,Amount,Category,Type\n";
-        file << "# Export generated on: " << getCurrentDate() << "\n";
-        file << "# Total transactions: " << transactions.size() << "\n";
-        file << "# Total income: $" << fixed << setprecision(2) << totalIncome << "\n";
-        file << "# Total expenses: $" << fixed << setprecision(2) << totalExpenses << "\n";
-        file << "# Net balance: $" << fixed << setprecision(2) << (totalIncome - totalExpenses) << "\n";
-
-        // Write transactions
-        for (const auto& transaction : transactions) {
-            file << transaction.date << ","
-                 << transaction.description << ","
-                 << fixed << setprecision(2) << transaction.amount << ","
-                 << transaction.category << ","
-                 << transaction.type << "\n";
+    cout << "Journal replay" << endl;
+    string directory = benchDirectory("self_test");
+    string dataPath = directory + "/financial_data.csv";
+    string journalPath = directory + "/financial_data.journal";
+    string salary, coffee, rent;
+    TransactionJournal::formatRecord(salary, "2024-01-05", "Salary", Money::fromUnits(300000), "Work",
+                                     TransactionType::Income);
+    TransactionJournal::formatRecord(coffee, "2024-01-06", "Coffee, \"large\"", Money::fromUnits(450), "Food",
+                                     TransactionType::Expense);
+    TransactionJournal::formatRecord(rent, "2024-01-07", "Rent", Money::fromUnits(120000), "Housing",
+                                     TransactionType::Expense);
+    // Descriptions after starting on a one-row data file and a journal holding records;
+    // replaceData swaps in a different data file of the same size before the start
+    auto replay = [&](const string& records, bool replaceData = false) {
+        filesystem::remove_all(directory);
+        filesystem::create_directories(directory);
+        {
+            ofstream data(dataPath, ios::binary);
+            data << "Date,Description,Amount,Category,Type\n2023-12-31,Opening,10.00,Other,income\n";
+        }
+        {
+            TransactionJournal journal;
+            journal.open(journalPath, 0);
+            journal.reset(fileStamp(dataPath));
+        }
+        {
+            ofstream journal(journalPath, ios::binary | ios::app);
+            journal << records;
         }
+        if (replaceData) {
+            ofstream data(dataPath, ios::binary);
+            data << "Date,Description,Amount,Category,Type\n2023-12-31,Changed,20.00,Other,income\n";
+            data.close();
+            filesystem::last_write_time(dataPath, filesystem::last_write_time(dataPath) + chrono::seconds(1));
+        }
+        ostringstream quiet;
+        ExpenseTracker tracker(quiet, directory);
+        vector<string> descriptions;
+        for (size_t i = 0; i < tracker.ledger().size(); i++) descriptions.emplace_back(tracker.ledger().description(i));
+        return descriptions;
+    };
+    vector<string> replayed = replay(salary + coffee + rent.substr(0, rent.size() / 2));
+    check("torn final record is dropped", replayed == vector<string>{"Opening", "Salary", "Coffee, \"large\""});
+    {
+        ostringstream quiet;
+        ExpenseTracker tracker(quiet, directory);
+        check("replayed records survive a restart", tracker.ledger().size() == 3 &&
+                                                        tracker.ledger().amount(1) == Money::fromUnits(300000));
+    }
+    check("record without its line break is torn",
+          replay(salary + rent.substr(0, rent.size() - 1)) == vector<string>{"Opening", "Salary"});
+    string corrupt = coffee;
+    corrupt[12] ^= 1;
+    check("checksum mismatch stops the replay", replay(salary + corrupt + rent) == vector<string>{"Opening", "Salary"});
+    check("journal of a replaced same-size data file is set aside",
+          replay(salary, true) == vector<string>{"Changed"} && filesystem::exists(journalPath + ".stale"));
 
-        file.close();
-        cout << "✅ Data exported successfully to '" << filename << "'" << endl;
-        cout << "📊 Export includes " << transactions.size() << " transactions and summary metadata." << endl;
+    cout << "Snapshot round trip" << endl;
+    Ledger original;
+    original.append("2024-02-29", "Plain", Money::fromUnits(1234), "Food", TransactionType::Expense);
+    original.append("sometime", "Comma, \"quote\"\nand line", Money::fromUnits(-99), "", TransactionType::Income);
+    original.append("1999-12-31", "", Money::fromUnits(0), "Food", TransactionType::Expense);
+    string snapshotPath = directory + "/round_trip.snap";
+    FileStamp source;
+    source.size = 4096;
+    source.modified = 123456789;
+    bool written = original.writeSnapshot(snapshotPath, source);
+    string bytes;
+    {
+        MappedFile file(snapshotPath);
+        bytes = string(file.view());
     }
-};
+    Ledger loaded;
+    string error;
+    bool same = written && loaded.loadSnapshot(bytes, source, error) && loaded.size() == original.size();
+    for (size_t i = 0; same && i < original.size(); i++) {
+        same = loaded.day(i) == original.day(i) && loaded.dateText(i) == original.dateText(i) &&
+               loaded.description(i) == original.description(i) && loaded.amount(i) == original.amount(i) &&
+               loaded.category(i) == original.category(i) && loaded.type(i) == original.type(i);
+    }
+    check("columns survive a write and load", same);
+    FileStamp edited = source;
+    edited.modified++;
+    Ledger stale;
+    check("snapshot of a modified CSV is rejected", !stale.loadSnapshot(bytes, edited, error));
+    bytes[bytes.size() - 1] ^= 1;
+    Ledger damaged;
+    check("payload checksum is verified", !damaged.loadSnapshot(bytes, source, error));
+    filesystem::remove_all(directory);
+
+    cout << (failures ? "❌ " + to_string(failures) + " check(s) failed" : string("✅ All checks passed")) << endl;
+    return failures ? 1 : 0;
+}
 
 // Display enhanced main menu
 void displayMenu() {
@@ -644,14 +9234,147 @@ void displayMenu() {
     cout << "║ 5. Check Spending Alerts & Analysis          ║" << endl;
     cout << "║ 6. Export Data to CSV                        ║" << endl;
     cout << "║ 7. Set Budget Limits                         ║" << endl;    
-    cout << "║ 8. Exit                                      ║" << endl;
+    cout << "║ 8. Search Transactions                       ║" << endl;
+    cout << "║ 9. Spending Trends & Month-End Forecast      ║" << endl;
+    cout << "║ 10. Background Tasks & Save Now              ║" << endl;
+    cout << "║ 11. Exit                                     ║" << endl;
     cout << "╚══════════════════════════════════════════════╝" << endl;
-    cout << "Enter your choice (1-8): ";
+    cout << "Enter your choice (1-11): ";
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
-    ExpenseTracker tracker;
+#endif
+
+    // Metrics and account flags may precede any command or mode
+    bool showStats = false;
+    string metricsPath;
+    string account;
+    string accountList;
+    string autosaveText = "60";
+    while (argc >= 2) {
+        string flag = argv[1];
+        int used = 2;
+        if (flag == "--stats") used = 1;
+        else if (flag == "--metrics-file" && argc >= 3) metricsPath = argv[2];
+        else if (flag == "--account" && argc >= 3) account = argv[2];
+        else if (flag == "--accounts" && argc >= 3) accountList = argv[2];
+        else if (flag == "--autosave" && argc >= 3) autosaveText = argv[2];
+        else break;
+        if (used == 1) showStats = true;
+        argv[used] = argv[0];
+        argv += used;
+        argc -= used;
+    }
+    MetricsReport metricsReport(showStats, metricsPath);
+    if (!account.empty() && !isValidAccountName(account)) {
+        cerr << "Error: invalid account name '" << account << "' (letters, digits, '-', '_' and '.')" << endl;
+        return 2;
+    }
+    if (!account.empty() && !accountList.empty()) {
+        cerr << "Error: use either --account or --accounts" << endl;
+        return 2;
+    }
+    unsigned autosaveSeconds = 0;
+    auto parsedAutosave = from_chars(autosaveText.data(), autosaveText.data() + autosaveText.size(), autosaveSeconds);
+    if (parsedAutosave.ec != errc() || parsedAutosave.ptr != autosaveText.data() + autosaveText.size()) {
+        cerr << "Error: --autosave takes a number of seconds (0 keeps disk writes in the foreground)" << endl;
+        return 2;
+    }
+
+    // Every --*-bench mode takes a row count
+    size_t benchRows = 0;
+    string mode = argc >= 2 ? argv[1] : "";
+    if (argc == 3 && mode.size() > 8 && mode.compare(0, 2, "--") == 0 &&
+        mode.compare(mode.size() - 6, 6, "-bench") == 0) {
+        string_view text = argv[2];
+        auto parsed = from_chars(text.data(), text.data() + text.size(), benchRows);
+        if (parsed.ec != errc() || parsed.ptr != text.data() + text.size() || benchRows == 0) {
+            cerr << "Error: " << mode << " takes a positive number of rows, not '" << text << "'" << endl;
+            return 2;
+        }
+    }
+
+    if (argc == 4 && string(argv[1]) == "--convert") {
+        return convertToSnapshot(argv[2], argv[3]);
+    }
+    if (argc == 3 && string(argv[1]) == "--startup-bench") {
+        return runStartupBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--import-bench") {
+        return runImportBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--parser-bench") {
+        return runParserBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--aggregate-bench") {
+        return runAggregateBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--query-bench") {
+        return runQueryBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--render-bench") {
+        return runRenderBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--search-bench") {
+        return runSearchBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--range-bench") {
+        return runRangeBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--budget-bench") {
+        return runBudgetBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--trends-bench") {
+        return runTrendsBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--categorize-bench") {
+        return runCategorizeBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--autosave-bench") {
+        return runAutosaveBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--dedup-bench") {
+        return runDedupBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--shard-bench") {
+        return runShardBenchmark(benchRows);
+    }
+    if (argc == 3 && string(argv[1]) == "--memory-bench") {
+        return runMemoryBenchmark(argv[0], benchRows);
+    }
+    if (argc == 5 && string(argv[1]) == "--memory-bench-mode") {
+        return runMemoryBenchmarkMode(argv[2], argv[3], argv[4]);
+    }
+    if (argc == 3 && string(argv[1]) == "--metrics-bench") {
+        return runMetricsBenchmark(benchRows);
+    }
+    if (argc == 2 && string(argv[1]) == "--self-test") {
+        return runSelfTest();
+    }
+    if (argc >= 2 && string(argv[1]) == "--generate") {
+        return runGenerate(argc, argv);
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench") {
+        return runBenchmarkSuite(argc, argv);
+    }
+
+    if (argc >= 2) {
+        string command = argv[1];
+        if (isBatchCommand(command)) return runBatch(argc, argv, account, accountList);
+        bool help = command == "help" || command == "--help";
+        if (!help) cerr << "Error: unknown command '" << command << "'\n\n";
+        printBatchUsage(help ? cout : cerr);
+        return help ? 0 : 2;
+    }
+
+    if (!accountList.empty()) {
+        cerr << "Error: --accounts only works with the report command" << endl;
+        return 2;
+    }
+    ExpenseTracker tracker(cout, account.empty() ? "" : accountDirectory(account));
+    if (autosaveSeconds > 0) tracker.startBackgroundIo(chrono::seconds(autosaveSeconds));
     int choice;
 
     cout << "🎉 Welcome to Advanced Expense & Savings Tracker!" << endl;
@@ -659,8 +9382,14 @@ int main() {
     cout << "📊 Features: Budget limits, spending analysis, and comprehensive reporting." << endl;
 
     while (true) {
+        tracker.showBackgroundNotices();
         displayMenu();
-        cin >> choice;
+        if (!(cin >> choice)) {
+            if (cin.eof()) return 0; // input closed
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            choice = 0;
+        }
 
         switch (choice) {
             case 1:
@@ -685,13 +9414,24 @@ int main() {
                 tracker.setBudgetLimit();
                 break;
             case 8:
+                tracker.searchTransactions();
+                break;
+            case 9:
+                tracker.showSpendingTrends();
+                break;
+            case 10:
+                tracker.showBackgroundStatus();
+                break;
+            case 11:
+                tracker.finishBackgroundIo();
                 cout << "\n💝 Thank you for using Advanced Expense & Savings Tracker!" << endl;
                 cout << "💾 Your data has been saved automatically." << endl;
                 cout << "🚀 Keep up the great financial management!" << endl;
                 return 0;
             default:
-                cout << "❌ Invalid choice! Please enter a number between 1 and 8." << endl;
+                cout << "❌ Invalid choice! Please enter a number between 1 and 11." << endl;
         }
+        tracker.autosaveIfDue();
 
         cout << "\n⏎ Press Enter to continue...";
         cin.ignore();